@@ -50,6 +50,11 @@ void DownsampleMenu::RenderMenu()
 
   ImGui::EndGroup();
 
+  // the pyramid keeps every level of the source so moving the slider is only a lookup. without it every level is
+  // reduced from the source in one pass (less memory, nearest can be 1 off from the pyramid's rounding)
+
+  ImGui::Checkbox("cache pyramid", &isPyramidCaching);
+
   ImGui::NewLine();
 
   if (ButtonCenteredOnLine("save image"))
@@ -81,6 +86,11 @@ int32_t DownsampleMenu::DownsampleIterations() const
   return downsamepleIters;
 }
 
+bool DownsampleMenu::IsPyramidCaching() const
+{
+  return isPyramidCaching;
+}
+
 bool DownsampleMenu::ProcessBegin()
 {
   bool should_process = processBegin;
@@ -13,10 +13,12 @@ class DownsampleMenu
     void RenderMenu();
     [[nodiscard]] MenuOp_Downsample CurrentOperation() const;
     [[nodiscard]] int32_t DownsampleIterations() const;
+    [[nodiscard]] bool IsPyramidCaching() const;
     bool ProcessBegin();
 
   private:
     bool processBegin = false;
     MenuOp_Downsample operation = MenuOp_Downsample::DECIMATE;
     int32_t downsamepleIters = 0;
+    bool isPyramidCaching = true;
 };
@@ -43,10 +43,10 @@ void Menu::RenderMenu(sf::Image & image, sf::Texture & texture, sf::Sprite & spr
   ImGui::SeparatorText("source");
   if(ImGui::Button("Load Image"))
   {
-    char const * file_filter[5] = {"*.png","*.jpg", "*.encode", "*.bencode", "*.vencode"};
+    char const * file_filter[7] = {"*.png","*.jpg", "*.pgm", "*.ppm", "*.encode", "*.bencode", "*.vencode"};
     auto selected_file = tinyfd_openFileDialog("Load Image"
         ,nullptr
-        ,5
+        ,7
         ,file_filter
         ,"image files"
         ,0
@@ -55,6 +55,7 @@ void Menu::RenderMenu(sf::Image & image, sf::Texture & texture, sf::Sprite & spr
     if (selected_file)
     {
       imageFilePath = std::string(selected_file);
+      imageChanged = true;
 
       std::string image_file_ext = imageFilePath.substr(imageFilePath.find_last_of('.') + 1);
       for (auto & c : image_file_ext)
@@ -161,12 +162,13 @@ void Menu::RenderMenu(sf::Image & image, sf::Texture & texture, sf::Sprite & spr
 
   ImGui::SeparatorText("options");
   ImGui::Checkbox("use output as source", &outputAsSource);
+  ImGui::Checkbox("show thread pool telemetry", &showPoolTelemetry);
 
   ImGui::NewLine();
 
   ImGui::SeparatorText("operations");
 
-  const std::vector<const char*> items_list = {"None", "Downsample", "Upsample", "Varying Bits", "Histogram Equalization", "Spatial Filtering"};
+  const std::vector<const char*> items_list = {"None", "Downsample", "Upsample", "Varying Bits", "Histogram Equalization", "Spatial Filtering", "Resample"};
 
   ImGui::Combo("##operations", &currentItem, items_list.data(), static_cast<int32_t>(items_list.size()));
 
@@ -256,11 +258,21 @@ bool Menu::IsSpatialFiltering() const
   return (currentItem == 5);
 }
 
+bool Menu::IsResampling() const
+{
+  return (currentItem == 6);
+}
+
 bool Menu::IsOutputAsSourceSet() const
 {
   return outputAsSource;
 }
 
+bool Menu::IsShowingPoolTelemetry() const
+{
+  return showPoolTelemetry;
+}
+
 bool Menu::IsOutputPNG() const
 {
   return (fileType == 0);
@@ -292,9 +304,21 @@ std::string Menu::FileOutputPath()
   return file_path;
 }
 
+const std::string & Menu::FileInputPath() const
+{
+  return imageFilePath;
+}
+
 bool Menu::IsSavingOutput()
 {
   bool tmp_save = saveOutput;
   saveOutput = false;
   return tmp_save;
 }
+
+bool Menu::IsImageChanged()
+{
+  bool tmp_changed = imageChanged;
+  imageChanged = false;
+  return tmp_changed;
+}
@@ -17,20 +17,26 @@ class Menu {
     [[nodiscard]] bool IsVaryingBitsSet() const;
     [[nodiscard]] bool IsHistogramEqualizationSet() const;
     [[nodiscard]] bool IsSpatialFiltering() const;
+    [[nodiscard]] bool IsResampling() const;
     [[nodiscard]] bool IsOutputAsSourceSet() const;
+    [[nodiscard]] bool IsShowingPoolTelemetry() const;
     [[nodiscard]] bool IsOutputPNG() const;
     [[nodiscard]] bool IsOutputJPG() const;
     [[nodiscard]] bool IsOutputRLE() const;
     [[nodiscard]] bool IsOutputBRLE() const;
     [[nodiscard]] bool IsOutputVLE() const;
     [[nodiscard]] std::string FileOutputPath();
+    [[nodiscard]] const std::string & FileInputPath() const;
     bool IsSavingOutput();
+    bool IsImageChanged();
 
   private:
     int32_t currentItem = 0;
     bool outputAsSource = true;
+    bool showPoolTelemetry = false;
     std::string imageFilePath;
     int32_t fileType = 0;
     char filepath[64] = "output";
     bool saveOutput = false;
+    bool imageChanged = false;
 };
@@ -13,6 +13,12 @@ enum class MenuOp_Upsample : uint16_t {
   BILINEAR
 };
 
+enum class MenuOp_Resample : uint16_t {
+  BILINEAR = 0,
+  BICUBIC,
+  LANCZOS3
+};
+
 enum class MenuOp_HistogramColor : uint16_t {
   GRAY = 0,
   RGBA
@@ -21,7 +27,9 @@ enum class MenuOp_HistogramColor : uint16_t {
 enum class MenuOp_HistogramMethod : uint16_t {
   GLOBAL = 0,
   LOCALIZE,
-  LOCALIZE_ENCHANCEMENT
+  LOCALIZE_ENCHANCEMENT,
+  CLAHE,
+  SPECIFICATION
 };
 
 enum class MenuOp_SpatialFilter : uint16_t {
@@ -0,0 +1,369 @@
+#include "ccpubudget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32) || defined(WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <bitset>
+#elif defined(linux) || defined(unix)
+#include <sched.h>
+#include <fstream>
+#include <vector>
+#endif
+
+namespace {
+  constexpr const char * override_env_name = "DIPTOOL_NUM_THREADS";
+
+#if defined(linux) || defined(unix)
+  struct cgroup_mount
+  {
+    std::string root;
+    std::string mountPoint;
+  };
+
+  std::vector<std::string> split(const std::string & text, char delimiter)
+  {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+
+    while (std::getline(stream, part, delimiter))
+    {
+      parts.emplace_back(part);
+    }
+
+    return parts;
+  }
+
+  bool find_cgroup_mounts(cgroup_mount & v1_cpu_mount, cgroup_mount & v2_mount)
+  {
+    // mountinfo: id parent major:minor root mount_point options [optional fields...] - fs_type source super_options
+
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    if (!mountinfo.is_open())
+    {
+      return false;
+    }
+
+    std::string line;
+    while (std::getline(mountinfo, line))
+    {
+      const std::vector<std::string> fields = split(line, ' ');
+      const auto separator = std::find(fields.begin(), fields.end(), "-");
+
+      if ((fields.size() < 5) || (separator == fields.end()) || (std::distance(separator, fields.end()) < 4))
+      {
+        continue;
+      }
+
+      const std::string & fs_type = *(separator + 1);
+      const std::string & super_options = *(separator + 3);
+
+      if (fs_type == "cgroup2")
+      {
+        v2_mount = {fields[3], fields[4]};
+      }
+      else if (fs_type == "cgroup")
+      {
+        const std::vector<std::string> controllers = split(super_options, ',');
+        if (std::find(controllers.begin(), controllers.end(), "cpu") != controllers.end())
+        {
+          v1_cpu_mount = {fields[3], fields[4]};
+        }
+      }
+    }
+
+    return true;
+  }
+
+  bool find_cgroup_paths(std::string & v1_cpu_path, std::string & v2_path)
+  {
+    // /proc/self/cgroup: hierarchy_id:controllers:path. the v2 hierarchy is "0::path"
+
+    std::ifstream cgroup("/proc/self/cgroup");
+    if (!cgroup.is_open())
+    {
+      return false;
+    }
+
+    std::string line;
+    while (std::getline(cgroup, line))
+    {
+      const size_t first_colon = line.find(':');
+      const size_t second_colon = line.find(':', first_colon + 1);
+      if ((first_colon == std::string::npos) || (second_colon == std::string::npos))
+      {
+        continue;
+      }
+
+      const std::string controller_list = line.substr(first_colon + 1, second_colon - first_colon - 1);
+      const std::string path = line.substr(second_colon + 1);
+
+      if ((line.substr(0, first_colon) == "0") && controller_list.empty())
+      {
+        v2_path = path;
+      }
+      else
+      {
+        const std::vector<std::string> controllers = split(controller_list, ',');
+        if (std::find(controllers.begin(), controllers.end(), "cpu") != controllers.end())
+        {
+          v1_cpu_path = path;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  std::vector<std::string> cgroup_directories(const cgroup_mount & mount, const std::string & cgroup_path)
+  {
+    // the cgroup of the process and every parent up to the mount point. a limit on any of them applies. the path is
+    // relative to the root of the mount (which is not "/" when the mount is only part of the hierarchy)
+
+    std::vector<std::string> directories;
+
+    if (mount.mountPoint.empty())
+    {
+      return directories;
+    }
+
+    std::string relative_path = cgroup_path;
+    if ((mount.root != "/") && (relative_path.rfind(mount.root, 0) == 0))
+    {
+      relative_path = relative_path.substr(mount.root.size());
+    }
+
+    while (!relative_path.empty() && (relative_path != "/"))
+    {
+      directories.emplace_back(mount.mountPoint + relative_path);
+      relative_path = relative_path.substr(0, relative_path.find_last_of('/'));
+    }
+
+    directories.emplace_back(mount.mountPoint);
+
+    return directories;
+  }
+
+  double cgroup_v2_quota(const cgroup_mount & mount, const std::string & cgroup_path)
+  {
+    // cpu.max: "<quota> <period>" or "max <period>" when there's no limit
+
+    double quota_cpus = 0.0;
+
+    for (const auto & directory : cgroup_directories(mount, cgroup_path))
+    {
+      std::ifstream cpu_max(directory + "/cpu.max");
+      std::string quota;
+      double period = 0.0;
+
+      if (!(cpu_max >> quota >> period) || (quota == "max") || (period <= 0.0))
+      {
+        continue;
+      }
+
+      const double cpus = std::strtod(quota.c_str(), nullptr) / period;
+      if (cpus > 0.0)
+      {
+        quota_cpus = (quota_cpus > 0.0) ? std::min(quota_cpus, cpus) : cpus;
+      }
+    }
+
+    return quota_cpus;
+  }
+
+  double cgroup_v1_quota(const cgroup_mount & mount, const std::string & cgroup_path)
+  {
+    // cpu.cfs_quota_us is -1 when there's no limit
+
+    double quota_cpus = 0.0;
+
+    for (const auto & directory : cgroup_directories(mount, cgroup_path))
+    {
+      std::ifstream cfs_quota(directory + "/cpu.cfs_quota_us");
+      std::ifstream cfs_period(directory + "/cpu.cfs_period_us");
+      double quota = 0.0;
+      double period = 0.0;
+
+      if (!(cfs_quota >> quota) || !(cfs_period >> period) || (quota <= 0.0) || (period <= 0.0))
+      {
+        continue;
+      }
+
+      const double cpus = quota / period;
+      quota_cpus = (quota_cpus > 0.0) ? std::min(quota_cpus, cpus) : cpus;
+    }
+
+    return quota_cpus;
+  }
+#endif
+
+  size_t detect_affinity_cpus()
+  {
+#if defined(_WIN32) || defined(WIN32)
+    DWORD_PTR process_mask = 0;
+    DWORD_PTR system_mask = 0;
+
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+    {
+      return std::bitset<std::numeric_limits<DWORD_PTR>::digits>(process_mask).count();
+    }
+#elif defined(linux) || defined(unix)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+    {
+      return static_cast<size_t>(CPU_COUNT(&cpu_set));
+    }
+#endif
+
+    return 0;
+  }
+
+  double detect_quota_cpus()
+  {
+#if defined(linux) || defined(unix)
+    cgroup_mount v1_cpu_mount;
+    cgroup_mount v2_mount;
+    std::string v1_cpu_path;
+    std::string v2_path;
+
+    if (!find_cgroup_mounts(v1_cpu_mount, v2_mount) || !find_cgroup_paths(v1_cpu_path, v2_path))
+    {
+      return 0.0;
+    }
+
+    if (!v2_path.empty())
+    {
+      const double quota_cpus = cgroup_v2_quota(v2_mount, v2_path);
+      if (quota_cpus > 0.0)
+      {
+        return quota_cpus;
+      }
+    }
+
+    if (!v1_cpu_path.empty())
+    {
+      return cgroup_v1_quota(v1_cpu_mount, v1_cpu_path);
+    }
+#endif
+
+    return 0.0;
+  }
+
+  size_t detect_override_cpus()
+  {
+    const char * env_value = std::getenv(override_env_name);
+    if (env_value == nullptr)
+    {
+      return 0;
+    }
+
+    char * env_end = nullptr;
+    const long n_cpus = std::strtol(env_value, &env_end, 10);
+
+    return ((env_end != env_value) && (n_cpus > 0)) ? static_cast<size_t>(n_cpus) : 0;
+  }
+}
+
+size_t ccpubudget::numberofcpus()
+{
+  return instance().numberOfCpus;
+}
+
+size_t ccpubudget::hardwarecpus()
+{
+  return instance().hardwareCpus;
+}
+
+size_t ccpubudget::affinitycpus()
+{
+  return instance().affinityCpus;
+}
+
+double ccpubudget::quotacpus()
+{
+  return instance().quotaCpus;
+}
+
+size_t ccpubudget::overridecpus()
+{
+  return instance().overrideCpus;
+}
+
+std::string ccpubudget::description()
+{
+  const budget & cpu_budget = instance();
+
+  std::string text = std::to_string(cpu_budget.numberOfCpus) + " cpus (hardware " + std::to_string(cpu_budget.hardwareCpus);
+
+  if (cpu_budget.affinityCpus > 0)
+  {
+    text += ", affinity " + std::to_string(cpu_budget.affinityCpus);
+  }
+
+  if (cpu_budget.quotaCpus > 0.0)
+  {
+    std::ostringstream quota_text;
+    quota_text << std::fixed << std::setprecision(1) << cpu_budget.quotaCpus;
+    text += ", quota " + quota_text.str();
+  }
+
+  if (cpu_budget.overrideCpus > 0)
+  {
+    text += std::string(", ") + override_env_name + " " + std::to_string(cpu_budget.overrideCpus);
+  }
+
+  return text + ")";
+}
+
+const ccpubudget::budget & ccpubudget::instance()
+{
+  static const budget cpu_budget = detect();
+  return cpu_budget;
+}
+
+ccpubudget::budget ccpubudget::detect()
+{
+  budget cpu_budget;
+
+  cpu_budget.hardwareCpus = std::max(1u, std::thread::hardware_concurrency());
+  cpu_budget.affinityCpus = detect_affinity_cpus();
+  cpu_budget.quotaCpus = detect_quota_cpus();
+  cpu_budget.overrideCpus = detect_override_cpus();
+
+  if (cpu_budget.overrideCpus > 0)
+  {
+    cpu_budget.numberOfCpus = cpu_budget.overrideCpus;
+    return cpu_budget;
+  }
+
+  // a quota is a share of cpu time, running more threads than it allows only gets them throttled. partial cpus are
+  // rounded down (but there's always at least 1)
+
+  size_t n_cpus = cpu_budget.hardwareCpus;
+
+  if (cpu_budget.affinityCpus > 0)
+  {
+    n_cpus = std::min(n_cpus, cpu_budget.affinityCpus);
+  }
+
+  if (cpu_budget.quotaCpus > 0.0)
+  {
+    n_cpus = std::min(n_cpus, static_cast<size_t>(std::floor(cpu_budget.quotaCpus)));
+  }
+
+  cpu_budget.numberOfCpus = std::max(static_cast<size_t>(1), n_cpus);
+
+  return cpu_budget;
+}
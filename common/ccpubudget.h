@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// how many cpus this process can actually keep busy. std::thread::hardware_concurrency reports the cores of the
+// machine, which is too many when the process is limited by a cpu quota (cgroup v2 cpu.max or v1 cfs quota, as set
+// up by containers) or by its affinity mask. the budget is the smallest of those limits, unless the
+// DIPTOOL_NUM_THREADS environment variable asks for a specific number. the limits are read once and cached
+
+class ccpubudget
+{
+  public:
+    ccpubudget() = delete;
+
+    [[nodiscard]] static size_t numberofcpus();
+
+    [[nodiscard]] static size_t hardwarecpus();
+    [[nodiscard]] static size_t affinitycpus();
+    [[nodiscard]] static double quotacpus();
+    [[nodiscard]] static size_t overridecpus();
+
+    [[nodiscard]] static std::string description();
+
+  private:
+    struct budget
+    {
+      size_t hardwareCpus = 1;
+      size_t affinityCpus = 0;
+      double quotaCpus = 0.0;
+      size_t overrideCpus = 0;
+      size_t numberOfCpus = 1;
+    };
+
+    static const budget & instance();
+    static budget detect();
+};
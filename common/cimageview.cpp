@@ -0,0 +1,176 @@
+#include "cimageview.h"
+
+#include <algorithm>
+#include <cstring>
+
+cimageview::cimageview(const uint8_t * pixels, uint32_t width, uint32_t height, uint8_t channels, size_t stride)
+  : pixelData(pixels)
+  ,viewWidth(width)
+  ,viewHeight(height)
+  ,viewChannels(channels)
+  ,rowStride(std::max(stride, static_cast<size_t>(width) * channels))
+{
+}
+
+cimageview::cimageview(const std::vector<uint8_t> & pixels, uint32_t width, uint32_t height, uint8_t channels)
+  : cimageview(pixels.data(), width, height, channels)
+{
+  // a buffer smaller than the size it's said to have gives an empty view rather than reads past its end
+
+  if (pixels.size() < (static_cast<size_t>(width) * height * channels))
+  {
+    *this = cimageview();
+  }
+}
+
+cimageview cimageview::owning(std::vector<uint8_t> pixels, uint32_t width, uint32_t height, uint8_t channels)
+{
+  auto buffer = std::make_shared<const std::vector<uint8_t>>(std::move(pixels));
+
+  cimageview view(*buffer, width, height, channels);
+  if (!view.empty())
+  {
+    view.owner = std::move(buffer);
+  }
+
+  return view;
+}
+
+cimageview cimageview::roi(uint32_t x, uint32_t y, uint32_t roi_width, uint32_t roi_height) const
+{
+  x = std::min(x, viewWidth);
+  y = std::min(y, viewHeight);
+
+  cimageview view = *this;
+  view.viewWidth = std::min(roi_width, viewWidth - x);
+  view.viewHeight = std::min(roi_height, viewHeight - y);
+  view.pixelData = (view.empty() ? pixelData : pixel(x, y));
+
+  return view;
+}
+
+cimageview cimageview::owned() const
+{
+  if (isowning() || empty())
+  {
+    return *this;
+  }
+
+  return owning(tovector(), viewWidth, viewHeight, viewChannels);
+}
+
+const uint8_t * cimageview::data() const
+{
+  return pixelData;
+}
+
+const uint8_t * cimageview::row(uint32_t y) const
+{
+  return pixelData + (static_cast<size_t>(y) * rowStride);
+}
+
+const uint8_t * cimageview::pixel(uint32_t x, uint32_t y) const
+{
+  return row(y) + (static_cast<size_t>(x) * viewChannels);
+}
+
+uint32_t cimageview::width() const
+{
+  return viewWidth;
+}
+
+uint32_t cimageview::height() const
+{
+  return viewHeight;
+}
+
+uint8_t cimageview::channels() const
+{
+  return viewChannels;
+}
+
+size_t cimageview::stride() const
+{
+  return rowStride;
+}
+
+size_t cimageview::rowbytes() const
+{
+  return static_cast<size_t>(viewWidth) * viewChannels;
+}
+
+bool cimageview::empty() const
+{
+  return (pixelData == nullptr) || (viewWidth == 0) || (viewHeight == 0) || (viewChannels == 0);
+}
+
+bool cimageview::iscontiguous() const
+{
+  return (rowStride == rowbytes()) || (viewHeight <= 1);
+}
+
+bool cimageview::isowning() const
+{
+  return (owner != nullptr);
+}
+
+std::vector<uint8_t> cimageview::tovector() const
+{
+  std::vector<uint8_t> pixels;
+
+  if (empty())
+  {
+    return pixels;
+  }
+
+  pixels.resize(rowbytes() * viewHeight);
+
+  if (iscontiguous())
+  {
+    std::memcpy(pixels.data(), pixelData, pixels.size());
+    return pixels;
+  }
+
+  for (uint32_t y=0; y<viewHeight; y++)
+  {
+    std::memcpy(pixels.data() + (static_cast<size_t>(y) * rowbytes()), row(y), rowbytes());
+  }
+
+  return pixels;
+}
+
+const std::vector<uint8_t> & cimageview::packed(std::vector<uint8_t> & storage) const
+{
+  if (isowning() && (pixelData == owner->data()) && iscontiguous() && (owner->size() == (rowbytes() * viewHeight)))
+  {
+    return *owner;
+  }
+
+  storage = tovector();
+  return storage;
+}
+
+bool cimageview::equalpixels(const cimageview & other) const
+{
+  if ((viewWidth != other.viewWidth) || (viewHeight != other.viewHeight) || (viewChannels != other.viewChannels))
+  {
+    return false;
+  }
+
+  // the same pixels of the same buffer don't need to be compared
+
+  if ((pixelData == other.pixelData) && (rowStride == other.rowStride) && isowning() && (owner == other.owner))
+  {
+    return true;
+  }
+
+  for (uint32_t y=0; y<viewHeight; y++)
+  {
+    if (std::memcmp(row(y), other.row(y), rowbytes()) != 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// a rectangle of 8-bit interleaved pixels somewhere in memory: the first pixel, width x height, channels per pixel and
+// the bytes from one row to the next (the stride, at least width * channels). a view either borrows the pixels (the
+// caller keeps them alive, ex. an sf::Image) or shares the ownership of the buffer it was made from so it can be handed
+// to a task that outlives the caller. roi() is a view of a sub-rectangle with the same stride and owner, nothing is
+// copied. the pixels are never written through a view
+
+class cimageview
+{
+  public:
+    cimageview() = default;
+    cimageview(const uint8_t * pixels, uint32_t width, uint32_t height, uint8_t channels, size_t stride = 0);
+    cimageview(const std::vector<uint8_t> & pixels, uint32_t width, uint32_t height, uint8_t channels);
+
+    // a temporary would be gone before the view is used, owning() takes it over instead
+    cimageview(std::vector<uint8_t> && pixels, uint32_t width, uint32_t height, uint8_t channels) = delete;
+
+    [[nodiscard]] static cimageview owning(std::vector<uint8_t> pixels, uint32_t width, uint32_t height, uint8_t channels);
+
+    // the part of roi_width x roi_height at (x, y) that's inside the view
+    [[nodiscard]] cimageview roi(uint32_t x, uint32_t y, uint32_t roi_width, uint32_t roi_height) const;
+
+    // a view that keeps its pixels alive: this one if it already shares ownership, a packed copy otherwise
+    [[nodiscard]] cimageview owned() const;
+
+    [[nodiscard]] const uint8_t * data() const;
+    [[nodiscard]] const uint8_t * row(uint32_t y) const;
+    [[nodiscard]] const uint8_t * pixel(uint32_t x, uint32_t y) const;
+
+    [[nodiscard]] uint32_t width() const;
+    [[nodiscard]] uint32_t height() const;
+    [[nodiscard]] uint8_t channels() const;
+    [[nodiscard]] size_t stride() const;
+    [[nodiscard]] size_t rowbytes() const;
+
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] bool iscontiguous() const;
+    [[nodiscard]] bool isowning() const;
+
+    // the pixels packed row after row (stride = width * channels). packed() hands back the owned buffer itself when
+    // the view is all of it and only copies into storage otherwise
+    [[nodiscard]] std::vector<uint8_t> tovector() const;
+    [[nodiscard]] const std::vector<uint8_t> & packed(std::vector<uint8_t> & storage) const;
+
+    // same size and pixel values (the strides and owners can differ)
+    [[nodiscard]] bool equalpixels(const cimageview & other) const;
+
+  private:
+    const uint8_t * pixelData = nullptr;
+    uint32_t viewWidth = 0;
+    uint32_t viewHeight = 0;
+    uint8_t viewChannels = 0;
+    size_t rowStride = 0;
+    std::shared_ptr<const std::vector<uint8_t>> owner;
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// move-only void() job with a small buffer. callables that fit in the buffer (a lambda capturing a few pointers or
+// references, a std::function, a packaged_task) are stored inline so queueing them doesn't touch the allocator. bigger
+// ones fall back to a heap copy. unlike std::function the callable doesn't have to be copyable
+
+// which queue of a pool a job goes in, see cworkstealpool
+enum class cjobpriority : uint8_t {INTERACTIVE=0, NORMAL, BACKGROUND};
+
+class cjob
+{
+  public:
+    static constexpr size_t inline_size = 48;
+
+    cjob() noexcept = default;
+
+    // not explicit so a lambda converts to a cjob the same way it does to a std::function
+    template<typename callable, typename = std::enable_if_t<!std::is_same_v<std::decay_t<callable>, cjob> && std::is_invocable_v<std::decay_t<callable> &>>>
+    cjob(callable && func)
+    {
+      using func_type = std::decay_t<callable>;
+
+      if constexpr (fitsinline<func_type>())
+      {
+        ::new (static_cast<void *>(storage)) func_type(std::forward<callable>(func));
+        ops = &inline_operations<func_type>;
+      }
+      else
+      {
+        ::new (static_cast<void *>(storage)) func_type *(new func_type(std::forward<callable>(func)));
+        ops = &heap_operations<func_type>;
+      }
+    }
+
+    cjob(cjob && other) noexcept
+    {
+      movefrom(other);
+    }
+
+    cjob & operator=(cjob && other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        movefrom(other);
+      }
+
+      return *this;
+    }
+
+    cjob(const cjob &) = delete;
+    cjob & operator=(const cjob &) = delete;
+
+    ~cjob()
+    {
+      reset();
+    }
+
+    void operator()()
+    {
+      ops->invoke(storage);
+    }
+
+    explicit operator bool() const noexcept
+    {
+      return (ops != nullptr);
+    }
+
+    void reset() noexcept
+    {
+      if (ops != nullptr)
+      {
+        ops->destroy(storage);
+        ops = nullptr;
+      }
+    }
+
+    [[nodiscard]] bool isinline() const noexcept
+    {
+      return (ops != nullptr) && ops->isInline;
+    }
+
+  private:
+    struct operations
+    {
+      void (*invoke)(void * buffer);
+      void (*relocate)(void * destination, void * source) noexcept;
+      void (*destroy)(void * buffer) noexcept;
+      bool isInline;
+    };
+
+    template<typename func_type>
+    static constexpr bool fitsinline()
+    {
+      // moving a job around the queue must not throw so only nothrow movable callables go in the buffer
+
+      return (sizeof(func_type) <= inline_size)
+          && (alignof(func_type) <= alignof(std::max_align_t))
+          && std::is_nothrow_move_constructible_v<func_type>;
+    }
+
+    template<typename func_type>
+    static constexpr operations inline_operations =
+      {[](void * buffer) {
+        (*std::launder(static_cast<func_type *>(buffer)))();
+      }
+      ,[](void * destination, void * source) noexcept {
+        func_type * source_func = std::launder(static_cast<func_type *>(source));
+        ::new (destination) func_type(std::move(*source_func));
+        source_func->~func_type();
+      }
+      ,[](void * buffer) noexcept {
+        std::launder(static_cast<func_type *>(buffer))->~func_type();
+      }
+      ,true
+      };
+
+    template<typename func_type>
+    static constexpr operations heap_operations =
+      {[](void * buffer) {
+        (**std::launder(static_cast<func_type **>(buffer)))();
+      }
+      ,[](void * destination, void * source) noexcept {
+        ::new (destination) func_type *(*std::launder(static_cast<func_type **>(source)));
+      }
+      ,[](void * buffer) noexcept {
+        delete *std::launder(static_cast<func_type **>(buffer));
+      }
+      ,false
+      };
+
+    void movefrom(cjob & other) noexcept
+    {
+      if (other.ops != nullptr)
+      {
+        other.ops->relocate(storage, other.storage);
+        ops = other.ops;
+        other.ops = nullptr;
+      }
+    }
+
+    alignas(std::max_align_t) std::byte storage[inline_size];
+    const operations * ops = nullptr;
+};
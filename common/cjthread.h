@@ -90,8 +90,6 @@ class cjthread
     std::string description();
 
   private:
-    std::jthread thread;
-
     void cinit(std::string && name, std::string && description, std::function<void()> && task)
     {
       threadName = name;
@@ -104,4 +102,7 @@ class cjthread
 
     std::string threadName = "Unnamed";
     std::string threadDesc = "No description";
+
+    // last so the name/description are constructed before the thread starts running cinit
+    std::jthread thread;
 };
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// bounded multi producer / multi consumer queue (dmitry vyukov's bounded mpmc queue). the slots are allocated once
+// and every slot has a sequence number that says whether it's free for the producer of a given position or holds the
+// item for the consumer of it, so pushing and popping are one compare exchange on the position plus a store of the
+// sequence (no lock, no allocation). trypush fails when the queue is full and trypop when it's empty, the caller
+// decides whether to wait, retry or do something else
+
+template<typename T>
+class cmpmcqueue
+{
+  static_assert(std::is_nothrow_move_assignable_v<T>, "cmpmcqueue items are moved in and out of the slots");
+
+  public:
+    explicit cmpmcqueue(size_t min_capacity)
+    {
+      size_t queue_capacity = 2;
+      while (queue_capacity < min_capacity)
+      {
+        queue_capacity <<= 1;
+      }
+
+      capacity = queue_capacity;
+      mask = queue_capacity - 1;
+      slots = std::make_unique<slot[]>(queue_capacity);
+
+      for (size_t i=0; i<queue_capacity; i++)
+      {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    cmpmcqueue(const cmpmcqueue &) = delete;
+    cmpmcqueue & operator=(const cmpmcqueue &) = delete;
+
+    // item is only moved from when the push succeeds
+    bool trypush(T && item) noexcept
+    {
+      size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+      for (;;)
+      {
+        slot & s = slots[position & mask];
+        const size_t sequence = s.sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+        if (difference == 0)
+        {
+          if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          {
+            s.item = std::move(item);
+            s.sequence.store(position + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (difference < 0)
+        {
+          // the slot still holds the item from one lap ago
+          return false;
+        }
+        else
+        {
+          position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    bool trypop(T & item) noexcept
+    {
+      size_t position = dequeuePosition.load(std::memory_order_relaxed);
+
+      for (;;)
+      {
+        slot & s = slots[position & mask];
+        const size_t sequence = s.sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+        if (difference == 0)
+        {
+          if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          {
+            item = std::move(s.item);
+            s.item = T();
+            s.sequence.store(position + mask + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (difference < 0)
+        {
+          // nothing has been pushed to this position yet
+          return false;
+        }
+        else
+        {
+          position = dequeuePosition.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    // approximate while other threads are pushing/popping
+    [[nodiscard]] size_t size() const noexcept
+    {
+      const size_t enqueued = enqueuePosition.load(std::memory_order_relaxed);
+      const size_t dequeued = dequeuePosition.load(std::memory_order_relaxed);
+      return (enqueued > dequeued) ? std::min(enqueued - dequeued, capacity) : 0;
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+      return size() == 0;
+    }
+
+    [[nodiscard]] size_t maxsize() const noexcept
+    {
+      return capacity;
+    }
+
+  private:
+    struct slot
+    {
+      std::atomic<size_t> sequence = 0;
+      T item;
+    };
+
+    size_t capacity = 0;
+    size_t mask = 0;
+    std::unique_ptr<slot[]> slots;
+    alignas(64) std::atomic<size_t> enqueuePosition = 0;
+    alignas(64) std::atomic<size_t> dequeuePosition = 0;
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ctaskgroup.h"
+
+// loop helpers on top of a pool (ex. cworkstealpool). the range is cut into chunks of `grain` items and
+// handed out to at most (pool threads + 1) jobs that are added to the pool in one batch. the calling thread runs one
+// of the jobs itself and helps with the rest while it waits, so a loop costs one lock and one wake-up no matter how
+// many items it has
+//
+// STATIC gives every job the same contiguous run of chunks up front (no shared counter, best when every item costs
+// the same). DYNAMIC lets the jobs grab the next chunk from an atomic counter as they finish (better when the cost
+// per item varies, ex. the median/alpha trim filters). a grain of 0 picks a size that gives each job a few chunks
+
+enum class cparallelschedule : uint8_t {STATIC=0, DYNAMIC};
+
+namespace cparallel_detail {
+  constexpr size_t chunks_per_job = 4;
+
+  template<typename pool_type>
+  size_t numberofjobs(pool_type & pool)
+  {
+    return pool.numberofthreads() + 1;
+  }
+
+  template<typename pool_type>
+  size_t grainsize(pool_type & pool, size_t count, size_t grain)
+  {
+    if (grain > 0)
+    {
+      return grain;
+    }
+
+    return std::max(static_cast<size_t>(1), count / (numberofjobs(pool) * chunks_per_job));
+  }
+
+  // run chunk_job(chunk index) for every chunk in [0, number_of_chunks)
+  template<typename pool_type, typename chunk_job_type>
+  void runchunks(pool_type & pool, size_t number_of_chunks, cparallelschedule schedule, chunk_job_type && chunk_job)
+  {
+    const size_t number_of_jobs = std::min(number_of_chunks, numberofjobs(pool));
+
+    if (number_of_jobs <= 1)
+    {
+      for (size_t chunk=0; chunk<number_of_chunks; chunk++)
+      {
+        chunk_job(chunk);
+      }
+
+      return;
+    }
+
+    std::atomic<size_t> next_chunk = 0;
+
+    auto job = [&](size_t job_index) {
+      if (schedule == cparallelschedule::STATIC)
+      {
+        const size_t chunk_begin = (job_index * number_of_chunks) / number_of_jobs;
+        const size_t chunk_end = ((job_index + 1) * number_of_chunks) / number_of_jobs;
+
+        for (size_t chunk=chunk_begin; chunk<chunk_end; chunk++)
+        {
+          chunk_job(chunk);
+        }
+      }
+      else
+      {
+        for (size_t chunk=next_chunk.fetch_add(1, std::memory_order_relaxed); chunk<number_of_chunks; chunk=next_chunk.fetch_add(1, std::memory_order_relaxed))
+        {
+          chunk_job(chunk);
+        }
+      }
+    };
+
+    ctaskgroup jobs(pool);
+    jobs.runbatch(number_of_jobs - 1, [&job](size_t job_index) {
+      job(job_index + 1);
+    });
+
+    job(0);
+    jobs.wait();
+  }
+}
+
+// body(i) for every i in [begin, end)
+template<typename pool_type, typename index_type, typename body_type>
+void parallel_for(pool_type & pool
+                 ,index_type begin
+                 ,index_type end
+                 ,body_type && body
+                 ,size_t grain = 0
+                 ,cparallelschedule schedule = cparallelschedule::STATIC)
+{
+  if (end <= begin)
+  {
+    return;
+  }
+
+  const auto count = static_cast<size_t>(end - begin);
+  const size_t chunk_size = cparallel_detail::grainsize(pool, count, grain);
+  const size_t number_of_chunks = (count + chunk_size - 1) / chunk_size;
+
+  cparallel_detail::runchunks(pool, number_of_chunks, schedule, [&](size_t chunk) {
+    const size_t chunk_begin = chunk * chunk_size;
+    const size_t chunk_end = std::min(chunk_begin + chunk_size, count);
+
+    for (size_t i=chunk_begin; i<chunk_end; i++)
+    {
+      body(static_cast<index_type>(begin + static_cast<index_type>(i)));
+    }
+  });
+}
+
+// body(x_begin, y_begin, x_end, y_end) for every tile_width x tile_height tile of a width x height area. tiles are
+// handed out dynamically (tiles near the edges are smaller)
+template<typename pool_type, typename body_type>
+void parallel_for_2d(pool_type & pool
+                    ,int32_t width
+                    ,int32_t height
+                    ,int32_t tile_width
+                    ,int32_t tile_height
+                    ,body_type && body
+                    ,cparallelschedule schedule = cparallelschedule::DYNAMIC)
+{
+  if ((width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  tile_width = std::clamp(tile_width, 1, width);
+  tile_height = std::clamp(tile_height, 1, height);
+
+  const int32_t tiles_x = (width + tile_width - 1) / tile_width;
+  const int32_t tiles_y = (height + tile_height - 1) / tile_height;
+
+  cparallel_detail::runchunks(pool, static_cast<size_t>(tiles_x) * static_cast<size_t>(tiles_y), schedule, [&](size_t tile) {
+    const int32_t x_begin = static_cast<int32_t>(tile % static_cast<size_t>(tiles_x)) * tile_width;
+    const int32_t y_begin = static_cast<int32_t>(tile / static_cast<size_t>(tiles_x)) * tile_height;
+
+    body(x_begin, y_begin, std::min(x_begin + tile_width, width), std::min(y_begin + tile_height, height));
+  });
+}
+
+// body(i, partial) for every i in [begin, end), where each chunk starts its partial from `identity`. the partials are
+// then folded together with combine(total, partial) in chunk order, so the result doesn't depend on the scheduling
+template<typename pool_type, typename index_type, typename value_type, typename body_type, typename combine_type>
+value_type parallel_reduce(pool_type & pool
+                          ,index_type begin
+                          ,index_type end
+                          ,const value_type & identity
+                          ,body_type && body
+                          ,combine_type && combine
+                          ,size_t grain = 0
+                          ,cparallelschedule schedule = cparallelschedule::STATIC)
+{
+  value_type total = identity;
+
+  if (end <= begin)
+  {
+    return total;
+  }
+
+  const auto count = static_cast<size_t>(end - begin);
+  const size_t chunk_size = cparallel_detail::grainsize(pool, count, grain);
+  const size_t number_of_chunks = (count + chunk_size - 1) / chunk_size;
+
+  std::vector<value_type> partials(number_of_chunks, identity);
+
+  cparallel_detail::runchunks(pool, number_of_chunks, schedule, [&](size_t chunk) {
+    const size_t chunk_begin = chunk * chunk_size;
+    const size_t chunk_end = std::min(chunk_begin + chunk_size, count);
+
+    value_type & partial = partials[chunk];
+    for (size_t i=chunk_begin; i<chunk_end; i++)
+    {
+      body(static_cast<index_type>(begin + static_cast<index_type>(i)), partial);
+    }
+  });
+
+  for (const auto & partial : partials)
+  {
+    combine(total, partial);
+  }
+
+  return total;
+}
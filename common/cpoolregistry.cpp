@@ -0,0 +1,112 @@
+#include "cpoolregistry.h"
+#include "ccpubudget.h"
+
+#include <algorithm>
+
+namespace {
+  constexpr const char * shared_pool_name = "dip";
+  constexpr const char * io_pool_name = "io";
+  constexpr size_t default_named_pool_threads = 1;
+}
+
+cworkstealpool & cpoolregistry::shared()
+{
+  return named(shared_pool_name, defaultnumberofthreads());
+}
+
+cworkstealpool & cpoolregistry::io()
+{
+  return named(io_pool_name);
+}
+
+cworkstealpool & cpoolregistry::named(const std::string & pool_name, size_t n_threads)
+{
+  // the size only matters for the call that creates the pool
+
+  registry & reg = instance();
+  std::lock_guard<std::mutex> lock(reg.registryMutex);
+
+  auto & pool = reg.pools[pool_name];
+  if (!pool)
+  {
+    pool = std::make_unique<cworkstealpool>((n_threads > 0) ? n_threads : default_named_pool_threads, pool_name);
+    pool->telemetry().setenabled(reg.telemetryEnabled);
+  }
+
+  return *pool;
+}
+
+size_t cpoolregistry::defaultnumberofthreads()
+{
+  // the thread waiting on a parallel loop runs part of it too so the pool leaves one cpu of the budget for it
+
+  const size_t n_cpus = ccpubudget::numberofcpus();
+  return std::max(static_cast<size_t>(1), n_cpus - 1);
+}
+
+size_t cpoolregistry::numberofpools()
+{
+  registry & reg = instance();
+  std::lock_guard<std::mutex> lock(reg.registryMutex);
+
+  return reg.pools.size();
+}
+
+size_t cpoolregistry::numberofthreads()
+{
+  registry & reg = instance();
+  std::lock_guard<std::mutex> lock(reg.registryMutex);
+
+  size_t n_threads = 0;
+  for (const auto & [pool_name, pool] : reg.pools)
+  {
+    n_threads += pool->numberofthreads();
+  }
+
+  return n_threads;
+}
+
+std::vector<cpooltelemetry::snapshot> cpoolregistry::telemetry()
+{
+  registry & reg = instance();
+  std::lock_guard<std::mutex> lock(reg.registryMutex);
+
+  std::vector<cpooltelemetry::snapshot> pool_snapshots;
+  for (const auto & [pool_name, pool] : reg.pools)
+  {
+    pool_snapshots.emplace_back(pool->telemetry().takesnapshot());
+  }
+
+  return pool_snapshots;
+}
+
+void cpoolregistry::resettelemetry()
+{
+  registry & reg = instance();
+  std::lock_guard<std::mutex> lock(reg.registryMutex);
+
+  for (const auto & [pool_name, pool] : reg.pools)
+  {
+    pool->telemetry().reset();
+  }
+}
+
+void cpoolregistry::settelemetryenabled(bool is_enabled)
+{
+  registry & reg = instance();
+  std::lock_guard<std::mutex> lock(reg.registryMutex);
+
+  reg.telemetryEnabled = is_enabled;
+  for (const auto & [pool_name, pool] : reg.pools)
+  {
+    pool->telemetry().setenabled(is_enabled);
+  }
+}
+
+cpoolregistry::registry & cpoolregistry::instance()
+{
+  // constructed on first use so no threads exist until an operation needs them
+
+  static registry reg;
+  return reg;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "cworkstealpool.h"
+
+// process wide thread pools. the operations all draw from the shared pool instead of owning threads so adding
+// another parallel operation doesn't add threads. pools are only created the first time they're asked for. a named
+// pool is for work that has to be isolated from the shared one (ex. background jobs that shouldn't delay the
+// operations) and is small unless a size is asked for. io() is the named pool file reads/writes wait on, so a slow disk
+// doesn't hold a thread the operations compute on. telemetry() is a snapshot of every pool's cpooltelemetry (in
+// name order)
+
+class cpoolregistry
+{
+  public:
+    cpoolregistry() = delete;
+
+    static cworkstealpool & shared();
+    static cworkstealpool & io();
+    static cworkstealpool & named(const std::string & pool_name, size_t n_threads = 0);
+
+    [[nodiscard]] static size_t defaultnumberofthreads();
+    [[nodiscard]] static size_t numberofpools();
+    [[nodiscard]] static size_t numberofthreads();
+
+    [[nodiscard]] static std::vector<cpooltelemetry::snapshot> telemetry();
+    static void resettelemetry();
+    static void settelemetryenabled(bool is_enabled);
+
+  private:
+    struct registry
+    {
+      std::mutex registryMutex;
+      std::map<std::string, std::unique_ptr<cworkstealpool>> pools;
+      bool telemetryEnabled = false;
+    };
+
+    static registry & instance();
+};
@@ -0,0 +1,254 @@
+#include "cpooltelemetry.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+  constexpr double ns_per_sec = 1e9;
+
+  std::string escape_json(const std::string & text)
+  {
+    std::string escaped;
+    escaped.reserve(text.size());
+
+    for (const char c : text)
+    {
+      if ((c == '"') || (c == '\\'))
+      {
+        escaped += '\\';
+      }
+
+      if (static_cast<unsigned char>(c) >= 0x20)
+      {
+        escaped += c;
+      }
+    }
+
+    return escaped;
+  }
+
+  template<typename value_type>
+  void write_json_array(std::ostringstream & json, const value_type & values)
+  {
+    json << "[";
+    for (size_t i=0; i<values.size(); i++)
+    {
+      json << ((i > 0) ? "," : "") << values[i];
+    }
+    json << "]";
+  }
+}
+
+cpooltelemetry::cpooltelemetry(std::string pool_name, size_t n_workers)
+  : poolName(std::move(pool_name))
+  ,nWorkers(n_workers + 1)
+  ,workers(std::make_unique<workercounters[]>(n_workers + 1))
+  ,startTime(now())
+{
+}
+
+void cpooltelemetry::setenabled(bool is_enabled)
+{
+  isEnabled.store(is_enabled, std::memory_order_relaxed);
+}
+
+bool cpooltelemetry::enabled() const
+{
+  return isEnabled.load(std::memory_order_relaxed);
+}
+
+int64_t cpooltelemetry::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void cpooltelemetry::jobqueued(size_t queue_depth)
+{
+  // only the thread that moves nextDepthSample forward takes a sample, everyone else is done after one load
+
+  const int64_t time_now = now();
+  int64_t next_sample = nextDepthSample.load(std::memory_order_relaxed);
+
+  if ((time_now < next_sample) || !nextDepthSample.compare_exchange_strong(next_sample, time_now + depth_sample_interval_ns, std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(depthMutex);
+  depthSamples[depthSampleNext] = {time_now, queue_depth};
+  depthSampleNext = (depthSampleNext + 1) % number_of_depth_samples;
+  depthSampleCount = std::min(depthSampleCount + 1, number_of_depth_samples);
+}
+
+void cpooltelemetry::jobrun(size_t worker_index, int64_t queued_at, int64_t started_at, int64_t finished_at)
+{
+  workercounters & worker = counters(worker_index);
+  const int64_t run_ns = std::max<int64_t>(finished_at - started_at, 0);
+
+  worker.jobs.fetch_add(1, std::memory_order_relaxed);
+  worker.busyNs.fetch_add(static_cast<uint64_t>(run_ns), std::memory_order_relaxed);
+  worker.runTime[bucket(run_ns)].fetch_add(1, std::memory_order_relaxed);
+
+  if (queued_at > 0)
+  {
+    worker.queueWait[bucket(started_at - queued_at)].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void cpooltelemetry::jobstolen(size_t worker_index)
+{
+  counters(worker_index).steals.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cpooltelemetry::workerparked(size_t worker_index, int64_t parked_ns)
+{
+  counters(worker_index).parkedNs.fetch_add(static_cast<uint64_t>(std::max<int64_t>(parked_ns, 0)), std::memory_order_relaxed);
+}
+
+void cpooltelemetry::reset()
+{
+  for (size_t i=0; i<nWorkers; i++)
+  {
+    workercounters & worker = workers[i];
+    worker.jobs.store(0, std::memory_order_relaxed);
+    worker.steals.store(0, std::memory_order_relaxed);
+    worker.busyNs.store(0, std::memory_order_relaxed);
+    worker.parkedNs.store(0, std::memory_order_relaxed);
+
+    for (size_t b=0; b<number_of_buckets; b++)
+    {
+      worker.queueWait[b].store(0, std::memory_order_relaxed);
+      worker.runTime[b].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(depthMutex);
+  depthSampleCount = 0;
+  depthSampleNext = 0;
+  startTime.store(now(), std::memory_order_relaxed);
+}
+
+size_t cpooltelemetry::numberofworkers() const
+{
+  return nWorkers - 1;
+}
+
+cpooltelemetry::snapshot cpooltelemetry::takesnapshot() const
+{
+  // the counters keep moving while they're read so the numbers are only consistent to within a job or two
+
+  snapshot pool_snapshot;
+  const int64_t start_time = startTime.load(std::memory_order_relaxed);
+
+  pool_snapshot.poolName = poolName;
+  pool_snapshot.elapsedSecs = static_cast<double>(now() - start_time) / ns_per_sec;
+
+  for (size_t i=0; i<nWorkers; i++)
+  {
+    const workercounters & worker = workers[i];
+
+    workerstats stats;
+    stats.jobs = worker.jobs.load(std::memory_order_relaxed);
+    stats.steals = worker.steals.load(std::memory_order_relaxed);
+    stats.busySecs = static_cast<double>(worker.busyNs.load(std::memory_order_relaxed)) / ns_per_sec;
+    stats.parkedSecs = static_cast<double>(worker.parkedNs.load(std::memory_order_relaxed)) / ns_per_sec;
+    pool_snapshot.workers.emplace_back(stats);
+
+    for (size_t b=0; b<number_of_buckets; b++)
+    {
+      pool_snapshot.queueWaitHistogram[b] += worker.queueWait[b].load(std::memory_order_relaxed);
+      pool_snapshot.runTimeHistogram[b] += worker.runTime[b].load(std::memory_order_relaxed);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(depthMutex);
+  const size_t first_sample = (depthSampleNext + number_of_depth_samples - depthSampleCount) % number_of_depth_samples;
+
+  for (size_t i=0; i<depthSampleCount; i++)
+  {
+    const auto & [sample_time, depth] = depthSamples[(first_sample + i) % number_of_depth_samples];
+    pool_snapshot.queueDepth.emplace_back(static_cast<double>(sample_time - start_time) / ns_per_sec, depth);
+  }
+
+  return pool_snapshot;
+}
+
+std::string cpooltelemetry::tojson(const std::vector<snapshot> & pool_snapshots)
+{
+  std::ostringstream json;
+  json << std::setprecision(9);
+
+  json << "{\"histogramBucketsUs\":";
+  std::array<uint64_t, number_of_buckets> bucket_lower_us = {};
+  for (size_t b=1; b<number_of_buckets; b++)
+  {
+    bucket_lower_us[b] = static_cast<uint64_t>(1) << b;
+  }
+  write_json_array(json, bucket_lower_us);
+
+  json << ",\"pools\":[";
+
+  for (size_t p=0; p<pool_snapshots.size(); p++)
+  {
+    const snapshot & pool_snapshot = pool_snapshots[p];
+
+    json << ((p > 0) ? "," : "")
+         << "{\"name\":\"" << escape_json(pool_snapshot.poolName) << "\""
+         << ",\"elapsedSecs\":" << pool_snapshot.elapsedSecs
+         << ",\"workers\":[";
+
+    for (size_t w=0; w<pool_snapshot.workers.size(); w++)
+    {
+      const workerstats & stats = pool_snapshot.workers[w];
+      const bool is_outside = (w + 1 == pool_snapshot.workers.size());
+
+      json << ((w > 0) ? "," : "")
+           << "{\"worker\":" << (is_outside ? std::string("\"outside\"") : std::to_string(w))
+           << ",\"jobs\":" << stats.jobs
+           << ",\"steals\":" << stats.steals
+           << ",\"busySecs\":" << stats.busySecs
+           << ",\"parkedSecs\":" << stats.parkedSecs
+           << "}";
+    }
+
+    json << "],\"queueWaitHistogram\":";
+    write_json_array(json, pool_snapshot.queueWaitHistogram);
+    json << ",\"runTimeHistogram\":";
+    write_json_array(json, pool_snapshot.runTimeHistogram);
+
+    json << ",\"queueDepth\":[";
+    for (size_t i=0; i<pool_snapshot.queueDepth.size(); i++)
+    {
+      json << ((i > 0) ? "," : "") << "[" << pool_snapshot.queueDepth[i].first << "," << pool_snapshot.queueDepth[i].second << "]";
+    }
+    json << "]}";
+  }
+
+  json << "]}";
+
+  return json.str();
+}
+
+double cpooltelemetry::bucketlowersecs(size_t bucket)
+{
+  return (bucket == 0) ? 0.0 : (static_cast<double>(static_cast<uint64_t>(1) << bucket) / 1e6);
+}
+
+size_t cpooltelemetry::bucket(int64_t duration_ns)
+{
+  const auto duration_us = static_cast<uint64_t>(std::max<int64_t>(duration_ns, 0) / 1000);
+  if (duration_us < 2)
+  {
+    return 0;
+  }
+
+  return std::min(static_cast<size_t>(std::bit_width(duration_us) - 1), number_of_buckets - 1);
+}
+
+cpooltelemetry::workercounters & cpooltelemetry::counters(size_t worker_index)
+{
+  return workers[std::min(worker_index, nWorkers - 1)];
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// what a thread pool is doing: per worker busy and parked time, jobs run and jobs stolen, how long jobs sat in the
+// queue and how long they ran, and the queue depth over time. every worker only writes to its own slot (relaxed
+// atomics on their own cache line) so recording a job costs two clock reads and a few uncontended adds. jobs run by
+// threads outside the pool (while they wait on it) share one extra slot
+//
+// the wait and run times go into log2 histograms, bucket b counts durations in [2^b, 2^(b+1)) microseconds (bucket 0
+// also has everything under a microsecond). the queue depth is sampled when jobs are added, at most once per
+// depth_sample_interval_ns, and the last number_of_depth_samples samples are kept. recording is off until
+// setenabled(true) so a pool nobody is watching doesn't pay for it
+
+class cpooltelemetry
+{
+  public:
+    static constexpr size_t number_of_buckets = 24;
+    static constexpr size_t number_of_depth_samples = 256;
+    static constexpr int64_t depth_sample_interval_ns = 10'000'000;
+
+    struct workerstats
+    {
+      uint64_t jobs = 0;
+      uint64_t steals = 0;
+      double busySecs = 0.0;
+      double parkedSecs = 0.0;
+    };
+
+    struct snapshot
+    {
+      std::string poolName;
+      double elapsedSecs = 0.0;
+      // one per worker, the last one is the threads outside the pool
+      std::vector<workerstats> workers;
+      std::array<uint64_t, number_of_buckets> queueWaitHistogram = {};
+      std::array<uint64_t, number_of_buckets> runTimeHistogram = {};
+      // (seconds since the start, depth), oldest first
+      std::vector<std::pair<double, size_t>> queueDepth;
+    };
+
+    explicit cpooltelemetry(std::string pool_name, size_t n_workers);
+
+    cpooltelemetry(const cpooltelemetry &) = delete;
+    cpooltelemetry & operator=(const cpooltelemetry &) = delete;
+
+    void setenabled(bool is_enabled);
+    [[nodiscard]] bool enabled() const;
+
+    // steady clock in nanoseconds, the time stamps passed in below
+    [[nodiscard]] static int64_t now();
+
+    void jobqueued(size_t queue_depth);
+    // queued_at is 0 when the job was added while the telemetry was off (only the run time is counted then)
+    void jobrun(size_t worker_index, int64_t queued_at, int64_t started_at, int64_t finished_at);
+    void jobstolen(size_t worker_index);
+    void workerparked(size_t worker_index, int64_t parked_ns);
+    void reset();
+
+    [[nodiscard]] size_t numberofworkers() const;
+    [[nodiscard]] snapshot takesnapshot() const;
+
+    [[nodiscard]] static std::string tojson(const std::vector<snapshot> & pool_snapshots);
+    [[nodiscard]] static double bucketlowersecs(size_t bucket);
+
+  private:
+    struct alignas(64) workercounters
+    {
+      std::atomic<uint64_t> jobs = 0;
+      std::atomic<uint64_t> steals = 0;
+      std::atomic<uint64_t> busyNs = 0;
+      std::atomic<uint64_t> parkedNs = 0;
+      std::array<std::atomic<uint64_t>, number_of_buckets> queueWait = {};
+      std::array<std::atomic<uint64_t>, number_of_buckets> runTime = {};
+    };
+
+    [[nodiscard]] static size_t bucket(int64_t duration_ns);
+    [[nodiscard]] workercounters & counters(size_t worker_index);
+
+    std::string poolName;
+    size_t nWorkers = 0;
+    std::unique_ptr<workercounters[]> workers;
+    std::atomic<bool> isEnabled = false;
+    std::atomic<int64_t> startTime = 0;
+    std::atomic<int64_t> nextDepthSample = 0;
+
+    mutable std::mutex depthMutex;
+    std::array<std::pair<int64_t, size_t>, number_of_depth_samples> depthSamples = {};
+    size_t depthSampleCount = 0;
+    size_t depthSampleNext = 0;
+};
@@ -0,0 +1,99 @@
+#include "cprogress.h"
+
+#include <chrono>
+#include <algorithm>
+
+void cprogress::begin(size_t total_work)
+{
+  completedWork.store(0, std::memory_order_relaxed);
+  totalWork.store(total_work, std::memory_order_relaxed);
+  beginTimeNs.store(nowns(), std::memory_order_relaxed);
+  finishTimeNs.store(0, std::memory_order_relaxed);
+  isRunning.store(true, std::memory_order_release);
+}
+
+void cprogress::settotal(size_t total_work)
+{
+  // the amount of work is not always known when the operation begins (ex. it depends on the method picked)
+
+  totalWork.store(total_work, std::memory_order_relaxed);
+}
+
+void cprogress::advance(size_t amount)
+{
+  completedWork.fetch_add(amount, std::memory_order_relaxed);
+}
+
+void cprogress::finish()
+{
+  completedWork.store(totalWork.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  finishTimeNs.store(nowns(), std::memory_order_relaxed);
+  isRunning.store(false, std::memory_order_release);
+}
+
+bool cprogress::running() const
+{
+  return isRunning.load(std::memory_order_acquire);
+}
+
+size_t cprogress::completed() const
+{
+  return completedWork.load(std::memory_order_relaxed);
+}
+
+size_t cprogress::total() const
+{
+  return totalWork.load(std::memory_order_relaxed);
+}
+
+float cprogress::fraction() const
+{
+  const size_t total_work = total();
+  if (total_work == 0)
+  {
+    return running() ? 0.0f : 1.0f;
+  }
+
+  return std::clamp(static_cast<float>(completed()) / static_cast<float>(total_work), 0.0f, 1.0f);
+}
+
+float cprogress::elapsedsecs() const
+{
+  const int64_t begin_time = beginTimeNs.load(std::memory_order_relaxed);
+  const int64_t finish_time = finishTimeNs.load(std::memory_order_relaxed);
+  const int64_t end_time = (finish_time > 0) ? finish_time : nowns();
+
+  return static_cast<float>(std::max<int64_t>(end_time - begin_time, 0)) / 1e9f;
+}
+
+float cprogress::throughput() const
+{
+  // completed work units per second since begin()
+
+  const float elapsed_secs = elapsedsecs();
+  if (elapsed_secs <= 0.0f)
+  {
+    return 0.0f;
+  }
+
+  return static_cast<float>(completed()) / elapsed_secs;
+}
+
+float cprogress::etasecs() const
+{
+  const float work_per_sec = throughput();
+  if (work_per_sec <= 0.0f)
+  {
+    return 0.0f;
+  }
+
+  const size_t total_work = total();
+  const size_t completed_work = std::min(completed(), total_work);
+
+  return static_cast<float>(total_work - completed_work) / work_per_sec;
+}
+
+int64_t cprogress::nowns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// progress of a long running operation. the worker threads bump the completed work as they finish a tile/band and
+// any other thread (ui) can read it without taking a lock
+
+class cprogress
+{
+  public:
+    cprogress() = default;
+    ~cprogress() = default;
+
+    cprogress(const cprogress &) = delete;
+    cprogress & operator=(const cprogress &) = delete;
+
+    void begin(size_t total_work);
+    void settotal(size_t total_work);
+    void advance(size_t amount = 1);
+    void finish();
+
+    [[nodiscard]] bool running() const;
+    [[nodiscard]] size_t completed() const;
+    [[nodiscard]] size_t total() const;
+    [[nodiscard]] float fraction() const;
+    [[nodiscard]] float elapsedsecs() const;
+    [[nodiscard]] float throughput() const;
+    [[nodiscard]] float etasecs() const;
+
+  private:
+    static int64_t nowns();
+
+    std::atomic<size_t> totalWork = 0;
+    std::atomic<size_t> completedWork = 0;
+    std::atomic<int64_t> beginTimeNs = 0;
+    std::atomic<int64_t> finishTimeNs = 0;
+    std::atomic<bool> isRunning = false;
+};
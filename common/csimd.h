@@ -0,0 +1,10 @@
+#pragma once
+
+// which simd instructions the image kernels can use. sse2 is part of x86-64 so it needs no runtime check (gcc/clang
+// say so with __SSE2__, msvc with _M_X64 or _M_IX86_FP). every kernel keeps a scalar loop for other cpus and for the
+// pixels left over at the end of a row
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define CSIMD_SSE2 1
+#include <emmintrin.h>
+#endif
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// coroutine task. a function returning ctask<T> starts suspended and runs when it's awaited (co_await) by another
+// coroutine, which is resumed with the result (or the exception) when the task finishes. pool.schedule() moves the
+// coroutine onto a thread of the pool, so a chain like load -> process -> encode -> save is written as plain
+// sequential code while no thread sits blocked between the stages. to_future starts a task from ordinary code (ex. the
+// render loop polls the future), sync_wait blocks until it's done
+
+template<typename T = void>
+class ctask;
+
+namespace ctask_detail {
+  struct finalawaiter
+  {
+    [[nodiscard]] bool await_ready() const noexcept
+    {
+      return false;
+    }
+
+    // resume whoever is waiting on the task right here instead of going back through a queue
+    template<typename promise_type>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+    {
+      const std::coroutine_handle<> continuation = handle.promise().continuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+  };
+
+  struct promisebase
+  {
+    std::suspend_always initial_suspend() const noexcept
+    {
+      return {};
+    }
+
+    finalawaiter final_suspend() const noexcept
+    {
+      return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+      exception = std::current_exception();
+    }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+  };
+
+  template<typename T>
+  struct promise : promisebase
+  {
+    ctask<T> get_return_object() noexcept;
+
+    template<typename value_type>
+    void return_value(value_type && return_value)
+    {
+      value.emplace(std::forward<value_type>(return_value));
+    }
+
+    T result()
+    {
+      if (exception)
+      {
+        std::rethrow_exception(exception);
+      }
+
+      return std::move(*value);
+    }
+
+    std::optional<T> value;
+  };
+
+  template<>
+  struct promise<void> : promisebase
+  {
+    ctask<void> get_return_object() noexcept;
+
+    void return_void() const noexcept
+    {
+    }
+
+    void result() const
+    {
+      if (exception)
+      {
+        std::rethrow_exception(exception);
+      }
+    }
+  };
+
+  // coroutine that starts right away and frees itself when it's done (nobody holds on to it)
+  struct detachedtask
+  {
+    struct promise_type
+    {
+      detachedtask get_return_object() const noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never initial_suspend() const noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never final_suspend() const noexcept
+      {
+        return {};
+      }
+
+      void return_void() const noexcept
+      {
+      }
+
+      void unhandled_exception() const noexcept
+      {
+        std::terminate();
+      }
+    };
+  };
+}
+
+template<typename T>
+class ctask
+{
+  public:
+    using promise_type = ctask_detail::promise<T>;
+    using value_type = T;
+
+    explicit ctask(std::coroutine_handle<promise_type> t_handle) noexcept
+      : handle(t_handle)
+    {
+    }
+
+    ctask(ctask && other) noexcept
+      : handle(std::exchange(other.handle, nullptr))
+    {
+    }
+
+    ctask & operator=(ctask && other) noexcept
+    {
+      if (this != &other)
+      {
+        if (handle)
+        {
+          handle.destroy();
+        }
+
+        handle = std::exchange(other.handle, nullptr);
+      }
+
+      return *this;
+    }
+
+    ctask(const ctask &) = delete;
+    ctask & operator=(const ctask &) = delete;
+
+    ~ctask()
+    {
+      if (handle)
+      {
+        handle.destroy();
+      }
+    }
+
+    // co_await task gives the result (or rethrows the exception of the task)
+    auto operator co_await() && noexcept
+    {
+      return awaiter<true>{handle};
+    }
+
+    // co_await task.whenready() only waits for the task to finish, the result is then taken with result()
+    auto whenready() noexcept
+    {
+      return awaiter<false>{handle};
+    }
+
+    [[nodiscard]] bool ready() const noexcept
+    {
+      return !handle || handle.done();
+    }
+
+    T result()
+    {
+      return handle.promise().result();
+    }
+
+    [[nodiscard]] std::exception_ptr exception() const noexcept
+    {
+      return handle.promise().exception;
+    }
+
+  private:
+    template<bool take_result>
+    struct awaiter
+    {
+      [[nodiscard]] bool await_ready() const noexcept
+      {
+        return !taskHandle || taskHandle.done();
+      }
+
+      // start the task (on this thread). it resumes the awaiting coroutine when it finishes
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+      {
+        taskHandle.promise().continuation = awaiting;
+        return taskHandle;
+      }
+
+      decltype(auto) await_resume()
+      {
+        if constexpr (take_result)
+        {
+          return taskHandle.promise().result();
+        }
+      }
+
+      std::coroutine_handle<promise_type> taskHandle;
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template<typename T>
+ctask<T> ctask_detail::promise<T>::get_return_object() noexcept
+{
+  return ctask<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline ctask<void> ctask_detail::promise<void>::get_return_object() noexcept
+{
+  return ctask<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+// what pool.schedule() returns. awaiting it suspends the coroutine and adds a job to the pool that resumes it, so
+// everything after the co_await runs on a thread of the pool. add_job_type is whatever queues a job on the pool
+template<typename add_job_type>
+class cscheduleawaiter
+{
+  public:
+    explicit cscheduleawaiter(add_job_type && add_job)
+      : addJob(std::move(add_job))
+    {
+    }
+
+    [[nodiscard]] bool await_ready() const noexcept
+    {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      addJob([handle]() {
+        handle.resume();
+      });
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+  private:
+    add_job_type addJob;
+};
+
+namespace ctask_detail {
+  template<typename T>
+  detachedtask runtopromise(ctask<T> task, std::promise<T> result)
+  {
+    co_await task.whenready();
+
+    if (task.exception())
+    {
+      result.set_exception(task.exception());
+    }
+    else if constexpr (std::is_void_v<T>)
+    {
+      result.set_value();
+    }
+    else
+    {
+      result.set_value(task.result());
+    }
+  }
+}
+
+// start the task on the calling thread (it runs until its first co_await of a pool/other task) and get its result
+// through a future. the task is kept alive until it finishes even if the future is dropped
+template<typename T>
+std::future<T> to_future(ctask<T> task)
+{
+  std::promise<T> result;
+  std::future<T> future = result.get_future();
+
+  ctask_detail::runtopromise(std::move(task), std::move(result));
+
+  return future;
+}
+
+// run the task and block until it's done. not meant to be called from a pool thread the task needs
+template<typename T>
+T sync_wait(ctask<T> task)
+{
+  return to_future(std::move(task)).get();
+}
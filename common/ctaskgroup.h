@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <functional>
+#include <vector>
+#include <condition_variable>
+
+// a set of jobs on a pool that can be waited on together. only the jobs added through the group are counted (not
+// everything else queued on the pool) and the count covers running jobs as well as queued ones. the waiting thread
+// runs queued jobs of the pool while it waits instead of sleeping, so waiting from inside a job doesn't tie up a
+// worker. works with any pool that has a job_type, addjob, addjobs and runpendingjob (ex. cworkstealpool)
+//
+// a job that throws still counts as done. the first exception is kept and rethrown by wait() (the destructor only
+// waits, it drops the exception)
+
+template<typename pool_type>
+class ctaskgroup
+{
+  public:
+    explicit ctaskgroup(pool_type & t_pool)
+      : pool(t_pool)
+    {
+    }
+
+    ~ctaskgroup()
+    {
+      waitforjobs();
+    }
+
+    ctaskgroup(const ctaskgroup &) = delete;
+    ctaskgroup & operator=(const ctaskgroup &) = delete;
+
+    template<typename callable>
+    void run(callable && job)
+    {
+      remainingJobs.fetch_add(1);
+
+      pool.addjob([this, job = std::forward<callable>(job)]() mutable {
+        runjob(job);
+      });
+    }
+
+    // job(i) for i in [0, count), added to the pool in one go (one lock, one round of wake-ups)
+    template<typename callable>
+    void runbatch(size_t count, const callable & job)
+    {
+      if (count == 0)
+      {
+        return;
+      }
+
+      remainingJobs.fetch_add(count);
+
+      std::vector<typename pool_type::job_type> jobs;
+      jobs.reserve(count);
+
+      for (size_t i=0; i<count; i++)
+      {
+        jobs.emplace_back([this, job, i]() mutable {
+          runjob([&job, i]() {
+            job(i);
+          });
+        });
+      }
+
+      pool.addjobs(std::move(jobs));
+    }
+
+    void wait()
+    {
+      waitforjobs();
+
+      std::exception_ptr job_exception;
+      {
+        std::lock_guard<std::mutex> lock(groupMutex);
+        std::swap(job_exception, firstException);
+      }
+
+      if (job_exception)
+      {
+        std::rethrow_exception(job_exception);
+      }
+    }
+
+    [[nodiscard]] size_t numberofjobs() const
+    {
+      return remainingJobs.load();
+    }
+
+  private:
+    template<typename job_type>
+    void runjob(job_type && job)
+    {
+      try
+      {
+        job();
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(groupMutex);
+        if (!firstException)
+        {
+          firstException = std::current_exception();
+        }
+      }
+
+      // the lock keeps wait() from returning (and the group from going away) until the notify is done
+
+      std::lock_guard<std::mutex> lock(groupMutex);
+      if (remainingJobs.fetch_sub(1) == 1)
+      {
+        cvGroupDone.notify_all();
+      }
+    }
+
+    void waitforjobs()
+    {
+      while (remainingJobs.load() > 0)
+      {
+        if (pool.runpendingjob())
+        {
+          continue;
+        }
+
+        // nothing left to help with. whatever is left of the group is already running on the workers
+
+        std::unique_lock<std::mutex> lock(groupMutex);
+        cvGroupDone.wait(lock, [this]() -> bool {
+          return (remainingJobs.load() == 0);
+        });
+      }
+
+      std::lock_guard<std::mutex> lock(groupMutex);
+    }
+
+    pool_type & pool;
+    std::atomic<size_t> remainingJobs = 0;
+    std::mutex groupMutex;
+    std::condition_variable cvGroupDone;
+    std::exception_ptr firstException;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// chase-lev work stealing deque (le, pop, cohen, zappa nardelli - "correct and efficient work-stealing for weak
+// memory models"). only the owning worker pushes and takes from the bottom, any other worker can steal from the top.
+// the items are raw pointers so a slot can be read and written with a single atomic
+
+template<typename T>
+class cworkstealdeque
+{
+  static_assert(std::is_pointer_v<T>, "cworkstealdeque only holds pointers");
+
+  public:
+    explicit cworkstealdeque(size_t initial_capacity = 256)
+    {
+      size_t capacity = 1;
+      while (capacity < initial_capacity)
+      {
+        capacity <<= 1;
+      }
+
+      retiredRings.emplace_back(std::make_unique<ring>(capacity));
+      activeRing.store(retiredRings.back().get(), std::memory_order_relaxed);
+    }
+
+    cworkstealdeque(const cworkstealdeque &) = delete;
+    cworkstealdeque & operator=(const cworkstealdeque &) = delete;
+
+    // owner only
+    void push(T item)
+    {
+      const int64_t b = bottom.load(std::memory_order_relaxed);
+      const int64_t t = top.load(std::memory_order_acquire);
+      ring * r = activeRing.load(std::memory_order_relaxed);
+
+      if ((b - t) > static_cast<int64_t>(r->capacity) - 1)
+      {
+        r = grow(r, b, t);
+      }
+
+      r->put(b, item);
+      std::atomic_thread_fence(std::memory_order_release);
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // owner only. returns nullptr when empty or when a thief won the race for the last item
+    T take()
+    {
+      const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+      ring * r = activeRing.load(std::memory_order_relaxed);
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = top.load(std::memory_order_relaxed);
+
+      T item = nullptr;
+
+      if (t <= b)
+      {
+        item = r->get(b);
+
+        if (t == b)
+        {
+          // last item. race any thief for it by moving top instead of bottom
+
+          if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+          {
+            item = nullptr;
+          }
+
+          bottom.store(b + 1, std::memory_order_relaxed);
+        }
+      }
+      else
+      {
+        bottom.store(b + 1, std::memory_order_relaxed);
+      }
+
+      return item;
+    }
+
+    // any thread. returns nullptr when empty or when it lost the race to another thief/the owner
+    T steal()
+    {
+      int64_t t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const int64_t b = bottom.load(std::memory_order_acquire);
+
+      if (t < b)
+      {
+        ring * r = activeRing.load(std::memory_order_acquire);
+        T item = r->get(t);
+
+        if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+          return item;
+        }
+      }
+
+      return nullptr;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+      const int64_t b = bottom.load(std::memory_order_relaxed);
+      const int64_t t = top.load(std::memory_order_relaxed);
+      return (b > t) ? static_cast<size_t>(b - t) : 0;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+      return size() == 0;
+    }
+
+  private:
+    struct ring
+    {
+      explicit ring(size_t ring_capacity)
+        : capacity(ring_capacity)
+        ,mask(ring_capacity - 1)
+        ,slots(std::make_unique<std::atomic<T>[]>(ring_capacity))
+      {
+      }
+
+      T get(int64_t index) const
+      {
+        return slots[static_cast<size_t>(index) & mask].load(std::memory_order_relaxed);
+      }
+
+      void put(int64_t index, T item)
+      {
+        slots[static_cast<size_t>(index) & mask].store(item, std::memory_order_relaxed);
+      }
+
+      size_t capacity;
+      size_t mask;
+      std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    ring * grow(ring * old_ring, int64_t b, int64_t t)
+    {
+      // thieves may still be reading the old ring so it's kept alive (in retiredRings) until the deque goes away.
+      // the rings double so the memory kept around is at most the size of the active ring
+
+      auto new_ring = std::make_unique<ring>(old_ring->capacity * 2);
+      for (int64_t i=t; i<b; i++)
+      {
+        new_ring->put(i, old_ring->get(i));
+      }
+
+      ring * r = new_ring.get();
+      retiredRings.emplace_back(std::move(new_ring));
+      activeRing.store(r, std::memory_order_release);
+
+      return r;
+    }
+
+    alignas(64) std::atomic<int64_t> top = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    alignas(64) std::atomic<ring *> activeRing = nullptr;
+    std::vector<std::unique_ptr<ring>> retiredRings;
+};
@@ -0,0 +1,523 @@
+#include "cworkstealpool.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+namespace {
+  constexpr size_t spin_count = 64;
+  // job nodes a worker keeps for reuse, the rest go back to the allocator
+  constexpr size_t max_free_nodes = 1024;
+  constexpr const char * default_thread_name = "wsp";
+
+  // which pool (and which of its workers) the current thread belongs to. jobs added from a worker go on its own deque
+  thread_local const void * current_pool = nullptr;
+  thread_local size_t current_worker = 0;
+  // priority of the job running on the thread, what jobs it adds get by default
+  thread_local cjobpriority current_priority = cjobpriority::NORMAL;
+
+  size_t priority_index(cjobpriority priority)
+  {
+    return static_cast<size_t>(priority);
+  }
+}
+
+cworkstealpool::cworkstealpool(size_t n_threads)
+  : cworkstealpool(n_threads, std::string(default_thread_name))
+{
+}
+
+cworkstealpool::cworkstealpool(size_t n_threads, const std::string & t_pool_name, size_t queue_capacity)
+  : poolTelemetry(t_pool_name, std::max(static_cast<size_t>(1), n_threads))
+{
+  for (auto & queue : injectionQueues)
+  {
+    queue = std::make_unique<cmpmcqueue<queuedjob>>(queue_capacity);
+  }
+
+  nThreads = std::max(static_cast<size_t>(1), n_threads);
+  name = t_pool_name;
+
+  workerQueues.reserve(nThreads);
+  for (size_t i=0; i<nThreads; i++)
+  {
+    workerQueues.emplace_back(std::make_unique<workerqueue>());
+  }
+
+  threads.reserve(nThreads);
+  for (size_t i=0; i<nThreads; i++)
+  {
+    const std::string thread_name = (t_pool_name + "_" + std::to_string(i));
+    threads.emplace_back(thread_name, &cworkstealpool::threadpooltask, this, i);
+  }
+}
+
+cworkstealpool::~cworkstealpool()
+{
+  running.store(false);
+
+  {
+    std::lock_guard<std::mutex> lock(parkMutex);
+    wakeCount++;
+  }
+  cvJobAvailable.notify_all();
+
+  threads.clear();
+
+  // jobs that never got to run (the ones in the injection queues go with them)
+
+  for (auto & queue : workerQueues)
+  {
+    for (auto & jobs : queue->jobs)
+    {
+      while (queuedjob * node = jobs.take())
+      {
+        delete node;
+      }
+    }
+
+    for (queuedjob * node : queue->freeNodes)
+    {
+      delete node;
+    }
+  }
+}
+
+void cworkstealpool::addjob(job_type && job, cjobpriority priority)
+{
+  pendingJobs.fetch_add(1);
+
+  const int64_t queued_at = poolTelemetry.enabled() ? cpooltelemetry::now() : 0;
+  const size_t queue_depth = queuedJobs.fetch_add(1, std::memory_order_relaxed) + 1;
+
+  if (queued_at > 0)
+  {
+    poolTelemetry.jobqueued(queue_depth);
+  }
+
+  pushjob(queuedjob{std::move(job), queued_at, priority});
+  wakeworkers(1);
+}
+
+void cworkstealpool::addjobs(std::vector<job_type>&& jobs, cjobpriority priority)
+{
+  if (jobs.empty())
+  {
+    return;
+  }
+
+  pendingJobs.fetch_add(jobs.size());
+
+  const int64_t queued_at = poolTelemetry.enabled() ? cpooltelemetry::now() : 0;
+  const size_t queue_depth = queuedJobs.fetch_add(jobs.size(), std::memory_order_relaxed) + jobs.size();
+
+  if (queued_at > 0)
+  {
+    poolTelemetry.jobqueued(queue_depth);
+  }
+
+  // every job is counted as pending, so they all go in even when a job run under backpressure throws
+
+  std::exception_ptr exception;
+  for (auto & job : jobs)
+  {
+    try
+    {
+      pushjob(queuedjob{std::move(job), queued_at, priority});
+    }
+    catch (...)
+    {
+      if (!exception)
+      {
+        exception = std::current_exception();
+      }
+    }
+  }
+
+  wakeworkers(jobs.size());
+
+  if (exception)
+  {
+    std::rethrow_exception(exception);
+  }
+}
+
+void cworkstealpool::waitforthread()
+{
+  // blocks until every job added so far (and anything they added) has finished running, helping with the queued
+  // jobs in the meantime. don't call from a job of this pool since the calling job counts as pending (use a
+  // ctaskgroup there)
+
+  while ((pendingJobs.load() > 0) && runpendingjob())
+  {
+  }
+
+  std::unique_lock<std::mutex> lock(doneMutex);
+  cvJobsDone.wait(lock, [this]() -> bool {
+    return (pendingJobs.load() == 0);
+  });
+}
+
+bool cworkstealpool::runpendingjob()
+{
+  // run one queued job on the calling thread. false when there was nothing to run
+
+  const bool is_worker = (current_pool == this);
+  queuedjob job;
+
+  if (!findjob(is_worker ? current_worker : 0, job))
+  {
+    return false;
+  }
+
+  runjob(job, is_worker ? current_worker : nThreads);
+  return true;
+}
+
+size_t cworkstealpool::threadswaiting() const
+{
+  return nThreads - threadsinuse();
+}
+
+size_t cworkstealpool::threadsinuse() const
+{
+  return busyThreads.load(std::memory_order_relaxed);
+}
+
+size_t cworkstealpool::numberofthreads() const
+{
+  return nThreads;
+}
+
+size_t cworkstealpool::numberofjobs() const
+{
+  return queuedJobs.load(std::memory_order_relaxed);
+}
+
+size_t cworkstealpool::numberofjobs(cjobpriority priority) const
+{
+  // approximate while jobs are being added/taken
+
+  size_t n_jobs = injectionQueues[priority_index(priority)]->size();
+  for (const auto & queue : workerQueues)
+  {
+    n_jobs += queue->jobs[priority_index(priority)].size();
+  }
+
+  return n_jobs;
+}
+
+size_t cworkstealpool::queuecapacity() const
+{
+  return injectionQueues[0]->maxsize();
+}
+
+cjobpriority cworkstealpool::currentpriority()
+{
+  return current_priority;
+}
+
+cpooltelemetry & cworkstealpool::telemetry()
+{
+  return poolTelemetry;
+}
+
+void cworkstealpool::pushjob(queuedjob && job)
+{
+  if (current_pool == this)
+  {
+    const size_t priority = priority_index(job.priority);
+    workerQueues[current_worker]->jobs[priority].push(makenode(std::move(job)));
+  }
+  else
+  {
+    injectjob(std::move(job));
+  }
+}
+
+void cworkstealpool::injectjob(queuedjob && job)
+{
+  // backpressure. a full queue means the workers are behind so the producer works through queued jobs instead of
+  // waiting for them (there's always a queued job to run unless another thread just took it). when one of those
+  // throws the job is still queued (it's counted as pending already) before the exception goes on
+
+  cmpmcqueue<queuedjob> & queue = *injectionQueues[priority_index(job.priority)];
+
+  while (!queue.trypush(std::move(job)))
+  {
+    wakeworkers(nThreads);
+
+    bool has_run_job = false;
+    try
+    {
+      has_run_job = runpendingjob();
+    }
+    catch (...)
+    {
+      while (!queue.trypush(std::move(job)))
+      {
+        std::this_thread::yield();
+      }
+
+      throw;
+    }
+
+    if (!has_run_job)
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+cworkstealpool::queuedjob * cworkstealpool::makenode(queuedjob && job)
+{
+  // only called from a worker of this pool, for its own deque
+
+  std::vector<queuedjob *> & free_nodes = workerQueues[current_worker]->freeNodes;
+
+  if (free_nodes.empty())
+  {
+    return new queuedjob{std::move(job)};
+  }
+
+  queuedjob * node = free_nodes.back();
+  free_nodes.pop_back();
+  *node = std::move(job);
+
+  return node;
+}
+
+void cworkstealpool::takenode(queuedjob * node, queuedjob & job)
+{
+  // the job moves out and the node goes on the free list of the worker that took it (a thread outside the pool has
+  // none so it gives the node back to the allocator)
+
+  job = std::move(*node);
+
+  if ((current_pool == this) && (workerQueues[current_worker]->freeNodes.size() < max_free_nodes))
+  {
+    workerQueues[current_worker]->freeNodes.push_back(node);
+  }
+  else
+  {
+    delete node;
+  }
+}
+
+void cworkstealpool::wakeworkers(size_t n_jobs)
+{
+  // pairs with the fence in threadpooltask before a worker parks. either the worker sees the new job or this sees the
+  // parked worker and bumps wakeCount (under the lock) so its wait can't miss the notify. only as many workers as
+  // there are new jobs get woken up
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  const size_t n_idle = idleThreads.load();
+  if (n_idle == 0)
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(parkMutex);
+    wakeCount++;
+  }
+
+  if (n_jobs >= n_idle)
+  {
+    cvJobAvailable.notify_all();
+  }
+  else
+  {
+    for (size_t i=0; i<n_jobs; i++)
+    {
+      cvJobAvailable.notify_one();
+    }
+  }
+}
+
+void cworkstealpool::runjob(queuedjob & job, size_t worker_index)
+{
+  queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+  busyThreads.fetch_add(1, std::memory_order_relaxed);
+
+  // a job run by a thread that's waiting (helping) puts the waiting job's priority back when it's done
+
+  const cjobpriority outer_priority = current_priority;
+  current_priority = job.priority;
+
+  try
+  {
+    if (poolTelemetry.enabled())
+    {
+      const int64_t started_at = cpooltelemetry::now();
+      job.job();
+      poolTelemetry.jobrun(worker_index, job.queuedAt, started_at, cpooltelemetry::now());
+    }
+    else
+    {
+      job.job();
+    }
+  }
+  catch (...)
+  {
+    // the job still counts as done so waitforthread doesn't hang, the exception goes on to whoever ran it
+
+    job.job.reset();
+    finishjob(outer_priority);
+    throw;
+  }
+
+  job.job.reset();
+  finishjob(outer_priority);
+}
+
+void cworkstealpool::finishjob(cjobpriority outer_priority)
+{
+  current_priority = outer_priority;
+
+  busyThreads.fetch_sub(1, std::memory_order_relaxed);
+
+  if (pendingJobs.fetch_sub(1) == 1)
+  {
+    std::lock_guard<std::mutex> lock(doneMutex);
+    cvJobsDone.notify_all();
+  }
+}
+
+bool cworkstealpool::findjob(size_t thread_index, queuedjob & job)
+{
+  // highest priority first except on every starvation_interval-th take, which starts from NORMAL or BACKGROUND
+  // (alternating) and goes down from there before wrapping around to the higher priorities
+
+  const size_t take_index = takenJobs.load(std::memory_order_relaxed);
+  size_t first_priority = 0;
+
+  if ((take_index % starvation_interval) == (starvation_interval - 1))
+  {
+    first_priority = 1 + ((take_index / starvation_interval) % (number_of_priorities - 1));
+  }
+
+  for (size_t i=0; i<number_of_priorities; i++)
+  {
+    if (findjob(thread_index, (first_priority + i) % number_of_priorities, job))
+    {
+      takenJobs.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool cworkstealpool::findjob(size_t thread_index, size_t priority, queuedjob & job)
+{
+  // own deque first (newest job, still warm in cache), then the injection queue, then the oldest job of another
+  // worker starting with the next one over so thieves spread out. a thread outside the pool has no deque of its own
+
+  const bool is_worker = (current_pool == this);
+
+  if (is_worker)
+  {
+    if (queuedjob * node = workerQueues[thread_index]->jobs[priority].take())
+    {
+      takenode(node, job);
+      return true;
+    }
+  }
+
+  if (injectionQueues[priority]->trypop(job))
+  {
+    return true;
+  }
+
+  for (size_t i=(is_worker ? 1 : 0); i<nThreads; i++)
+  {
+    if (queuedjob * node = workerQueues[(thread_index + i) % nThreads]->jobs[priority].steal())
+    {
+      takenode(node, job);
+
+      if (poolTelemetry.enabled())
+      {
+        poolTelemetry.jobstolen(is_worker ? thread_index : nThreads);
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool cworkstealpool::hasqueuedjobs() const
+{
+  for (const auto & queue : injectionQueues)
+  {
+    if (!queue->empty())
+    {
+      return true;
+    }
+  }
+
+  for (const auto & queue : workerQueues)
+  {
+    for (const auto & jobs : queue->jobs)
+    {
+      if (!jobs.empty())
+      {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+void cworkstealpool::threadpooltask(size_t thread_index)
+{
+  current_pool = this;
+  current_worker = thread_index;
+
+  queuedjob job;
+
+  while (running.load())
+  {
+    bool has_job = findjob(thread_index, job);
+
+    // spin a little before parking. fine grained jobs tend to come in bursts
+
+    for (size_t i=0; !has_job && (i<spin_count); i++)
+    {
+      std::this_thread::yield();
+      has_job = findjob(thread_index, job);
+    }
+
+    if (has_job)
+    {
+      runjob(job, thread_index);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(parkMutex);
+    const uint64_t wake_count = wakeCount;
+
+    idleThreads.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (running.load() && !hasqueuedjobs())
+    {
+      const int64_t parked_at = cpooltelemetry::now();
+
+      cvJobAvailable.wait(lock, [this, wake_count]() -> bool {
+        return (wakeCount != wake_count);
+      });
+
+      if (poolTelemetry.enabled())
+      {
+        poolTelemetry.workerparked(thread_index, cpooltelemetry::now() - parked_at);
+      }
+    }
+
+    idleThreads.fetch_sub(1);
+  }
+}
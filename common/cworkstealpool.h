@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include "cjob.h"
+#include "cjthread.h"
+#include "cmpmcqueue.h"
+#include "cpooltelemetry.h"
+#include "ctask.h"
+#include "cworkstealdeque.h"
+
+// thread pool where every worker owns a deque of jobs. jobs added from outside the pool go through a shared injection
+// queue, jobs added from inside a running job go on the worker's own deque. a worker that runs out of jobs steals from
+// the other workers before parking on a condition variable (no polling). every job is time stamped when it's added so
+// telemetry() can tell how long jobs wait and run, how often workers steal and how long they're parked
+//
+// the jobs are cjob (move-only, small buffer) and the injection queue is a bounded lock-free cmpmcqueue. when it's full
+// the thread adding a job runs queued jobs until there's room (backpressure), so addjob can throw what such a job
+// throws. the pool stays usable after a job throws, a worker doesn't catch it though. the deques hold pointers to job
+// nodes that every worker recycles through a free list of its own, so adding and running a job doesn't touch the
+// allocator once the pool has warmed up
+//
+// every priority has its own injection queue and its own deque per worker. a worker (or a thread helping the pool)
+// looks for an INTERACTIVE job first, then NORMAL, then BACKGROUND, so a view only waits for the jobs already running.
+// every starvation_interval-th take starts from NORMAL or BACKGROUND (in turn) so a steady stream of interactive jobs
+// can't starve the others. a job added without a priority gets the one of the job running on the calling thread (NORMAL
+// outside the pool), so the loops of a BACKGROUND task stay in the background
+
+class cworkstealpool
+{
+  public:
+    using job_type = cjob;
+
+    static constexpr size_t default_queue_capacity = 4096;
+    static constexpr size_t number_of_priorities = 3;
+    static constexpr size_t starvation_interval = 16;
+
+    cworkstealpool() = delete;
+    explicit cworkstealpool(size_t n_threads);
+    explicit cworkstealpool(size_t n_threads, const std::string & t_pool_name, size_t queue_capacity = default_queue_capacity);
+    ~cworkstealpool();
+
+    cworkstealpool(const cworkstealpool &) = delete;
+    cworkstealpool & operator=(const cworkstealpool &) = delete;
+
+    void addjob(job_type && job, cjobpriority priority = currentpriority());
+    void addjobs(std::vector<job_type>&& jobs, cjobpriority priority = currentpriority());
+    void waitforthread();
+    bool runpendingjob();
+
+    // run func on the pool and get its result (or exception) through the future
+    template<typename callable>
+    [[nodiscard]] auto submit(callable && func, cjobpriority priority = currentpriority()) -> std::future<std::invoke_result_t<std::decay_t<callable>>>
+    {
+      using result_type = std::invoke_result_t<std::decay_t<callable>>;
+
+      // jobs are move-only so the packaged task goes straight into the job's buffer
+      std::packaged_task<result_type()> task(std::forward<callable>(func));
+      std::future<result_type> result = task.get_future();
+      addjob([task = std::move(task)]() mutable {
+        task();
+      }, priority);
+
+      return result;
+    }
+
+    // co_await pool.schedule() continues the coroutine on a thread of the pool
+    [[nodiscard]] auto schedule(cjobpriority priority = currentpriority())
+    {
+      return cscheduleawaiter([this, priority](job_type && job) {
+        addjob(std::move(job), priority);
+      });
+    }
+
+    // priority of the job running on the calling thread, NORMAL when it isn't running one
+    [[nodiscard]] static cjobpriority currentpriority();
+
+    [[nodiscard]] size_t threadswaiting() const;
+    [[nodiscard]] size_t threadsinuse() const;
+    [[nodiscard]] size_t numberofthreads() const;
+    [[nodiscard]] size_t numberofjobs() const;
+    [[nodiscard]] size_t numberofjobs(cjobpriority priority) const;
+    [[nodiscard]] size_t queuecapacity() const;
+    [[nodiscard]] cpooltelemetry & telemetry();
+
+  private:
+    struct queuedjob
+    {
+      job_type job;
+      // cpooltelemetry::now() when the job was added, 0 when the telemetry was off
+      int64_t queuedAt = 0;
+      cjobpriority priority = cjobpriority::NORMAL;
+    };
+
+    // a deque per priority. only the owning worker touches freeNodes
+    struct workerqueue
+    {
+      std::array<cworkstealdeque<queuedjob *>, number_of_priorities> jobs;
+      std::vector<queuedjob *> freeNodes;
+    };
+
+    void threadpooltask(size_t thread_index);
+    void pushjob(queuedjob && job);
+    void injectjob(queuedjob && job);
+    void runjob(queuedjob & job, size_t worker_index);
+    void finishjob(cjobpriority outer_priority);
+    void wakeworkers(size_t n_jobs);
+    [[nodiscard]] queuedjob * makenode(queuedjob && job);
+    void takenode(queuedjob * node, queuedjob & job);
+    [[nodiscard]] bool findjob(size_t thread_index, queuedjob & job);
+    [[nodiscard]] bool findjob(size_t thread_index, size_t priority, queuedjob & job);
+    [[nodiscard]] bool hasqueuedjobs() const;
+
+    std::vector<std::unique_ptr<workerqueue>> workerQueues;
+    std::array<std::unique_ptr<cmpmcqueue<queuedjob>>, number_of_priorities> injectionQueues;
+    std::mutex parkMutex;
+    std::mutex doneMutex;
+    std::condition_variable cvJobAvailable;
+    std::condition_variable cvJobsDone;
+    uint64_t wakeCount = 0;
+    std::atomic<size_t> queuedJobs = 0;
+    std::atomic<size_t> takenJobs = 0;
+    std::atomic<size_t> pendingJobs = 0;
+    std::atomic<size_t> idleThreads = 0;
+    std::atomic<size_t> busyThreads = 0;
+    std::atomic<bool> running = true;
+    std::string name = "wsp";
+    size_t nThreads = 0;
+    cpooltelemetry poolTelemetry;
+
+    // last so the workers are joined before anything they use is destroyed
+    std::vector<cjthread> threads;
+};
@@ -1,5 +1,6 @@
 #include <string_view>
 #include <thread>
+#include <future>
 #include <fstream>
 
 #include <imgui.h>
@@ -26,8 +27,18 @@
 #include "operations/HistogramEqualizationOp.h"
 #include "menus/SpatialFilterMenu.h"
 #include "operations/SpatialFilterOp.h"
+#include "menus/ResampleMenu.h"
+#include "operations/ResampleOp.h"
+#include "menus/PoolTelemetryMenu.h"
+#include "menus/LazyViewMenu.h"
+#include "operations/LazyImage.h"
 #include "operations/RunLengthCodec.h"
 #include "operations/VariableLengthCodec.h"
+#include "operations/NetpbmCodec.h"
+#include "common/ccpubudget.h"
+#include "common/cimageview.h"
+#include "common/cpoolregistry.h"
+#include "common/ctask.h"
 
 #define USE_ON_RESIZING true
 
@@ -48,6 +59,25 @@ void onResizing(const sf::Event& event
                ,sf::Texture& tex
                );
 
+std::string FileExtension(const std::string & file_path);
+
+cimageview PixelsView(const sf::Image & image);
+
+void ShowLazyOutput(LazyImage & lazy_image
+                   ,LazyViewMenu & lazy_view_menu
+                   ,const sf::Vector2u & view_size
+                   ,bool export_requested
+                   ,std::future<bool> & export_task
+                   ,sf::Image & processed_image
+                   ,sf::Texture & processed_texture
+                   ,sf::Sprite & processed_sprite);
+
+ctask<void> HistogramEqualizationTask(HistogramEqualizationOp & histogrameq_op
+                                     ,MenuOp_HistogramMethod histogram_method
+                                     ,std::string source_file_path
+                                     ,cimageview source_image
+                                     ,bool & is_16bit);
+
 int main(int argc, char*argv[])
 {
   constexpr std::string_view window_name = "DipTool";
@@ -101,6 +131,8 @@ int main(int argc, char*argv[])
     }
   }
 
+  spdlog::info("cpu budget: {}", ccpubudget::description());
+
   // setup sfml window
   spdlog::info("initializing window...");
 
@@ -229,10 +261,13 @@ void RenderTask(sf::RenderWindow & window
   DownsampleOp downsample_op;
   DownsampleMenu downsample_menu;
   int32_t current_downsample_level = -1;
+  MenuOp_Downsample current_downsample_operation = MenuOp_Downsample::DECIMATE;
+  bool current_downsample_pyramid = true;
 
   UpsampleOp upsample_op;
   UpsampleMenu upsample_menu;
   int32_t current_upsample_level = -1;
+  bool current_upsample_lazy = false;
 
   VaryBitsOp varyingbits_op;
   VaryBitsMenu varyingbits_menu;
@@ -240,13 +275,29 @@ void RenderTask(sf::RenderWindow & window
 
   HistogramEqualizationOp histogrameq_op;
   HistogramEqualizationMenu histogrameq_menu;
+  std::future<void> histogrameq_task;
+  bool histogrameq_is_16bit = false;
+  bool histogrameq_is_stale = false;
+  histogrameq_menu.SetProgress(histogrameq_op.GetProgress());
 
   SpatialFilterMenu spatial_filter_menu;
   SpatialFilterOp spatial_op;
+  std::future<std::vector<uint8_t>> spatial_task;
+  spatial_filter_menu.SetProgress(spatial_op.GetProgress());
+
+  ResampleMenu resample_menu;
+  ResampleOp resample_op;
+  std::future<std::vector<uint8_t>> resample_task;
+  resample_menu.SetProgress(resample_op.GetProgress());
 
   RunLengthCodec rl_coding;
   VariableLengthCodec vl_codec;
 
+  PoolTelemetryMenu pool_telemetry_menu;
+
+  LazyViewMenu lazy_view_menu;
+  std::future<bool> lazy_export_task;
+
   Menu menu;
   menu.SetImagePath(image_file_path);
 
@@ -264,16 +315,45 @@ void RenderTask(sf::RenderWindow & window
 
     // GUI and operations
     menu.RenderMenu(loaded_image, loaded_texture, loaded_image_plane);
+
+    if (menu.IsImageChanged())
+    {
+      // a histogram result (16-bit or not) belongs to the image it was made from. a running task isn't waited for (that
+      // would stall the frame), it's marked stale and dropped once it's done
+
+      histogrameq_is_stale = histogrameq_task.valid();
+      histogrameq_is_16bit = false;
+    }
+
+    if (histogrameq_is_stale && (histogrameq_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+    {
+      // the task set the 16-bit flag for the previous image
+      histogrameq_task = std::future<void>();
+      histogrameq_is_16bit = false;
+      histogrameq_is_stale = false;
+    }
+
+    pool_telemetry_menu.SetShowing(menu.IsShowingPoolTelemetry());
+    if (menu.IsShowingPoolTelemetry())
+    {
+      pool_telemetry_menu.RenderMenu();
+    }
+
     if(menu.IsDownSampleSet())
     {
       downsample_menu.RenderMenu();
 
-      if (current_downsample_level != downsample_menu.DownsampleIterations())
+      // the op keeps the pyramid of the source (unless caching is off), only a new image or operation rebuilds it
+
+      if ((current_downsample_level != downsample_menu.DownsampleIterations()) || (current_downsample_operation != downsample_menu.CurrentOperation()) || (current_downsample_pyramid != downsample_menu.IsPyramidCaching()))
       {
         current_downsample_level = downsample_menu.DownsampleIterations();
+        current_downsample_operation = downsample_menu.CurrentOperation();
+        current_downsample_pyramid = downsample_menu.IsPyramidCaching();
+
+        downsample_op.SetPyramidCaching(current_downsample_pyramid);
 
-        std::vector<uint8_t> source_pixels (loaded_image.getPixelsPtr(), (loaded_image.getPixelsPtr()+(loaded_image.getSize().x * loaded_image.getSize().y * 4)));
-        downsample_op.ProcessImage(downsample_menu.CurrentOperation(), source_pixels, loaded_image.getSize().x, loaded_image.getSize().y, 4, downsample_menu.DownsampleIterations());
+        downsample_op.ProcessImage(downsample_menu.CurrentOperation(), PixelsView(loaded_image), downsample_menu.DownsampleIterations());
 
         const auto & result_image = downsample_op.GetImage();
         processed_image.create(downsample_op.GetWidth(), downsample_op.GetHeight(), result_image.data());
@@ -305,30 +385,45 @@ void RenderTask(sf::RenderWindow & window
     {
       upsample_menu.RenderMenu();
 
-      if (current_upsample_level != upsample_menu.UpsampleIterations())
+      // the lazy output is read by its export so it's only replaced once the export is done
+
+      if (((current_upsample_level != upsample_menu.UpsampleIterations()) || (current_upsample_lazy != upsample_menu.IsLazy())) && !lazy_export_task.valid())
       {
         current_upsample_level = upsample_menu.UpsampleIterations();
+        current_upsample_lazy = upsample_menu.IsLazy();
 
-        std::vector<uint8_t> source_pixels;
+        const sf::Image & source_image = menu.IsOutputAsSourceSet() ? processed_image_copy : loaded_image;
 
-        if (menu.IsOutputAsSourceSet())
+        if (current_upsample_lazy)
         {
-          source_pixels = std::vector<uint8_t>(processed_image_copy.getPixelsPtr(), (processed_image_copy.getPixelsPtr() + (processed_image_copy.getSize().x * processed_image_copy.getSize().y * 4)));
-          upsample_op.ProcessImage(upsample_menu.CurrentOperation(), source_pixels, processed_image_copy.getSize().x, processed_image_copy.getSize().y, 4, upsample_menu.UpsampleIterations());
+          upsample_op.ProcessLazy(upsample_menu.CurrentOperation(), PixelsView(source_image), upsample_menu.UpsampleIterations());
+          lazy_view_menu.Refresh();
         }
         else
         {
-          source_pixels = std::vector<uint8_t>(loaded_image.getPixelsPtr(), (loaded_image.getPixelsPtr() + (loaded_image.getSize().x * loaded_image.getSize().y * 4)));
-          upsample_op.ProcessImage(upsample_menu.CurrentOperation(), source_pixels, loaded_image.getSize().x, loaded_image.getSize().y, 4, upsample_menu.UpsampleIterations());
-        }
+          upsample_op.ProcessImage(upsample_menu.CurrentOperation(), PixelsView(source_image), upsample_menu.UpsampleIterations());
 
-        const auto & result_image = upsample_op.GetImage();
-        processed_image.create(upsample_op.GetWidth(), upsample_op.GetHeight(), result_image.data());
-        processed_texture.loadFromImage(processed_image);
-        processed_sprite = sf::Sprite(processed_texture);
+          const auto & result_image = upsample_op.GetImage();
+          processed_image.create(upsample_op.GetWidth(), upsample_op.GetHeight(), result_image.data());
+          processed_texture.loadFromImage(processed_image);
+          processed_sprite = sf::Sprite(processed_texture);
+        }
       }
 
-      if (upsample_menu.ProcessBegin())
+      if (current_upsample_lazy)
+      {
+        // saving a lazy output exports all of it instead of the view
+
+        ShowLazyOutput(upsample_op.GetLazyImage()
+                      ,lazy_view_menu
+                      ,loaded_image.getSize()
+                      ,upsample_menu.ProcessBegin()
+                      ,lazy_export_task
+                      ,processed_image
+                      ,processed_texture
+                      ,processed_sprite);
+      }
+      else if (upsample_menu.ProcessBegin())
       {
         if (processed_image.saveToFile("output.png"))
         {
@@ -351,8 +446,7 @@ void RenderTask(sf::RenderWindow & window
 
         varyingbits_op.SetUseColorChannels(varyingbits_menu.UseColorChannels());
 
-        std::vector<uint8_t> source_pixels (loaded_image.getPixelsPtr(), (loaded_image.getPixelsPtr()+(loaded_image.getSize().x * loaded_image.getSize().y * 4)));
-        varyingbits_op.ProcessImage(varyingbits_menu.BitScale(), varyingbits_menu.ShiftBitsForContrast(), source_pixels, loaded_image.getSize().x, loaded_image.getSize().y, 4);
+        varyingbits_op.ProcessImage(varyingbits_menu.BitScale(), varyingbits_menu.ShiftBitsForContrast(), PixelsView(loaded_image));
 
         const auto & result_image = varyingbits_op.GetImage();
         processed_image.create(varyingbits_op.GetWidth(), varyingbits_op.GetHeight(), result_image.data());
@@ -368,8 +462,7 @@ void RenderTask(sf::RenderWindow & window
 
         varyingbits_op.SetUseColorChannels(varyingbits_menu.UseColorChannels());
 
-        std::vector<uint8_t> source_pixels (loaded_image.getPixelsPtr(), (loaded_image.getPixelsPtr()+(loaded_image.getSize().x * loaded_image.getSize().y * 4)));
-        varyingbits_op.ProcessImage(-1, varyingbits_menu.ShiftBitsForContrast(), source_pixels, loaded_image.getSize().x, loaded_image.getSize().y, 4);
+        varyingbits_op.ProcessImage(-1, varyingbits_menu.ShiftBitsForContrast(), PixelsView(loaded_image));
 
         const auto & result_image = varyingbits_op.GetImage();
         processed_image.create(varyingbits_op.GetWidth(), varyingbits_op.GetHeight(), result_image.data());
@@ -383,7 +476,38 @@ void RenderTask(sf::RenderWindow & window
       histogrameq_menu.RenderMenu();
       histogrameq_menu.SetSizeOfImage(static_cast<int32_t>(loaded_image.getSize().x), static_cast<int32_t>(loaded_image.getSize().y));
 
-      if (histogrameq_menu.ProcessBegin())
+      // load the target histogram for the specification method. a text file holds the histogram values, anything
+      // else is loaded as a reference image
+
+      if (!histogrameq_task.valid() && histogrameq_menu.TargetFileChanged())
+      {
+        const std::string target_file_path = histogrameq_menu.GetTargetFilePath();
+        const std::string target_file_ext = FileExtension(target_file_path);
+
+        sf::Image target_image;
+        bool is_target_loaded = false;
+
+        if ((target_file_ext == "txt") || (target_file_ext == "csv"))
+        {
+          is_target_loaded = histogrameq_op.LoadTargetHistogram(target_file_path);
+        }
+        else if (target_image.loadFromFile(target_file_path))
+        {
+          std::vector<uint8_t> target_pixels (target_image.getPixelsPtr(), (target_image.getPixelsPtr()+(target_image.getSize().x * target_image.getSize().y * 4)));
+          is_target_loaded = histogrameq_op.SetTargetHistogram(target_pixels, target_image.getSize().x, target_image.getSize().y, 4);
+        }
+        else
+        {
+          spdlog::warn("unable to load target image: {}", target_file_path);
+        }
+
+        histogrameq_menu.SetTargetLoaded(is_target_loaded);
+      }
+
+      // the operation runs on the shared pool so the window keeps rendering (and the menu can show the progress).
+      // the op is not touched again until the task is done
+
+      if (histogrameq_menu.ProcessBegin() && !histogrameq_task.valid())
       {
         histogrameq_menu.ClearData();
 
@@ -397,52 +521,45 @@ void RenderTask(sf::RenderWindow & window
           histogrameq_op.SetHistogramColorType(MenuOp_HistogramColor::RGBA);
         }
 
-        std::vector<uint8_t> source_pixels (loaded_image.getPixelsPtr(), (loaded_image.getPixelsPtr()+(loaded_image.getSize().x * loaded_image.getSize().y * 4)));
-
-        std::chrono::high_resolution_clock::time_point process_time_begin;
-        std::chrono::high_resolution_clock::time_point process_time_end;
-
-        if (histogrameq_menu.IsGlobalMethodType())
-        {
-          process_time_begin = std::chrono::high_resolution_clock::now();
-          histogrameq_op.ProcessImage(MenuOp_HistogramMethod::GLOBAL
-                                     ,source_pixels
-                                     ,loaded_image.getSize().x
-                                     ,loaded_image.getSize().y
-                                     ,4
-                                     ,0);
-          process_time_end = std::chrono::high_resolution_clock::now();
-        }
+        MenuOp_HistogramMethod histogram_method = MenuOp_HistogramMethod::GLOBAL;
 
         if (histogrameq_menu.IsLocalizeMethodType())
         {
           histogrameq_op.SetLocalizeKernelSize(histogrameq_menu.GetKernelX(), histogrameq_menu.GetKernelY());
-          process_time_begin = std::chrono::high_resolution_clock::now();
-          histogrameq_op.ProcessImage(MenuOp_HistogramMethod::LOCALIZE
-                                     ,source_pixels
-                                     ,loaded_image.getSize().x
-                                     ,loaded_image.getSize().y
-                                     ,4
-                                     ,0);
-          process_time_end = std::chrono::high_resolution_clock::now();
+          histogram_method = MenuOp_HistogramMethod::LOCALIZE;
         }
 
         if (histogrameq_menu.IsLocalizeEnchancementMethodType())
         {
           histogrameq_op.SetLocalizeKernelSize(histogrameq_menu.GetKernelX(), histogrameq_menu.GetKernelY());
           histogrameq_op.SetLocalizeKernelConstants(histogrameq_menu.GetKernelK0(), histogrameq_menu.GetKernelK1(), histogrameq_menu.GetKernelK2(), histogrameq_menu.GetKernelK3(), histogrameq_menu.GetKernelEnhanceConst());
-          process_time_begin = std::chrono::high_resolution_clock::now();
-          histogrameq_op.ProcessImage(MenuOp_HistogramMethod::LOCALIZE_ENCHANCEMENT
-                                     ,source_pixels
-                                     ,loaded_image.getSize().x
-                                     ,loaded_image.getSize().y
-                                     ,4
-                                     ,0);
-          process_time_end = std::chrono::high_resolution_clock::now();
+          histogram_method = MenuOp_HistogramMethod::LOCALIZE_ENCHANCEMENT;
         }
 
-        float process_time_secs = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(process_time_end - process_time_begin).count()) / 1e6f;
-        histogrameq_menu.SetProcessTime(process_time_secs);
+        if (histogrameq_menu.IsClaheMethodType())
+        {
+          histogrameq_op.SetClaheTileGrid(histogrameq_menu.GetClaheTilesX(), histogrameq_menu.GetClaheTilesY());
+          histogrameq_op.SetClaheClipLimit(histogrameq_menu.GetClaheClipLimit());
+          histogram_method = MenuOp_HistogramMethod::CLAHE;
+        }
+
+        if (histogrameq_menu.IsSpecificationMethodType())
+        {
+          histogram_method = MenuOp_HistogramMethod::SPECIFICATION;
+        }
+
+        histogrameq_task = to_future(HistogramEqualizationTask(histogrameq_op
+                                                              ,histogram_method
+                                                              ,menu.FileInputPath()
+                                                              ,PixelsView(loaded_image).owned()
+                                                              ,histogrameq_is_16bit));
+      }
+
+      if (histogrameq_task.valid() && !histogrameq_is_stale && (histogrameq_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+      {
+        histogrameq_task.get();
+
+        histogrameq_menu.SetProcessTime(histogrameq_op.GetProgress().elapsedsecs());
 
         std::vector<std::map<int32_t, float>> histograms_source;
         std::vector<std::map<int32_t, float>> histograms_remap;
@@ -476,10 +593,8 @@ void RenderTask(sf::RenderWindow & window
     {
       spatial_filter_menu.RenderMenu();
 
-      if (spatial_filter_menu.ProcessBegin())
+      if (spatial_filter_menu.ProcessBegin() && !spatial_task.valid())
       {
-        std::vector<uint8_t> source_pixels (loaded_image.getPixelsPtr(), (loaded_image.getPixelsPtr()+(loaded_image.getSize().x * loaded_image.getSize().y * 4)));
-
         spatial_op.SetKernelSize(spatial_filter_menu.GetKernelX(), spatial_filter_menu.GetKernelY());
 
         if (spatial_filter_menu.CurrentOperation() == MenuOp_SpatialFilter::SHARPENING)
@@ -508,12 +623,14 @@ void RenderTask(sf::RenderWindow & window
           spatial_op.SetAlphaTrimConstant(spatial_filter_menu.GetAlphaTrimConstant());
         }
 
-        spatial_op.ProcessImage(spatial_filter_menu.CurrentOperation()
-                               ,source_pixels
-                               ,loaded_image.getSize().x
-                               ,loaded_image.getSize().y
-                               ,4
-                               ,0);
+        spatial_task = to_future(spatial_op.ProcessImageAsync(spatial_filter_menu.CurrentOperation()
+                                                             ,PixelsView(loaded_image)
+                                                             ,0));
+      }
+
+      if (spatial_task.valid() && (spatial_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+      {
+        spatial_task.get();
 
         const auto & result_image = spatial_op.GetImage();
         processed_image.create(spatial_op.GetWidth(), spatial_op.GetHeight(), result_image.data());
@@ -522,6 +639,64 @@ void RenderTask(sf::RenderWindow & window
       }
     }
 
+    if (menu.IsResampling())
+    {
+      resample_menu.RenderMenu();
+      resample_menu.SetSizeOfImage(static_cast<int32_t>(loaded_image.getSize().x), static_cast<int32_t>(loaded_image.getSize().y));
+
+      if (resample_menu.ProcessBegin() && !resample_task.valid() && !lazy_export_task.valid())
+      {
+        if (resample_menu.IsLazy())
+        {
+          // only the filter taps are computed up front, the view evaluates the rest
+          resample_op.ProcessLazy(resample_menu.CurrentOperation()
+                                 ,PixelsView(loaded_image)
+                                 ,resample_menu.GetTargetWidth()
+                                 ,resample_menu.GetTargetHeight());
+          lazy_view_menu.Refresh();
+        }
+        else
+        {
+          resample_task = to_future(resample_op.ProcessImageAsync(resample_menu.CurrentOperation()
+                                                                 ,PixelsView(loaded_image)
+                                                                 ,resample_menu.GetTargetWidth()
+                                                                 ,resample_menu.GetTargetHeight()));
+        }
+      }
+
+      // a (non lazy) resample drops the lazy output, until it's done the op is left to its task
+
+      if (!resample_task.valid() && !resample_op.GetLazyImage().IsEmpty())
+      {
+        ShowLazyOutput(resample_op.GetLazyImage()
+                      ,lazy_view_menu
+                      ,loaded_image.getSize()
+                      ,false
+                      ,lazy_export_task
+                      ,processed_image
+                      ,processed_texture
+                      ,processed_sprite);
+      }
+
+      if (resample_task.valid() && (resample_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+      {
+        resample_task.get();
+
+        const auto & result_image = resample_op.GetImage();
+        processed_image.create(resample_op.GetWidth(), resample_op.GetHeight(), result_image.data());
+        processed_texture.loadFromImage(processed_image);
+        processed_sprite = sf::Sprite(processed_texture);
+      }
+    }
+
+    if (lazy_export_task.valid() && (lazy_export_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+    {
+      if (lazy_export_task.get())
+      {
+        spdlog::info("lazy output was exported!");
+      }
+    }
+
     if (menu.IsSavingOutput())
     {
       if (menu.IsOutputPNG())
@@ -574,6 +749,23 @@ void RenderTask(sf::RenderWindow & window
       {
         spdlog::warn("output buffer was empty! no processed image to save!");
       }
+
+      // keep the full precision result of a 16-bit histogram operation next to the 8-bit output
+
+      if (menu.IsHistogramEqualizationSet() && histogrameq_is_16bit && !histogrameq_task.valid())
+      {
+        const std::string output_file_ext = (histogrameq_op.GetChannels16() == 1) ? ".pgm" : ".ppm";
+
+        if (NetpbmCodec::Write(menu.FileOutputPath() + output_file_ext
+                              ,histogrameq_op.GetImage16()
+                              ,histogrameq_op.GetWidth()
+                              ,histogrameq_op.GetHeight()
+                              ,histogrameq_op.GetChannels16()
+                              ,histogrameq_op.GetMaxValue16()))
+        {
+          spdlog::info("save processed 16-bit image");
+        }
+      }
     }
 
     // Render
@@ -600,6 +792,28 @@ void RenderTask(sf::RenderWindow & window
     window.display();
   }
 
+  // the tasks still use the ops (and the ops go away with this function)
+
+  if (histogrameq_task.valid())
+  {
+    histogrameq_task.wait();
+  }
+
+  if (spatial_task.valid())
+  {
+    spatial_task.wait();
+  }
+
+  if (resample_task.valid())
+  {
+    resample_task.wait();
+  }
+
+  if (lazy_export_task.valid())
+  {
+    lazy_export_task.wait();
+  }
+
   window.setActive(false);
 }
 
@@ -629,3 +843,98 @@ void onResizing(const sf::Event& event
 
   window.setSize(sf::Vector2u(event.size.width, event.size.height));
 }
+
+std::string FileExtension(const std::string & file_path)
+{
+  // lower case extension of the file (without the '.')
+
+  std::string file_ext = file_path.substr(file_path.find_last_of('.') + 1);
+  for (auto & c : file_ext)
+  {
+    c = static_cast<char>(std::tolower(static_cast<int32_t>(c)));
+  }
+
+  return file_ext;
+}
+
+cimageview PixelsView(const sf::Image & image)
+{
+  // the ops read the pixels of the image in place (rgba rows, packed), an async op copies them when it starts
+  return cimageview(image.getPixelsPtr(), image.getSize().x, image.getSize().y, 4);
+}
+
+ctask<void> HistogramEqualizationTask(HistogramEqualizationOp & histogrameq_op
+                                     ,MenuOp_HistogramMethod histogram_method
+                                     ,std::string source_file_path
+                                     ,cimageview source_image
+                                     ,bool & is_16bit)
+{
+  // high bit depth netpbm sources are processed at full precision, the loaded image (converted to 8-bit) is only used
+  // to show the source. only the global method has a 16-bit version, the others run on the 8-bit image instead of
+  // handing the source back unchanged. the source file is read on the io pool, the op then moves to the shared one
+
+  const std::string source_file_ext = FileExtension(source_file_path);
+  std::vector<uint16_t> source_pixels16;
+  uint32_t source_width16 = 0;
+  uint32_t source_height16 = 0;
+  uint8_t source_channels16 = 0;
+  uint16_t source_max_value16 = 0;
+
+  is_16bit = false;
+  if ((histogram_method == MenuOp_HistogramMethod::GLOBAL) && ((source_file_ext == "pgm") || (source_file_ext == "ppm")))
+  {
+    source_image = source_image.owned();
+    co_await cpoolregistry::io().schedule(cjobpriority::BACKGROUND);
+
+    is_16bit = NetpbmCodec::Read(source_file_path, source_pixels16, source_width16, source_height16, source_channels16, source_max_value16)
+            && (source_max_value16 > 255);
+  }
+
+  if (is_16bit)
+  {
+    co_await histogrameq_op.ProcessImage16Async(histogram_method, std::move(source_pixels16), source_width16, source_height16, source_channels16, source_max_value16);
+  }
+  else
+  {
+    co_await histogrameq_op.ProcessImageAsync(histogram_method, std::move(source_image), 0);
+  }
+}
+
+void ShowLazyOutput(LazyImage & lazy_image
+                   ,LazyViewMenu & lazy_view_menu
+                   ,const sf::Vector2u & view_size
+                   ,bool export_requested
+                   ,std::future<bool> & export_task
+                   ,sf::Image & processed_image
+                   ,sf::Texture & processed_texture
+                   ,sf::Sprite & processed_sprite)
+{
+  // the processed image is the view (as big as the loaded image) and only changes with it. the tiles of the view are
+  // evaluated on the pool, until they're done the view shows a coarser level where it has one and is asked for every
+  // frame
+
+  lazy_view_menu.RenderMenu(lazy_image);
+
+  if ((lazy_view_menu.ViewChanged() || lazy_image.IsViewPending()) && (view_size != sf::Vector2u(0, 0)))
+  {
+    const auto view_width = static_cast<int32_t>(view_size.x);
+    const auto view_height = static_cast<int32_t>(view_size.y);
+    int32_t view_x = 0;
+    int32_t view_y = 0;
+    lazy_view_menu.ViewOrigin(lazy_image, view_width, view_height, view_x, view_y);
+
+    std::vector<uint8_t> view_pixels;
+    if (lazy_image.RenderView(lazy_view_menu.ViewLevel(), view_x, view_y, view_width, view_height, view_pixels))
+    {
+      processed_image.create(view_size.x, view_size.y, view_pixels.data());
+      processed_texture.loadFromImage(processed_image);
+      processed_sprite = sf::Sprite(processed_texture);
+    }
+  }
+
+  if ((lazy_view_menu.ExportBegin() || export_requested) && !export_task.valid())
+  {
+    spdlog::info("exporting lazy output to {}...", lazy_view_menu.ExportPath());
+    export_task = to_future(lazy_image.WritePamAsync(lazy_view_menu.ExportPath()));
+  }
+}
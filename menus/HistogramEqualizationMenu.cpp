@@ -6,6 +6,9 @@
 #include <imgui.h>
 #include <implot/implot.h>
 #include <spdlog/spdlog.h>
+#include "MenuWidgets.h"
+
+#include <tinyfiledialogs/tinyfiledialogs.h>
 
 namespace {
   bool ButtonCenteredOnLine(const char* label)
@@ -137,6 +140,22 @@ void HistogramEqualizationMenu::RenderMenu()
     operation = MenuOp_HistogramMethod::LOCALIZE_ENCHANCEMENT;
   }
 
+  ImGui::SameLine();
+
+  if (ImGui::RadioButton("CLAHE", (setMethodType == 3)))
+  {
+    setMethodType = 3;
+    operation = MenuOp_HistogramMethod::CLAHE;
+  }
+
+  ImGui::SameLine();
+
+  if (ImGui::RadioButton("Specification", (setMethodType == 4)))
+  {
+    setMethodType = 4;
+    operation = MenuOp_HistogramMethod::SPECIFICATION;
+  }
+
   ImGui::EndGroup();
 
   if (setMethodType == 1)
@@ -179,6 +198,66 @@ void HistogramEqualizationMenu::RenderMenu()
     ImGui::EndGroup();
   }
 
+  if (setMethodType == 3)
+  {
+    ImGui::BeginGroup();
+
+    ImGui::Text("tiles:");
+    ImGui::InputInt("##clahe_tiles_x", &claheTilesX, 1, 8, ImGuiInputTextFlags_::ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_::ImGuiInputTextFlags_AutoSelectAll);
+    ImGui::SameLine();
+    ImGui::Text("X");
+    ImGui::SameLine();
+    ImGui::InputInt("##clahe_tiles_y", &claheTilesY, 1, 8, ImGuiInputTextFlags_::ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_::ImGuiInputTextFlags_AutoSelectAll);
+
+    ImGui::NewLine();
+
+    ImGui::InputFloat("clip limit", &claheClipLimit, 0.1f, 1.0f, "%.2f", ImGuiInputTextFlags_::ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_::ImGuiInputTextFlags_AutoSelectAll);
+
+    ImGui::EndGroup();
+  }
+
+  if (setMethodType == 4)
+  {
+    ImGui::BeginGroup();
+
+    // the target can be a reference image or a text file of 256 (or 3x256 for rgb) histogram values
+
+    if (ImGui::Button("Load Target"))
+    {
+      char const * file_filter[4] = {"*.png", "*.jpg", "*.txt", "*.csv"};
+      auto selected_file = tinyfd_openFileDialog("Load Target Image/Histogram"
+          ,nullptr
+          ,4
+          ,file_filter
+          ,"target image or histogram files"
+          ,0
+      );
+
+      if (selected_file)
+      {
+        targetFilePath = std::string(selected_file);
+        targetFileChanged = true;
+      }
+    }
+
+    ImGui::SameLine();
+
+    if (!targetLoadError.empty())
+    {
+      ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "target: %s", targetLoadError.c_str());
+    }
+    else
+    {
+      ImGui::Text("target: %s", targetFilePath.empty() ? "none" : targetFilePath.c_str());
+    }
+
+    ImGui::EndGroup();
+  }
+
+  claheTilesX = std::clamp(claheTilesX, 1, imagePixelWidth);
+  claheTilesY = std::clamp(claheTilesY, 1, imagePixelHeight);
+  claheClipLimit = std::max(claheClipLimit, 1.0f);
+
   localizeKernelX = std::clamp(localizeKernelX, 1, imagePixelWidth);
   localizeKernelY = std::clamp(localizeKernelY, 1, imagePixelHeight);
 
@@ -202,7 +281,11 @@ void HistogramEqualizationMenu::RenderMenu()
 
   ImGui::EndGroup();
 
-  if (ButtonCenteredOnLine("Generate Histogram Equalization"))
+  if ((processProgress != nullptr) && processProgress->running())
+  {
+    ProgressBarWithRate(*processProgress);
+  }
+  else if (ButtonCenteredOnLine("Generate Histogram Equalization"))
   {
     processBegin = true;
   }
@@ -234,6 +317,11 @@ void HistogramEqualizationMenu::SetProcessTime(float process_time)
   processTimeSecs = process_time;
 }
 
+void HistogramEqualizationMenu::SetProgress(const cprogress & progress)
+{
+  processProgress = &progress;
+}
+
 void HistogramEqualizationMenu::SetSizeOfImage(int32_t pixel_width, int32_t pixel_height)
 {
   imagePixelWidth = pixel_width;
@@ -265,6 +353,16 @@ bool HistogramEqualizationMenu::IsLocalizeEnchancementMethodType() const
   return (setMethodType == 2);
 }
 
+bool HistogramEqualizationMenu::IsClaheMethodType() const
+{
+  return (setMethodType == 3);
+}
+
+bool HistogramEqualizationMenu::IsSpecificationMethodType() const
+{
+  return (setMethodType == 4);
+}
+
 int32_t HistogramEqualizationMenu::GetKernelX() const
 {
   return localizeKernelX;
@@ -300,6 +398,47 @@ float HistogramEqualizationMenu::GetKernelEnhanceConst() const
   return localizeKernelEnhanceConst;
 }
 
+int32_t HistogramEqualizationMenu::GetClaheTilesX() const
+{
+  return claheTilesX;
+}
+
+int32_t HistogramEqualizationMenu::GetClaheTilesY() const
+{
+  return claheTilesY;
+}
+
+float HistogramEqualizationMenu::GetClaheClipLimit() const
+{
+  return claheClipLimit;
+}
+
+bool HistogramEqualizationMenu::TargetFileChanged()
+{
+  bool tmp = targetFileChanged;
+  targetFileChanged = false;
+  return tmp;
+}
+
+const std::string & HistogramEqualizationMenu::GetTargetFilePath() const
+{
+  return targetFilePath;
+}
+
+void HistogramEqualizationMenu::SetTargetLoaded(bool is_loaded)
+{
+  // the op has no target after a failed load so the menu doesn't show the path as if it was one
+
+  if (is_loaded)
+  {
+    targetLoadError.clear();
+    return;
+  }
+
+  targetLoadError = "unable to load " + targetFilePath;
+  targetFilePath.clear();
+}
+
 void HistogramEqualizationMenu::ClearData()
 {
   histogramNormalized.clear();
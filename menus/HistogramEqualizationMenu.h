@@ -7,6 +7,7 @@
 #include <mutex>
 
 #include "MenuOps.h"
+#include "common/cprogress.h"
 
 class HistogramEqualizationMenu
 {
@@ -22,6 +23,7 @@ class HistogramEqualizationMenu
     void SetHistogramRemapData(std::vector<std::map<int32_t, float>> & histogram_data);
 
     void SetProcessTime(float process_time);
+    void SetProgress(const cprogress & progress);
     void SetSizeOfImage(int32_t pixel_width, int32_t pixel_height);
 
     bool IsHistogramColorTypeGray() const;
@@ -29,6 +31,8 @@ class HistogramEqualizationMenu
     bool IsGlobalMethodType() const;
     bool IsLocalizeMethodType() const;
     bool IsLocalizeEnchancementMethodType() const;
+    bool IsClaheMethodType() const;
+    bool IsSpecificationMethodType() const;
 
     int32_t GetKernelX() const;
     int32_t GetKernelY() const;
@@ -37,6 +41,12 @@ class HistogramEqualizationMenu
     float GetKernelK2() const;
     float GetKernelK3() const;
     float GetKernelEnhanceConst() const;
+    int32_t GetClaheTilesX() const;
+    int32_t GetClaheTilesY() const;
+    float GetClaheClipLimit() const;
+    bool TargetFileChanged();
+    const std::string & GetTargetFilePath() const;
+    void SetTargetLoaded(bool is_loaded);
 
     void ClearData();
 
@@ -56,7 +66,14 @@ class HistogramEqualizationMenu
     float localizeKernelK2 = 0.0f;
     float localizeKernelK3 = 0.1f;
     float localizeKernelEnhanceConst = 22.8f;
+    int32_t claheTilesX = 8;
+    int32_t claheTilesY = 8;
+    float claheClipLimit = 2.0f;
+    std::string targetFilePath;
+    bool targetFileChanged = false;
+    std::string targetLoadError;
     float processTimeSecs = 0.0f;
+    const cprogress * processProgress = nullptr;
     int32_t imagePixelWidth = 64;
     int32_t imagePixelHeight = 64;
     std::mutex histogramMtx;
@@ -0,0 +1,124 @@
+#include "LazyViewMenu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <imgui.h>
+#include <spdlog/fmt/fmt.h>
+#include "MenuWidgets.h"
+
+namespace {
+  constexpr float bytes_per_megabyte = 1024.0f * 1024.0f;
+}
+
+void LazyViewMenu::RenderMenu(const LazyImage & lazy_image)
+{
+  ImGui::Begin("Lazy Output", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+  const auto max_level = static_cast<int32_t>(lazy_image.GetMaxLevel());
+  if (viewLevel > max_level)
+  {
+    viewLevel = max_level;
+    viewChanged = true;
+  }
+
+  ImGui::Text(fmt::format("output {}x{}, view {}x{}"
+                         ,lazy_image.GetWidth()
+                         ,lazy_image.GetHeight()
+                         ,lazy_image.GetLevelWidth(ViewLevel())
+                         ,lazy_image.GetLevelHeight(ViewLevel())).c_str());
+
+  if (lazy_image.IsVirtual())
+  {
+    ImGui::Text("virtual (read from the source, nothing cached)");
+  }
+  else
+  {
+    ImGui::Text(fmt::format("{} tiles cached ({:.1f} MB)", lazy_image.GetCachedTiles(), static_cast<float>(lazy_image.GetCachedBytes()) / bytes_per_megabyte).c_str());
+  }
+
+  ImGui::NewLine();
+
+  // level l shows the output shrunk by 2^l
+
+  ImGui::Text("zoom out level:");
+  viewChanged |= ImGui::SliderInt("##lazy_view_level", &viewLevel, 0, max_level, "%d", ImGuiSliderFlags_AlwaysClamp);
+
+  ImGui::Text("view center:");
+  viewChanged |= ImGui::SliderFloat("x##lazy_center_x", &centerX, 0.0f, 1.0f, "%.4f", ImGuiSliderFlags_AlwaysClamp);
+  viewChanged |= ImGui::SliderFloat("y##lazy_center_y", &centerY, 0.0f, 1.0f, "%.4f", ImGuiSliderFlags_AlwaysClamp);
+
+  ImGui::NewLine();
+
+  const cprogress & export_progress = lazy_image.GetExportProgress();
+
+  if (export_progress.running())
+  {
+    ProgressBarWithRate(export_progress);
+  }
+  else
+  {
+    ImGui::InputText("##lazy export file", &exportFilePath[0], sizeof(exportFilePath));
+    ImGui::SameLine();
+
+    if (ImGui::Button("export pam"))
+    {
+      exportBegin = true;
+    }
+  }
+
+  ImGui::End();
+}
+
+uint32_t LazyViewMenu::ViewLevel() const
+{
+  return static_cast<uint32_t>(std::max(0, viewLevel));
+}
+
+void LazyViewMenu::ViewOrigin(const LazyImage & lazy_image
+                             ,int32_t view_width
+                             ,int32_t view_height
+                             ,int32_t & view_x
+                             ,int32_t & view_y) const
+{
+  // a view bigger than the level stays centered on it
+
+  const int32_t level_width = lazy_image.GetLevelWidth(ViewLevel());
+  const int32_t level_height = lazy_image.GetLevelHeight(ViewLevel());
+
+  view_x = (level_width > view_width) ? std::clamp(static_cast<int32_t>(std::lround(centerX * static_cast<float>(level_width))) - (view_width / 2), 0, level_width - view_width)
+                                      : (level_width - view_width) / 2;
+  view_y = (level_height > view_height) ? std::clamp(static_cast<int32_t>(std::lround(centerY * static_cast<float>(level_height))) - (view_height / 2), 0, level_height - view_height)
+                                        : (level_height - view_height) / 2;
+}
+
+void LazyViewMenu::Refresh()
+{
+  viewChanged = true;
+}
+
+bool LazyViewMenu::ViewChanged()
+{
+  bool has_changed = viewChanged;
+  if (has_changed)
+  {
+    viewChanged = false;
+  }
+
+  return has_changed;
+}
+
+bool LazyViewMenu::ExportBegin()
+{
+  bool should_export = exportBegin;
+  if (should_export)
+  {
+    exportBegin = false;
+  }
+
+  return should_export;
+}
+
+std::string LazyViewMenu::ExportPath() const
+{
+  return exportFilePath;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "operations/LazyImage.h"
+
+// the view of a lazy output: its level of detail and the point of the output at the center of the view, plus the
+// export of the whole output at full resolution
+
+class LazyViewMenu
+{
+  public:
+    LazyViewMenu() = default;
+    ~LazyViewMenu() = default;
+
+    void RenderMenu(const LazyImage & lazy_image);
+
+    [[nodiscard]] uint32_t ViewLevel() const;
+    void ViewOrigin(const LazyImage & lazy_image
+                   ,int32_t view_width
+                   ,int32_t view_height
+                   ,int32_t & view_x
+                   ,int32_t & view_y) const;
+
+    void Refresh();
+    [[nodiscard]] bool ViewChanged();
+    [[nodiscard]] bool ExportBegin();
+    [[nodiscard]] std::string ExportPath() const;
+
+  private:
+    int32_t viewLevel = 0;
+    float centerX = 0.5f;
+    float centerY = 0.5f;
+    bool viewChanged = true;
+    bool exportBegin = false;
+    char exportFilePath[64] = "output.pam";
+};
@@ -0,0 +1,17 @@
+#include "MenuWidgets.h"
+
+#include <string>
+#include <imgui.h>
+#include <spdlog/fmt/fmt.h>
+
+void ProgressBarWithRate(const cprogress & progress)
+{
+  // the operations count their work in pixels so the rate is shown in megapixels per second
+
+  const std::string overlay = fmt::format("{:.0f}%  {:.1f} Mpx/s  eta {:.1f} secs"
+                                         ,progress.fraction() * 100.0f
+                                         ,progress.throughput() / 1e6f
+                                         ,progress.etasecs());
+
+  ImGui::ProgressBar(progress.fraction(), ImVec2(-1.0f, 0.0f), overlay.c_str());
+}
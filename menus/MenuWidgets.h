@@ -0,0 +1,8 @@
+#pragma once
+
+#include "common/cprogress.h"
+
+// widgets shared by the operation menus
+
+// a full width progress bar with the percentage, rate and eta of the operation on top of it
+void ProgressBarWithRate(const cprogress & progress);
@@ -0,0 +1,185 @@
+#include "PoolTelemetryMenu.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include <imgui.h>
+#include <implot/implot.h>
+#include <spdlog/spdlog.h>
+
+#include "common/cpoolregistry.h"
+
+namespace {
+  // the snapshots are read a few times a second, often enough to follow the pools without the numbers flickering
+  constexpr double refresh_interval_secs = 0.25;
+
+  std::vector<double> histogram_values(const std::array<uint64_t, cpooltelemetry::number_of_buckets> & histogram)
+  {
+    return std::vector<double>(histogram.begin(), histogram.end());
+  }
+}
+
+void PoolTelemetryMenu::RenderMenu()
+{
+  ImGui::Begin("Thread Pool Telemetry", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+  if (ImGui::Checkbox("record", &isRecording))
+  {
+    cpoolregistry::settelemetryenabled(isShowing && isRecording);
+  }
+
+  ImGui::SameLine();
+  ImGui::Checkbox("pause view", &isPaused);
+
+  ImGui::SameLine();
+
+  if (ImGui::Button("reset"))
+  {
+    cpoolregistry::resettelemetry();
+    lastRefreshTime = -1.0;
+  }
+
+  ImGui::InputText("##telemetry json file", &jsonFilePath[0], sizeof(jsonFilePath));
+  ImGui::SameLine();
+
+  if (ImGui::Button("dump json"))
+  {
+    DumpJson();
+  }
+
+  RefreshSnapshots();
+
+  if (poolSnapshots.empty())
+  {
+    ImGui::Text("no thread pool has been started yet");
+  }
+
+  for (const auto & pool_snapshot : poolSnapshots)
+  {
+    ImGui::PushID(pool_snapshot.poolName.c_str());
+    RenderPool(pool_snapshot);
+    ImGui::PopID();
+  }
+
+  ImGui::End();
+}
+
+void PoolTelemetryMenu::SetShowing(bool is_showing)
+{
+  if (is_showing == isShowing)
+  {
+    return;
+  }
+
+  isShowing = is_showing;
+  cpoolregistry::settelemetryenabled(isShowing && isRecording);
+}
+
+void PoolTelemetryMenu::RefreshSnapshots()
+{
+  const double time_now = ImGui::GetTime();
+
+  if (isPaused || ((lastRefreshTime >= 0.0) && ((time_now - lastRefreshTime) < refresh_interval_secs)))
+  {
+    return;
+  }
+
+  poolSnapshots = cpoolregistry::telemetry();
+  lastRefreshTime = time_now;
+}
+
+void PoolTelemetryMenu::RenderPool(const cpooltelemetry::snapshot & pool_snapshot)
+{
+  const std::string pool_title = "pool " + pool_snapshot.poolName + " (" + std::to_string(pool_snapshot.workers.size() - 1) + " workers)";
+  ImGui::SeparatorText(pool_title.c_str());
+
+  const double elapsed_secs = std::max(pool_snapshot.elapsedSecs, 1e-9);
+
+  if (ImGui::BeginTable("##workers", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+  {
+    ImGui::TableSetupColumn("worker");
+    ImGui::TableSetupColumn("jobs");
+    ImGui::TableSetupColumn("steals");
+    ImGui::TableSetupColumn("busy");
+    ImGui::TableSetupColumn("parked");
+    ImGui::TableHeadersRow();
+
+    for (size_t i=0; i<pool_snapshot.workers.size(); i++)
+    {
+      const auto & worker = pool_snapshot.workers[i];
+      const bool is_outside = ((i + 1) == pool_snapshot.workers.size());
+
+      // the threads outside the pool only show up once they've helped out
+      if (is_outside && (worker.jobs == 0))
+      {
+        continue;
+      }
+
+      const float busy_ratio = static_cast<float>(std::min(worker.busySecs / elapsed_secs, 1.0));
+      const float parked_ratio = static_cast<float>(std::min(worker.parkedSecs / elapsed_secs, 1.0));
+
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(is_outside ? "outside" : std::to_string(i).c_str());
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(std::to_string(worker.jobs).c_str());
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(std::to_string(worker.steals).c_str());
+      ImGui::TableNextColumn();
+      ImGui::ProgressBar(busy_ratio, ImVec2(128, 0));
+      ImGui::TableNextColumn();
+      ImGui::ProgressBar(parked_ratio, ImVec2(128, 0));
+    }
+
+    ImGui::EndTable();
+  }
+
+  std::vector<double> depth_times;
+  std::vector<double> depth_values;
+  for (const auto & [sample_time, depth] : pool_snapshot.queueDepth)
+  {
+    depth_times.emplace_back(sample_time);
+    depth_values.emplace_back(static_cast<double>(depth));
+  }
+
+  if (ImPlot::BeginPlot("##queue_depth", ImVec2(512, 160), ImPlotFlags_::ImPlotFlags_None))
+  {
+    ImPlot::SetupAxes("seconds", "queued jobs",
+                      ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit,
+                      ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit);
+    ImPlot::PlotLine("queue depth", depth_times.data(), depth_values.data(), static_cast<int32_t>(depth_times.size()));
+    ImPlot::EndPlot();
+  }
+
+  // bucket b is [2^b, 2^(b+1)) microseconds
+  const std::vector<double> queue_wait = histogram_values(pool_snapshot.queueWaitHistogram);
+  const std::vector<double> run_time = histogram_values(pool_snapshot.runTimeHistogram);
+
+  if (ImPlot::BeginPlot("##job_times", ImVec2(512, 160), ImPlotFlags_::ImPlotFlags_None))
+  {
+    ImPlot::SetupAxes("log2(microseconds)", "jobs",
+                      ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit,
+                      ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit);
+    ImPlot::PlotBars("queue wait", queue_wait.data(), static_cast<int32_t>(queue_wait.size()), 0.4, -0.2,
+                     ImPlotBarsFlags_::ImPlotBarsFlags_None, 0);
+    ImPlot::PlotBars("run time", run_time.data(), static_cast<int32_t>(run_time.size()), 0.4, 0.2,
+                     ImPlotBarsFlags_::ImPlotBarsFlags_None, 0);
+    ImPlot::EndPlot();
+  }
+}
+
+bool PoolTelemetryMenu::DumpJson() const
+{
+  std::ofstream json_file(jsonFilePath);
+
+  if (!json_file.is_open())
+  {
+    spdlog::warn("unable to write thread pool telemetry to {}", jsonFilePath);
+    return false;
+  }
+
+  json_file << cpooltelemetry::tojson(cpoolregistry::telemetry());
+  spdlog::info("thread pool telemetry written to {}", jsonFilePath);
+
+  return true;
+}
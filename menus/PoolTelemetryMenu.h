@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <vector>
+
+#include "common/cpooltelemetry.h"
+
+class PoolTelemetryMenu
+{
+  public:
+    PoolTelemetryMenu() = default;
+    ~PoolTelemetryMenu() = default;
+
+    void RenderMenu();
+
+    // the pools record telemetry only while the panel is shown (and recording)
+    void SetShowing(bool is_showing);
+
+  private:
+    void RefreshSnapshots();
+    void RenderPool(const cpooltelemetry::snapshot & pool_snapshot);
+    bool DumpJson() const;
+
+    std::vector<cpooltelemetry::snapshot> poolSnapshots;
+    double lastRefreshTime = -1.0;
+    bool isShowing = false;
+    bool isRecording = true;
+    bool isPaused = false;
+    char jsonFilePath[64] = "pool_telemetry.json";
+};
@@ -0,0 +1,124 @@
+#include "ResampleMenu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <imgui.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include "MenuWidgets.h"
+
+namespace {
+  constexpr float min_scale = 0.05f;
+  constexpr float max_scale = 8.0f;
+
+  bool ButtonCenteredOnLine(const char* label)
+  {
+    constexpr float alignment = 0.5f;
+
+    ImGuiStyle& style = ImGui::GetStyle();
+
+    float size = ImGui::CalcTextSize(label).x + style.FramePadding.x * 2.0f;
+    float avail = ImGui::GetContentRegionAvail().x;
+
+    float off = (avail - size) * alignment;
+    if (off > 0.0f)
+      ImGui::SetCursorPosX(ImGui::GetCursorPosX() + off);
+
+    return ImGui::Button(label);
+  }
+}
+
+void ResampleMenu::RenderMenu()
+{
+  ImGui::Begin("Resample Operation", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+  ImGui::BeginGroup();
+  ImGui::Text("scale:");
+  ImGui::SliderFloat("##resample_scale", &scale, min_scale, max_scale, "%.3f", ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_AlwaysClamp);
+  ImGui::Text(fmt::format("{}x{} -> {}x{}", imagePixelWidth, imagePixelHeight, GetTargetWidth(), GetTargetHeight()).c_str());
+  ImGui::EndGroup();
+
+  ImGui::NewLine();
+
+  ImGui::Text("resample filter:");
+
+  ImGui::BeginGroup();
+
+  if (ImGui::RadioButton("Bilinear", (operation == MenuOp_Resample::BILINEAR)))
+  {
+    operation = MenuOp_Resample::BILINEAR;
+  }
+
+  ImGui::SameLine();
+
+  if (ImGui::RadioButton("Bicubic", (operation == MenuOp_Resample::BICUBIC)))
+  {
+    operation = MenuOp_Resample::BICUBIC;
+  }
+
+  ImGui::SameLine();
+
+  if (ImGui::RadioButton("Lanczos-3", (operation == MenuOp_Resample::LANCZOS3)))
+  {
+    operation = MenuOp_Resample::LANCZOS3;
+  }
+
+  ImGui::EndGroup();
+
+  ImGui::Checkbox("lazy output", &isLazy);
+
+  ImGui::NewLine();
+
+  if ((processProgress != nullptr) && processProgress->running())
+  {
+    ProgressBarWithRate(*processProgress);
+  }
+  else if (ButtonCenteredOnLine("Process"))
+  {
+    processBegin = true;
+  }
+
+  ImGui::End();
+}
+
+MenuOp_Resample ResampleMenu::CurrentOperation() const
+{
+  return operation;
+}
+
+bool ResampleMenu::ProcessBegin()
+{
+  bool should_process = processBegin;
+  if (should_process)
+  {
+    processBegin = false;
+  }
+
+  return should_process;
+}
+
+bool ResampleMenu::IsLazy() const
+{
+  return isLazy;
+}
+
+uint32_t ResampleMenu::GetTargetWidth() const
+{
+  return static_cast<uint32_t>(std::max(1L, std::lround(static_cast<float>(imagePixelWidth) * scale)));
+}
+
+uint32_t ResampleMenu::GetTargetHeight() const
+{
+  return static_cast<uint32_t>(std::max(1L, std::lround(static_cast<float>(imagePixelHeight) * scale)));
+}
+
+void ResampleMenu::SetProgress(const cprogress & progress)
+{
+  processProgress = &progress;
+}
+
+void ResampleMenu::SetSizeOfImage(int32_t pixel_width, int32_t pixel_height)
+{
+  imagePixelWidth = pixel_width;
+  imagePixelHeight = pixel_height;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "MenuOps.h"
+#include "common/cprogress.h"
+
+class ResampleMenu
+{
+  public:
+    ResampleMenu() = default;
+    ~ResampleMenu() = default;
+
+    void RenderMenu();
+    [[nodiscard]] MenuOp_Resample CurrentOperation() const;
+    [[nodiscard]] bool ProcessBegin();
+    [[nodiscard]] bool IsLazy() const;
+
+    [[nodiscard]] uint32_t GetTargetWidth() const;
+    [[nodiscard]] uint32_t GetTargetHeight() const;
+
+    void SetProgress(const cprogress & progress);
+    void SetSizeOfImage(int32_t pixel_width, int32_t pixel_height);
+
+  private:
+    bool processBegin = false;
+    MenuOp_Resample operation = MenuOp_Resample::BICUBIC;
+    float scale = 1.0f;
+    bool isLazy = false;
+    int32_t imagePixelWidth = 0;
+    int32_t imagePixelHeight = 0;
+    const cprogress * processProgress = nullptr;
+};
@@ -5,6 +5,7 @@
 #include <imgui.h>
 #include <imgui-SFML.h>
 #include <spdlog/spdlog.h>
+#include "MenuWidgets.h"
 
 namespace {
   bool ButtonCenteredOnLine(const char* label)
@@ -157,7 +158,11 @@ void SpatialFilterMenu::RenderMenu()
 
   ImGui::NewLine();
 
-  if(ButtonCenteredOnLine("Process"))
+  if ((processProgress != nullptr) && processProgress->running())
+  {
+    ProgressBarWithRate(*processProgress);
+  }
+  else if(ButtonCenteredOnLine("Process"))
   {
     processBegin = true;
   }
@@ -292,3 +297,8 @@ bool SpatialFilterMenu::ShowUnSharpenFilterScaling() const
 {
   return showUnSharpenFilterScaling;
 }
+
+void SpatialFilterMenu::SetProgress(const cprogress & progress)
+{
+  processProgress = &progress;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MenuOps.h"
+#include "common/cprogress.h"
 
 class SpatialFilterMenu
 {
@@ -25,6 +26,8 @@ class SpatialFilterMenu
     [[nodiscard]] bool ShowUnSharpenFilter() const;
     [[nodiscard]] bool ShowUnSharpenFilterScaling() const;
 
+    void SetProgress(const cprogress & progress);
+
 
   private:
     bool processBegin = false;
@@ -43,5 +46,6 @@ class SpatialFilterMenu
     bool invertSharpenFilterScaling = true;
     bool showUnSharpenFilter = false;
     bool showUnSharpenFilterScaling = false;
+    const cprogress * processProgress = nullptr;
 };
 
@@ -57,6 +57,10 @@ void UpsampleMenu::RenderMenu()
 
   ImGui::EndGroup();
 
+  // a lazy output only evaluates what the view shows, saving it streams the full output to a pam file
+
+  ImGui::Checkbox("lazy output", &isLazy);
+
   ImGui::NewLine();
 
   if (ButtonCenteredOnLine("save image"))
@@ -92,6 +96,11 @@ int32_t UpsampleMenu::UpsampleIterations() const
   return upsamepleIters;
 }
 
+bool UpsampleMenu::IsLazy() const
+{
+  return isLazy;
+}
+
 bool UpsampleMenu::ProcessBegin()
 {
   bool should_process = processBegin;
@@ -13,10 +13,12 @@ class UpsampleMenu
     void RenderMenu();
     [[nodiscard]] MenuOp_Upsample CurrentOperation() const;
     [[nodiscard]] int32_t UpsampleIterations() const;
+    [[nodiscard]] bool IsLazy() const;
     bool ProcessBegin();
 
   private:
     bool processBegin = false;
     MenuOp_Upsample operation = MenuOp_Upsample::NEAREST;
     int32_t upsamepleIters = 0;
+    bool isLazy = false;
 };
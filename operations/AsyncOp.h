@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <type_traits>
+#include "common/cimageview.h"
+#include "common/cpoolregistry.h"
+#include "common/ctask.h"
+
+// what the ops' ProcessImageAsync forward to: the op's (synchronous) process function as a BACKGROUND coroutine on the
+// shared pool, co_await it or start it with to_future. the arguments are kept in the coroutine frame and a borrowed
+// cimageview among them is copied when the task starts (an owning one is only shared), so the caller's image may go
+// away while the coroutine waits for a thread
+
+class AsyncOp
+{
+  public:
+    template<typename op_type, typename process_type, typename... arg_types>
+    static auto Run(op_type * op, process_type process, arg_types... args)
+      -> ctask<std::invoke_result_t<process_type, op_type *, arg_types &...>>
+    {
+      (Own(args), ...);
+      co_await cpoolregistry::shared().schedule(cjobpriority::BACKGROUND);
+
+      co_return std::invoke(process, op, args...);
+    }
+
+  private:
+    template<typename arg_type>
+    static void Own(arg_type & arg)
+    {
+      if constexpr (std::is_same_v<arg_type, cimageview>)
+      {
+        arg = arg.owned();
+      }
+    }
+};
@@ -1,102 +1,243 @@
 #include "DownsampleOp.h"
 
-#include <array>
 #include <algorithm>
-#include <limits>
+#include <cstring>
 #include <spdlog/spdlog.h>
+#include "AsyncOp.h"
+#include "common/cparallel.h"
+#include "common/cpoolregistry.h"
+#include "common/csimd.h"
 
 namespace
 {
-  std::array<uint8_t, 4> pixel_gather(const int32_t & x
-                                     ,const int32_t & y
-                                     ,const int32_t & w
-                                     ,const int32_t & h
-                                     ,const int32_t & number_of_pixel_neighbors
-                                     ,const int32_t & bpp
-                                     ,const std::vector<uint8_t> & source_image)
+  // one 2x level from the one above it (width x height, the output is (width / 2) x (height / 2)). an odd last
+  // column or row is dropped, same as the halving always did. output rows only read their own pair of source rows
+  // so they run in parallel
+
+  void decimate_levels(const cimageview & source_image
+                      ,uint16_t levels
+                      ,std::vector<uint8_t> & level_image)
   {
-    int32_t pixel_value_red = 0;
-    int32_t pixel_value_green = 0;
-    int32_t pixel_value_blue = 0;
-    int32_t pixel_value_alpha = 0;
+    // keep the top left pixel of every 2^levels x 2^levels block. picking from the source directly gives the same
+    // pixels as halving it levels times
 
-    for (int32_t i=0; i<(number_of_pixel_neighbors+1); i++)
-    {
-      const size_t pixel_byte_index_r = ((x + i) * bpp) + (y * w * bpp) + 3;
-      if ((pixel_byte_index_r > 0) && (pixel_byte_index_r < w))
+    const uint8_t bpp = source_image.channels();
+    const uint32_t level_width = source_image.width() >> levels;
+    const size_t level_stride = static_cast<size_t>(level_width) * bpp;
+
+    parallel_for(cpoolregistry::shared(), 0, static_cast<int32_t>(source_image.height() >> levels), [&](int32_t y) {
+      const uint8_t * source_row = source_image.row(static_cast<uint32_t>(y) << levels);
+      uint8_t * level_row = level_image.data() + (static_cast<size_t>(y) * level_stride);
+
+      for (uint32_t x=0; x<level_width; x++)
       {
-        pixel_value_red += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 0]);
-        pixel_value_green += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 1]);
-        pixel_value_blue += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 2]);
-        pixel_value_alpha += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 3]);
+        std::memcpy(level_row + (static_cast<size_t>(x) * bpp), source_row + ((static_cast<size_t>(x) << levels) * bpp), bpp);
       }
-      else
+    });
+  }
+
+  void average_level(const cimageview & source_image
+                    ,std::vector<uint8_t> & level_image)
+  {
+    // every output channel is the rounded mean of the 2x2 block, (a + b + c + d + 2) / 4
+
+    const uint8_t bpp = source_image.channels();
+    const uint32_t level_width = source_image.width() / 2;
+    const size_t level_stride = static_cast<size_t>(level_width) * bpp;
+
+    parallel_for(cpoolregistry::shared(), 0, static_cast<int32_t>(source_image.height() / 2), [&](int32_t y) {
+      const uint8_t * top_row = source_image.row(static_cast<uint32_t>(y) * 2);
+      const uint8_t * bottom_row = source_image.row((static_cast<uint32_t>(y) * 2) + 1);
+      uint8_t * level_row = level_image.data() + (static_cast<size_t>(y) * level_stride);
+
+      uint32_t x = 0;
+
+#ifdef CSIMD_SSE2
+      if (bpp == 4)
       {
-        const int32_t x_fix = std::clamp(x, 0, (w - 1));
-        const int32_t y_fix = std::clamp(y, 0, (h - 1));
+        // 4 output pixels per step. the 8 source pixels of each row are widened to 16 bits, the rows added, then each
+        // pixel added to its right hand neighbor (the upper half of the register shifted down)
 
-        pixel_value_red += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 0]);
-        pixel_value_green += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 1]);
-        pixel_value_blue += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 2]);
-        pixel_value_alpha += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 3]);
-      }
-    }
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+
+        const auto sum_pairs = [&zero](__m128i top, __m128i bottom) -> __m128i {
+          const __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+          const __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
 
-    pixel_value_red /= (number_of_pixel_neighbors + 1);
-    pixel_value_red = std::clamp(pixel_value_red, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+          return _mm_unpacklo_epi64(_mm_add_epi16(low, _mm_srli_si128(low, 8)), _mm_add_epi16(high, _mm_srli_si128(high, 8)));
+        };
 
-    pixel_value_green /= (number_of_pixel_neighbors + 1);
-    pixel_value_green = std::clamp(pixel_value_green, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+        for (; (x + 4)<=level_width; x+=4)
+        {
+          const uint8_t * top = top_row + (static_cast<size_t>(x) * 8);
+          const uint8_t * bottom = bottom_row + (static_cast<size_t>(x) * 8);
 
-    pixel_value_blue /= (number_of_pixel_neighbors + 1);
-    pixel_value_blue = std::clamp(pixel_value_blue, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+          const __m128i sum_01 = sum_pairs(_mm_loadu_si128(reinterpret_cast<const __m128i *>(top))
+                                          ,_mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom)));
+          const __m128i sum_23 = sum_pairs(_mm_loadu_si128(reinterpret_cast<const __m128i *>(top + 16))
+                                          ,_mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + 16)));
 
-    pixel_value_alpha /= (number_of_pixel_neighbors + 1);
-    pixel_value_alpha = std::clamp(pixel_value_alpha, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+          const __m128i mean_01 = _mm_srli_epi16(_mm_add_epi16(sum_01, rounding), 2);
+          const __m128i mean_23 = _mm_srli_epi16(_mm_add_epi16(sum_23, rounding), 2);
+
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(level_row + (static_cast<size_t>(x) * 4)), _mm_packus_epi16(mean_01, mean_23));
+        }
+      }
+#endif
 
-    return {static_cast<uint8_t>(pixel_value_red)
-           ,static_cast<uint8_t>(pixel_value_green)
-           ,static_cast<uint8_t>(pixel_value_blue)
-           ,static_cast<uint8_t>(pixel_value_alpha)};
+      for (; x<level_width; x++)
+      {
+        const size_t left = static_cast<size_t>(x) * 2 * bpp;
+        const size_t right = left + bpp;
+
+        for (size_t c=0; c<bpp; c++)
+        {
+          const uint32_t sum = static_cast<uint32_t>(top_row[left + c]) + top_row[right + c] + bottom_row[left + c] + bottom_row[right + c];
+          level_row[(static_cast<size_t>(x) * bpp) + c] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      }
+    });
   }
 
-  void set_pixel(const uint32_t & x
-                ,const uint32_t & y
-                ,const uint32_t & width
-                ,const uint32_t & bpp
-                ,std::vector<uint8_t> & image
-                ,const std::array<uint8_t, 4> & pixel_color_rgb)
+  void box_levels(const cimageview & source_image
+                 ,uint16_t levels
+                 ,std::vector<uint8_t> & level_image)
   {
-    image[(x * bpp) + (y * width * bpp) + 0] = pixel_color_rgb[0];
-    image[(x * bpp) + (y * width * bpp) + 1] = pixel_color_rgb[1];
-    image[(x * bpp) + (y * width * bpp) + 2] = pixel_color_rgb[2];
-    image[(x * bpp) + (y * width * bpp) + 3] = pixel_color_rgb[3];
+    // rounded mean of every 2^levels x 2^levels block in one pass. an output row adds its block of source rows into
+    // 32 bit column sums (whole rows at a time, so the reads stream through memory) and then adds up each run of
+    // 2^levels columns. 32 bits hold the sum of blocks up to 4096 x 4096, bigger ones are added up in 64 bits
+
+    const uint8_t bpp = source_image.channels();
+    const uint32_t level_width = source_image.width() >> levels;
+    const size_t block_size = static_cast<size_t>(1) << levels;
+    const size_t level_stride = static_cast<size_t>(level_width) * bpp;
+    const size_t used_stride = (static_cast<size_t>(level_width) << levels) * bpp;
+    const uint64_t rounding = static_cast<uint64_t>(1) << ((2 * levels) - 1);
+    const bool fits_32_bits = (levels <= 12);
+
+    parallel_for(cpoolregistry::shared(), 0, static_cast<int32_t>(source_image.height() >> levels), [&](int32_t y) {
+      std::vector<uint32_t> column_sums(used_stride, 0);
+
+      for (size_t row=0; row<block_size; row++)
+      {
+        const uint8_t * source_row = source_image.row((static_cast<uint32_t>(y) << levels) + static_cast<uint32_t>(row));
+        size_t i = 0;
+
+#ifdef CSIMD_SSE2
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; (i + 16)<=used_stride; i+=16)
+        {
+          const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source_row + i));
+          const __m128i low = _mm_unpacklo_epi8(pixels, zero);
+          const __m128i high = _mm_unpackhi_epi8(pixels, zero);
+
+          auto * sums = reinterpret_cast<__m128i *>(column_sums.data() + i);
+          _mm_storeu_si128(sums + 0, _mm_add_epi32(_mm_loadu_si128(sums + 0), _mm_unpacklo_epi16(low, zero)));
+          _mm_storeu_si128(sums + 1, _mm_add_epi32(_mm_loadu_si128(sums + 1), _mm_unpackhi_epi16(low, zero)));
+          _mm_storeu_si128(sums + 2, _mm_add_epi32(_mm_loadu_si128(sums + 2), _mm_unpacklo_epi16(high, zero)));
+          _mm_storeu_si128(sums + 3, _mm_add_epi32(_mm_loadu_si128(sums + 3), _mm_unpackhi_epi16(high, zero)));
+        }
+#endif
+
+        for (; i<used_stride; i++)
+        {
+          column_sums[i] += source_row[i];
+        }
+      }
+
+      uint8_t * level_row = level_image.data() + (static_cast<size_t>(y) * level_stride);
+
+      for (uint32_t x=0; x<level_width; x++)
+      {
+        const uint32_t * block_sums = column_sums.data() + ((static_cast<size_t>(x) << levels) * bpp);
+
+#ifdef CSIMD_SSE2
+        if ((bpp == 4) && fits_32_bits)
+        {
+          // one pixel (4 channels) per register
+
+          __m128i sum = _mm_setzero_si128();
+          for (size_t k=0; k<block_size; k++)
+          {
+            sum = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i *>(block_sums + (k * 4))));
+          }
+
+          const __m128i mean = _mm_srl_epi32(_mm_add_epi32(sum, _mm_set1_epi32(static_cast<int32_t>(rounding))), _mm_cvtsi32_si128(2 * levels));
+          const __m128i mean_16 = _mm_packs_epi32(mean, mean);
+          const __m128i mean_8 = _mm_packus_epi16(mean_16, mean_16);
+          const auto pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(mean_8));
+          std::memcpy(level_row + (static_cast<size_t>(x) * 4), &pixel, 4);
+
+          continue;
+        }
+#endif
+
+        for (size_t c=0; c<bpp; c++)
+        {
+          uint64_t sum = 0;
+          for (size_t k=0; k<block_size; k++)
+          {
+            sum += block_sums[(k * bpp) + c];
+          }
+
+          level_row[(static_cast<size_t>(x) * bpp) + c] = static_cast<uint8_t>((sum + rounding) >> (2 * levels));
+        }
+      }
+    });
   }
 }
 
 std::vector<uint8_t> DownsampleOp::ProcessImage(MenuOp_Downsample operation
-                                               ,const std::vector<uint8_t> & source_image
-                                               ,uint32_t width
-                                               ,uint32_t height
-                                               ,uint8_t bpp
+                                               ,const cimageview & source_image
                                                ,uint16_t iterations)
 {
-  switch (operation)
+  if (!usePyramid)
+  {
+    DownsampleDirect(operation, source_image, iterations);
+    return result;
+  }
+
+  if (!IsPyramidCached(operation, source_image))
+  {
+    switch (operation)
+    {
+      case MenuOp_Downsample::DECIMATE:
+        spdlog::info("perform decimation operation");
+        break;
+
+      case MenuOp_Downsample::NEAREST:
+        spdlog::info("perform nearest operation");
+        break;
+    }
+
+    BuildPyramid(operation, source_image);
+  }
+
+  outWidth = static_cast<int32_t>(source_image.width() >> std::min<uint16_t>(iterations, 31));
+  outHeight = static_cast<int32_t>(source_image.height() >> std::min<uint16_t>(iterations, 31));
+
+  // past the last level one of the sides is 0 so the image is empty
+  if (iterations < pyramid.levels.size())
+  {
+    result = pyramid.levels[iterations].tovector();
+  }
+  else
   {
-    case MenuOp_Downsample::DECIMATE:
-      spdlog::info("perform decimation operation");
-      DecimateAlgorithm(source_image, width, height, bpp, iterations);
-      break;
-
-    case MenuOp_Downsample::NEAREST:
-      spdlog::info("perform nearest operation");
-      NearestAlgorithm(source_image, width, height, bpp, iterations);
-      break;
+    result.clear();
   }
 
   return result;
 }
 
+ctask<std::vector<uint8_t>> DownsampleOp::ProcessImageAsync(MenuOp_Downsample operation
+                                                           ,cimageview source_image
+                                                           ,uint16_t iterations)
+{
+  return AsyncOp::Run(this, &DownsampleOp::ProcessImage, operation, std::move(source_image), iterations);
+}
+
 const std::vector<uint8_t> & DownsampleOp::GetImage() const
 {
   return result;
@@ -112,119 +253,121 @@ int32_t DownsampleOp::GetHeight() const
   return outHeight;
 }
 
-void DownsampleOp::DecimateAlgorithm(const std::vector<uint8_t> & source_image
-                                    ,uint32_t width
-                                    ,uint32_t height
-                                    ,uint8_t bpp
-                                    ,uint16_t iterations)
+const cprogress & DownsampleOp::GetProgress() const
+{
+  return progress;
+}
+
+size_t DownsampleOp::PyramidLevels() const
 {
-  constexpr uint32_t combine_value = 0;
+  return pyramid.levels.size();
+}
 
-  auto dest_result = result = source_image;
+void DownsampleOp::ClearPyramid()
+{
+  pyramid = Pyramid();
+}
 
-  outWidth = static_cast<int32_t>(width >> iterations);
-  outHeight = static_cast<int32_t>(height >> iterations);
+void DownsampleOp::SetPyramidCaching(bool use_pyramid)
+{
+  usePyramid = use_pyramid;
 
-  for (int32_t r=0; r<iterations; r++)
+  if (!usePyramid)
   {
-    const auto new_size = static_cast<uint32_t>(std::floor(width >> (r+1)))
-                                    * static_cast<uint32_t>(std::floor(height >> (r+1)))
-                                    * bpp;
+    ClearPyramid();
+  }
+}
+
+bool DownsampleOp::IsPyramidCaching() const
+{
+  return usePyramid;
+}
+
+bool DownsampleOp::IsPyramidCached(MenuOp_Downsample operation
+                                  ,const cimageview & source_image) const
+{
+  // level 0 is the source (shared if it was an owning view, a copy otherwise). comparing against it costs at most
+  // one pass over the source (much less than building the levels again) and doesn't need the caller to keep track of
+  // when the image changed
+
+  return !pyramid.levels.empty()
+         && (pyramid.operation == operation)
+         && pyramid.levels[0].equalpixels(source_image);
+}
+
+void DownsampleOp::BuildPyramid(MenuOp_Downsample operation
+                               ,const cimageview & source_image)
+{
+  pyramid.operation = operation;
+  pyramid.levels.clear();
+  pyramid.levels.emplace_back(source_image.owned());
+
+  size_t n_levels = 0;
+  for (uint32_t w=source_image.width(), h=source_image.height(); ((w / 2) > 0) && ((h / 2) > 0); w/=2, h/=2)
+  {
+    n_levels++;
+  }
+
+  progress.begin(n_levels);
 
-    result.resize(new_size, 0);
+  const uint8_t bpp = source_image.channels();
 
-    for (int32_t i=0; i<height; i+=2)
+  for (size_t r=0; r<n_levels; r++)
+  {
+    const uint32_t level_width = pyramid.levels.back().width() / 2;
+    const uint32_t level_height = pyramid.levels.back().height() / 2;
+    std::vector<uint8_t> level_image(static_cast<size_t>(level_width) * level_height * bpp);
+
+    if (operation == MenuOp_Downsample::NEAREST)
     {
-      for (int32_t j=0; j<width; j+=2)
-      {
-        // average the 4 neighboring pixels and set the new pixel value in the output image buffer
-        auto pixel_rgb_value_0 = pixel_gather(j
-                                             ,i
-                                             ,static_cast<int32_t>(width >> r)
-                                             ,static_cast<int32_t>(height >> r)
-                                             ,combine_value
-                                             ,bpp
-                                             ,dest_result);
-
-        std::array<uint8_t, 4> pixel_rgb_value = {static_cast<uint8_t>(pixel_rgb_value_0[0])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_0[1])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_0[2])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_0[3])};
-
-        set_pixel((j / 2)
-                 ,(i / 2)
-                 ,static_cast<int32_t>(width >> (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-      }
+      average_level(pyramid.levels.back(), level_image);
+    }
+    else
+    {
+      decimate_levels(pyramid.levels.back(), 1, level_image);
     }
 
-    dest_result = result;
+    pyramid.levels.emplace_back(cimageview::owning(std::move(level_image), level_width, level_height, bpp));
+
+    progress.advance();
   }
+
+  progress.finish();
 }
 
-void DownsampleOp::NearestAlgorithm(const std::vector<uint8_t> & source_image
-                                   ,uint32_t width
-                                   ,uint32_t height
-                                   ,uint8_t bpp
+void DownsampleOp::DownsampleDirect(MenuOp_Downsample operation
+                                   ,const cimageview & source_image
                                    ,uint16_t iterations)
 {
-  constexpr uint32_t combine_value = 1;
+  const uint16_t levels = std::min<uint16_t>(iterations, 31);
 
-  auto dest_result = result = source_image;
+  outWidth = static_cast<int32_t>(source_image.width() >> levels);
+  outHeight = static_cast<int32_t>(source_image.height() >> levels);
 
-  outWidth = static_cast<int32_t>(width >> iterations);
-  outHeight = static_cast<int32_t>(height >> iterations);
+  progress.begin(1);
 
-  for (int32_t r=0; r<iterations; r++)
+  if (levels == 0)
   {
-    const auto new_size = static_cast<uint32_t>(std::floor(width >> (r+1)))
-                                    * static_cast<uint32_t>(std::floor(height >> (r+1)))
-                                    * bpp;
-
-    result.resize(new_size, 0);
+    result = source_image.tovector();
+  }
+  else
+  {
+    result.resize(static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight) * source_image.channels());
+  }
 
-    for (int32_t i=0; i<height; i+=2)
-    {
-      for (int32_t j=0; j<width; j+=2)
-      {
-        // average the 4 neighboring pixels and set the new pixel value in the output image buffer
-        auto pixel_rgb_value_0 = pixel_gather(j
-                                             ,i
-                                             ,static_cast<int32_t>(width >> r)
-                                             ,static_cast<int32_t>(height >> r)
-                                             ,combine_value
-                                             ,bpp
-                                             ,dest_result);
-
-        auto pixel_rgb_value_1 = pixel_gather(j
-                                             ,i+1
-                                             ,static_cast<int32_t>(width >> r)
-                                             ,static_cast<int32_t>(height >> r)
-                                             ,combine_value
-                                             ,bpp
-                                             ,dest_result);
-
-        std::array<int32_t, 4> pixel_rgb_value_sum = {(pixel_rgb_value_0[0]+pixel_rgb_value_1[0]) / 2
-                                                     ,(pixel_rgb_value_0[1]+pixel_rgb_value_1[1]) / 2
-                                                     ,(pixel_rgb_value_0[2]+pixel_rgb_value_1[2]) / 2
-                                                     ,(pixel_rgb_value_0[3]+pixel_rgb_value_1[3]) / 2};
-
-        std::array<uint8_t, 4> pixel_rgb_value = {static_cast<uint8_t>(pixel_rgb_value_sum[0])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_sum[1])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_sum[2])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_sum[3])};
-
-        set_pixel((j / 2)
-                 ,(i / 2)
-                 ,static_cast<int32_t>(width >> (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-      }
-    }
+  // nothing to do when one of the sides is already 0
 
-    dest_result = result;
+  if ((levels > 0) && !result.empty() && (operation == MenuOp_Downsample::NEAREST))
+  {
+    spdlog::info("perform nearest operation");
+    box_levels(source_image, levels, result);
   }
+  else if ((levels > 0) && !result.empty())
+  {
+    spdlog::info("perform decimation operation");
+    decimate_levels(source_image, levels, result);
+  }
+
+  progress.advance();
+  progress.finish();
 }
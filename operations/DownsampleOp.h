@@ -3,6 +3,9 @@
 #include <vector>
 #include <cstdint>
 #include "MenuOps.h"
+#include "common/cimageview.h"
+#include "common/cprogress.h"
+#include "common/ctask.h"
 
 class DownsampleOp
 {
@@ -11,31 +14,53 @@ class DownsampleOp
     ~DownsampleOp() = default;
 
     std::vector<uint8_t> ProcessImage(MenuOp_Downsample operation
-                                     ,const std::vector<uint8_t> & source_image
-                                     ,uint32_t width
-                                     ,uint32_t height
-                                     ,uint8_t bpp
+                                     ,const cimageview & source_image
                                      ,uint16_t iterations);
 
+    // ProcessImage on the shared pool (see AsyncOp)
+    ctask<std::vector<uint8_t>> ProcessImageAsync(MenuOp_Downsample operation
+                                                 ,cimageview source_image
+                                                 ,uint16_t iterations);
+
     [[nodiscard]] const std::vector<uint8_t> & GetImage() const;
 
     [[nodiscard]] int32_t GetWidth() const;
     [[nodiscard]] int32_t GetHeight() const;
+    [[nodiscard]] const cprogress & GetProgress() const;
+
+    // number of levels in the cached pyramid (the source is level 0) and dropping it to free the memory
+    [[nodiscard]] size_t PyramidLevels() const;
+    void ClearPyramid();
+
+    // without the pyramid every call reduces the source by 2^iterations in one pass straight into the output (for
+    // one-off calls where only one level is ever needed). NEAREST is then the rounded mean of each 2^n x 2^n block,
+    // the pyramid rounds at every level so its levels can be 1 off from that
+    void SetPyramidCaching(bool use_pyramid);
+    [[nodiscard]] bool IsPyramidCaching() const;
 
   private:
+    // every 2x level of the source down to the last one that's still at least 1x1, built the first time a source (or
+    // operation) is seen. moving the iterations slider only picks another level
+    struct Pyramid
+    {
+      MenuOp_Downsample operation = MenuOp_Downsample::DECIMATE;
+      std::vector<cimageview> levels;
+    };
+
     int32_t outWidth = 0;
     int32_t outHeight = 0;
     std::vector<uint8_t> result;
+    Pyramid pyramid;
+    bool usePyramid = true;
+    cprogress progress;
+
+    [[nodiscard]] bool IsPyramidCached(MenuOp_Downsample operation
+                                      ,const cimageview & source_image) const;
 
-    void DecimateAlgorithm(const std::vector<uint8_t> & source_image
-                          ,uint32_t width
-                          ,uint32_t height
-                          ,uint8_t bpp
-                          ,uint16_t iterations);
+    void BuildPyramid(MenuOp_Downsample operation
+                     ,const cimageview & source_image);
 
-    void NearestAlgorithm(const std::vector<uint8_t> & source_image
-                         ,uint32_t width
-                         ,uint32_t height
-                         ,uint8_t bpp
+    void DownsampleDirect(MenuOp_Downsample operation
+                         ,const cimageview & source_image
                          ,uint16_t iterations);
 };
@@ -1,35 +1,380 @@
 #include "HistogramEqualizationOp.h"
 
+#include <array>
 #include <cmath>
-#include <future>
-#include <string_view>
+#include <fstream>
+#include <sstream>
 #include <spdlog/spdlog.h>
+#include "common/cpoolregistry.h"
+#include "common/ctaskgroup.h"
 
 namespace {
-  constexpr uint32_t default_number_of_threads = 8;
-  constexpr std::string_view default_threadpool_name = "HE_EQ";
-}
+  constexpr int32_t jobs_per_thread = 4;
 
-HistogramEqualizationOp::HistogramEqualizationOp()
-  : workPool(default_number_of_threads, default_threadpool_name.data())
-{
+  template<typename band_job>
+  void RunBands(cworkstealpool & pool, int32_t count, size_t work_per_item, cprogress & progress, band_job && job)
+  {
+    // split [0, count) into a few bands per pool thread and block (helping out with the bands) until every band has
+    // been processed. each band reports (items in band * work_per_item) to the progress once it is done
+
+    const auto number_of_threads = static_cast<int32_t>(pool.numberofthreads());
+    const int32_t band_size = std::max(1, count / std::max(1, number_of_threads * jobs_per_thread));
+
+    ctaskgroup bands(pool);
+
+    for (int32_t band_begin=0; band_begin<count; band_begin+=band_size)
+    {
+      bands.run([&, band_begin](){
+        const int32_t band_end = std::min(band_begin + band_size, count);
+        job(band_begin, band_end);
+        progress.advance(static_cast<size_t>(band_end - band_begin) * work_per_item);
+      });
+    }
+
+    bands.wait();
+  }
+
+  // summed area tables of a channel and of its square. entry (x, y) holds the sum over every pixel above and to
+  // the left of (x, y) so the sum over any window is 4 lookups no matter the kernel size
+
+  struct IntegralImage
+  {
+    std::vector<uint64_t> sum;
+    std::vector<uint64_t> sumSquared;
+    size_t stride = 0;
+  };
+
+  void BuildIntegralImage(cworkstealpool & pool
+                         ,cprogress & progress
+                         ,const uint8_t * source
+                         ,int32_t source_bpp
+                         ,int32_t source_offset
+                         ,int32_t sum_count
+                         ,int32_t width
+                         ,int32_t height
+                         ,IntegralImage & integral)
+  {
+    integral.stride = static_cast<size_t>(width) + 1;
+    integral.sum.assign(integral.stride * (static_cast<size_t>(height) + 1), 0);
+    integral.sumSquared.assign(integral.sum.size(), 0);
+
+    // prefix sum each row on its own, then accumulate down the columns. both passes are independent per row/column
+
+    RunBands(pool, height, width, progress, [&](int32_t row_begin, int32_t row_end) {
+      for (int32_t i=row_begin; i<row_end; i++)
+      {
+        const uint8_t * source_row = source + (static_cast<size_t>(i) * width * source_bpp) + source_offset;
+        uint64_t * sum_row = &integral.sum[(static_cast<size_t>(i) + 1) * integral.stride];
+        uint64_t * sum_squared_row = &integral.sumSquared[(static_cast<size_t>(i) + 1) * integral.stride];
+
+        uint64_t row_sum = 0;
+        uint64_t row_sum_squared = 0;
+        for (int32_t j=0; j<width; j++)
+        {
+          uint64_t pixel_value = 0;
+          for (int32_t k=0; k<sum_count; k++)
+          {
+            pixel_value += source_row[(j * source_bpp) + k];
+          }
+          pixel_value /= sum_count;
+
+          row_sum += pixel_value;
+          row_sum_squared += pixel_value * pixel_value;
+          sum_row[j + 1] = row_sum;
+          sum_squared_row[j + 1] = row_sum_squared;
+        }
+      }
+    });
+
+    RunBands(pool, width, height, progress, [&](int32_t column_begin, int32_t column_end) {
+      for (size_t i=2; i<(static_cast<size_t>(height) + 1); i++)
+      {
+        uint64_t * sum_row = &integral.sum[i * integral.stride];
+        uint64_t * sum_squared_row = &integral.sumSquared[i * integral.stride];
+        const uint64_t * sum_row_above = sum_row - integral.stride;
+        const uint64_t * sum_squared_row_above = sum_squared_row - integral.stride;
+
+        for (int32_t j=(column_begin + 1); j<(column_end + 1); j++)
+        {
+          sum_row[j] += sum_row_above[j];
+          sum_squared_row[j] += sum_squared_row_above[j];
+        }
+      }
+    });
+  }
+
+  int32_t tile_bound(int32_t tile, int32_t size, int32_t tiles)
+  {
+    // first pixel of a tile when size pixels are split into tiles as evenly as possible. tiles <= size so every tile
+    // gets at least one pixel
+    return static_cast<int32_t>((static_cast<int64_t>(tile) * size) / tiles);
+  }
+
+  void BuildClaheLookupTables(const uint8_t * source
+                             ,int32_t source_bpp
+                             ,int32_t source_offset
+                             ,int32_t width
+                             ,int32_t height
+                             ,int32_t tiles_x
+                             ,int32_t tiles_y
+                             ,int32_t tile_begin
+                             ,int32_t tile_end
+                             ,float clip_limit
+                             ,int32_t max_value
+                             ,std::vector<std::array<uint8_t, 256>> & lookup_tables)
+  {
+    // histogram each tile, clip every bin to (clip_limit * average bin height) and spread the clipped excess evenly
+    // over all bins before building the equalization lookup table from the cumulative histogram
+
+    for (int32_t t=tile_begin; t<tile_end; t++)
+    {
+      const int32_t x_begin = tile_bound(t % tiles_x, width, tiles_x);
+      const int32_t y_begin = tile_bound(t / tiles_x, height, tiles_y);
+      const int32_t x_end = tile_bound((t % tiles_x) + 1, width, tiles_x);
+      const int32_t y_end = tile_bound((t / tiles_x) + 1, height, tiles_y);
+      const int32_t tile_area = std::max(1, (x_end - x_begin) * (y_end - y_begin));
+
+      std::array<int32_t, 256> histogram = {0};
+
+      for (int32_t i=y_begin; i<y_end; i++)
+      {
+        const uint8_t * source_row = source + (static_cast<size_t>(i) * width * source_bpp) + source_offset;
+        for (int32_t j=x_begin; j<x_end; j++)
+        {
+          histogram[source_row[j * source_bpp]]++;
+        }
+      }
+
+      const auto bin_limit = std::max(1, static_cast<int32_t>(clip_limit * static_cast<float>(tile_area) / static_cast<float>(histogram.size())));
+
+      int32_t excess = 0;
+      for (auto & bin : histogram)
+      {
+        if (bin > bin_limit)
+        {
+          excess += (bin - bin_limit);
+          bin = bin_limit;
+        }
+      }
+
+      const auto bins = static_cast<int32_t>(histogram.size());
+      const int32_t excess_per_bin = excess / bins;
+      const int32_t excess_remainder = excess % bins;
+
+      const int32_t remainder_step = std::max(1, bins / std::max(1, excess_remainder));
+
+      for (auto & bin : histogram)
+      {
+        bin += excess_per_bin;
+      }
 
+      for (int32_t i=0, r=0; (i<bins) && (r<excess_remainder); i+=remainder_step, r++)
+      {
+        histogram[i]++;
+      }
+
+      int32_t cumulative_count = 0;
+      for (int32_t i=0; i<bins; i++)
+      {
+        cumulative_count += histogram[i];
+        lookup_tables[t][i] = static_cast<uint8_t>(std::min(max_value, ((max_value * cumulative_count) + (tile_area / 2)) / tile_area));
+      }
+    }
+  }
+
+  // 256 bin histogram of a kernel window that gets updated as the window slides instead of being rebuilt. a coarse
+  // histogram (16 bins of 16 values each) is kept alongside so the cumulative count of a value walks at most 32 bins
+
+  class SlidingHistogram
+  {
+    public:
+      void Clear()
+      {
+        fine.fill(0);
+        coarse.fill(0);
+      }
+
+      void Add(uint8_t value)
+      {
+        fine[value]++;
+        coarse[value >> coarse_shift]++;
+      }
+
+      void Remove(uint8_t value)
+      {
+        fine[value]--;
+        coarse[value >> coarse_shift]--;
+      }
+
+      [[nodiscard]] int32_t CumulativeCount(uint8_t value) const
+      {
+        const int32_t coarse_index = (value >> coarse_shift);
+
+        int32_t count = 0;
+        for (int32_t i=0; i<coarse_index; i++)
+        {
+          count += coarse[i];
+        }
+
+        for (int32_t i=(coarse_index << coarse_shift); i<=value; i++)
+        {
+          count += fine[i];
+        }
+
+        return count;
+      }
+
+    private:
+      static constexpr int32_t coarse_shift = 4;
+
+      std::array<int32_t, 256> fine = {0};
+      std::array<int32_t, (256 >> coarse_shift)> coarse = {0};
+  };
+
+  void LocalizeEqualizeRows(const uint8_t * source
+                           ,int32_t source_bpp
+                           ,int32_t source_offset
+                           ,int32_t width
+                           ,int32_t height
+                           ,int32_t kernel_x
+                           ,int32_t kernel_y
+                           ,int32_t row_begin
+                           ,int32_t row_end
+                           ,std::vector<uint8_t> & output
+                           ,int32_t bpp
+                           ,int32_t offset
+                           ,int32_t count
+                           ,int32_t max_value)
+  {
+    // equalize each pixel against the histogram of the kernel window centered on it. samples outside the image are
+    // clamped to the nearest edge pixel so every window holds (kernel_x * kernel_y) samples. moving one pixel to the
+    // right only removes the column leaving the window and adds the column entering it. the source is read in place
+    // (source_bpp bytes per pixel) so no per pixel or per window state is kept besides the histogram itself
+
+    const int32_t kernel_area = kernel_x * kernel_y;
+    const int32_t kernel_x_start = -(kernel_x / 2);
+    const int32_t kernel_y_start = -(kernel_y / 2);
+
+    SlidingHistogram histogram;
+    std::vector<size_t> window_rows(kernel_y);
+
+    auto add_column = [&](int32_t x) {
+      const size_t column = (static_cast<size_t>(std::clamp(x, 0, width - 1)) * source_bpp) + source_offset;
+      for (const auto & row : window_rows)
+      {
+        histogram.Add(source[row + column]);
+      }
+    };
+
+    auto remove_column = [&](int32_t x) {
+      const size_t column = (static_cast<size_t>(std::clamp(x, 0, width - 1)) * source_bpp) + source_offset;
+      for (const auto & row : window_rows)
+      {
+        histogram.Remove(source[row + column]);
+      }
+    };
+
+    for (int32_t i=row_begin; i<row_end; i++)
+    {
+      for (int32_t k=0; k<kernel_y; k++)
+      {
+        window_rows[k] = static_cast<size_t>(std::clamp(i + kernel_y_start + k, 0, height - 1)) * static_cast<size_t>(width) * source_bpp;
+      }
+
+      histogram.Clear();
+      for (int32_t k=0; k<kernel_x; k++)
+      {
+        add_column(kernel_x_start + k);
+      }
+
+      for (int32_t j=0; j<width; j++)
+      {
+        const size_t pixel_index = static_cast<size_t>(j) + static_cast<size_t>(i) * static_cast<size_t>(width);
+        const int32_t cumulative_count = histogram.CumulativeCount(source[(pixel_index * source_bpp) + source_offset]);
+        const auto remapped_value = static_cast<uint8_t>(((max_value * cumulative_count) + (kernel_area / 2)) / kernel_area);
+
+        for (int32_t c=0; c<count; c++)
+        {
+          output[(pixel_index * bpp) + offset + c] = remapped_value;
+        }
+
+        remove_column(j + kernel_x_start);
+        add_column(j + kernel_x_start + kernel_x);
+      }
+    }
+  }
+
+  std::array<uint8_t, 256> BuildSpecificationLookupTable(const std::map<int32_t, float> & source_histogram
+                                                        ,const std::array<double, 256> & target_histogram
+                                                        ,int32_t max_value)
+  {
+    // map each source value to the smallest target value whose cumulative probability reaches the cumulative
+    // probability of the source value (inverse cdf of the target). both cdfs only go up so the target value
+    // never has to move backwards
+
+    std::array<uint8_t, 256> lookup_table = {};
+    for (size_t i=0; i<lookup_table.size(); i++)
+    {
+      lookup_table[i] = static_cast<uint8_t>(std::min(static_cast<int32_t>(i), max_value));
+    }
+
+    double target_total = 0.0;
+    for (const auto & weight : target_histogram)
+    {
+      target_total += weight;
+    }
+
+    if (target_total <= 0.0)
+    {
+      return lookup_table;
+    }
+
+    std::array<double, 256> target_cdf = {};
+    double target_cumulative = 0.0;
+    for (size_t i=0; i<target_cdf.size(); i++)
+    {
+      target_cumulative += target_histogram[i];
+      target_cdf[i] = target_cumulative / target_total;
+    }
+
+    constexpr double cdf_tolerance = 1e-6;
+
+    int32_t target_value = 0;
+    double source_cumulative = 0.0;
+
+    for (const auto & [pixel_value, probability] : source_histogram)
+    {
+      source_cumulative += static_cast<double>(probability);
+
+      while ((target_value < max_value) && (target_cdf[target_value] < (source_cumulative - cdf_tolerance)))
+      {
+        target_value++;
+      }
+
+      lookup_table[pixel_value] = static_cast<uint8_t>(target_value);
+    }
+
+    return lookup_table;
+  }
 }
 
 const std::map<int32_t, float> & HistogramEqualizationOp::GetHistogramRemap()
 {
-  std::map<int32_t, std::vector<int32_t>> remapped_normalize_values;
-
   constexpr int32_t bpp = 4;
-  for (size_t i=0; i<(outWidth * outHeight); i++)
+  const auto number_of_pixels = static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight);
+  std::array<uint32_t, (HistogramOp::maxBppValue + 1)> pixel_value_counts = {0};
+
+  for (size_t i=0; i<number_of_pixels; i++)
   {
-    int32_t pixel_value_gray = (result[0 + i * bpp] + result[1 + i * bpp] + result[2 + i * bpp]) / 3;
-    remapped_normalize_values[pixel_value_gray].emplace_back(i);
+    pixel_value_counts[(result[0 + i * bpp] + result[1 + i * bpp] + result[2 + i * bpp]) / 3]++;
   }
 
-  for (const auto & [key, value] : remapped_normalize_values)
+  for (int32_t i=0; i<static_cast<int32_t>(pixel_value_counts.size()); i++)
   {
-    remappedValuesNormalized[key] = static_cast<float>(value.size()) / static_cast<float>(outWidth * outHeight);
+    if (pixel_value_counts[i] > 0)
+    {
+      remappedValuesNormalized[i] = static_cast<float>(pixel_value_counts[i]) / static_cast<float>(number_of_pixels);
+    }
   }
 
   return remappedValuesNormalized;
@@ -37,18 +382,21 @@ const std::map<int32_t, float> & HistogramEqualizationOp::GetHistogramRemap()
 
 const std::map<int32_t, float> & HistogramEqualizationOp::GetHistogramRemapRed()
 {
-  std::map<int32_t, std::vector<int32_t>> remapped_normalize_values;
-
   constexpr int32_t bpp = 4;
-  for (size_t i=0; i<(outWidth * outHeight); i++)
+  const auto number_of_pixels = static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight);
+  std::array<uint32_t, (HistogramOp::maxBppValue + 1)> pixel_value_counts = {0};
+
+  for (size_t i=0; i<number_of_pixels; i++)
   {
-    int32_t pixel_value = (result[0 + i * bpp]);
-    remapped_normalize_values[pixel_value].emplace_back(i);
+    pixel_value_counts[result[0 + i * bpp]]++;
   }
 
-  for (const auto & [key, value] : remapped_normalize_values)
+  for (int32_t i=0; i<static_cast<int32_t>(pixel_value_counts.size()); i++)
   {
-    remappedValuesNormalizedRed[key] = static_cast<float>(value.size()) / static_cast<float>(outWidth * outHeight);
+    if (pixel_value_counts[i] > 0)
+    {
+      remappedValuesNormalizedRed[i] = static_cast<float>(pixel_value_counts[i]) / static_cast<float>(number_of_pixels);
+    }
   }
 
   return remappedValuesNormalizedRed;
@@ -56,18 +404,21 @@ const std::map<int32_t, float> & HistogramEqualizationOp::GetHistogramRemapRed()
 
 const std::map<int32_t, float> & HistogramEqualizationOp::GetHistogramRemapGreen()
 {
-  std::map<int32_t, std::vector<int32_t>> remapped_normalize_values;
-
   constexpr int32_t bpp = 4;
-  for (size_t i=0; i<(outWidth * outHeight); i++)
+  const auto number_of_pixels = static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight);
+  std::array<uint32_t, (HistogramOp::maxBppValue + 1)> pixel_value_counts = {0};
+
+  for (size_t i=0; i<number_of_pixels; i++)
   {
-    int32_t pixel_value = (result[1 + i * bpp]);
-    remapped_normalize_values[pixel_value].emplace_back(i);
+    pixel_value_counts[result[1 + i * bpp]]++;
   }
 
-  for (const auto & [key, value] : remapped_normalize_values)
+  for (int32_t i=0; i<static_cast<int32_t>(pixel_value_counts.size()); i++)
   {
-    remappedValuesNormalizedGreen[key] = static_cast<float>(value.size()) / static_cast<float>(outWidth * outHeight);
+    if (pixel_value_counts[i] > 0)
+    {
+      remappedValuesNormalizedGreen[i] = static_cast<float>(pixel_value_counts[i]) / static_cast<float>(number_of_pixels);
+    }
   }
 
   return remappedValuesNormalizedGreen;
@@ -75,18 +426,21 @@ const std::map<int32_t, float> & HistogramEqualizationOp::GetHistogramRemapGreen
 
 const std::map<int32_t, float> & HistogramEqualizationOp::GetHistogramRemapBlue()
 {
-  std::map<int32_t, std::vector<int32_t>> remapped_normalize_values;
-
   constexpr int32_t bpp = 4;
-  for (size_t i=0; i<(outWidth * outHeight); i++)
+  const auto number_of_pixels = static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight);
+  std::array<uint32_t, (HistogramOp::maxBppValue + 1)> pixel_value_counts = {0};
+
+  for (size_t i=0; i<number_of_pixels; i++)
   {
-    int32_t pixel_value = (result[2 + i * bpp]);
-    remapped_normalize_values[pixel_value].emplace_back(i);
+    pixel_value_counts[result[2 + i * bpp]]++;
   }
 
-  for (const auto & [key, value] : remapped_normalize_values)
+  for (int32_t i=0; i<static_cast<int32_t>(pixel_value_counts.size()); i++)
   {
-    remappedValuesNormalizedBlue[key] = static_cast<float>(value.size()) / static_cast<float>(outWidth * outHeight);
+    if (pixel_value_counts[i] > 0)
+    {
+      remappedValuesNormalizedBlue[i] = static_cast<float>(pixel_value_counts[i]) / static_cast<float>(number_of_pixels);
+    }
   }
 
   return remappedValuesNormalizedBlue;
@@ -117,6 +471,129 @@ void HistogramEqualizationOp::SetLocalizeKernelConstants(float k0, float k1, flo
   enhanceConst = c;
 }
 
+void HistogramEqualizationOp::SetClaheTileGrid(int32_t tiles_x, int32_t tiles_y)
+{
+  claheTilesX = tiles_x;
+  claheTilesY = tiles_y;
+}
+
+void HistogramEqualizationOp::SetClaheClipLimit(float clip_limit)
+{
+  claheClipLimit = clip_limit;
+}
+
+bool HistogramEqualizationOp::SetTargetHistogram(const std::vector<uint8_t> & target_image
+                                                ,uint32_t width
+                                                ,uint32_t height
+                                                ,uint8_t bpp)
+{
+  // the histograms of a reference image become the target for the specification method
+
+  hasTargetHistogram = false;
+
+  const size_t number_of_pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+
+  if ((number_of_pixels == 0) || (bpp < 3) || (target_image.size() < (number_of_pixels * bpp)))
+  {
+    spdlog::warn("target image is empty or smaller than its size!");
+    return false;
+  }
+
+  targetHistogramGray.fill(0.0);
+  targetHistogramRed.fill(0.0);
+  targetHistogramGreen.fill(0.0);
+  targetHistogramBlue.fill(0.0);
+
+  for (size_t i=0; i<number_of_pixels; i++)
+  {
+    const uint8_t * pixel = &target_image[i * bpp];
+    targetHistogramGray[(pixel[0] + pixel[1] + pixel[2]) / 3] += 1.0;
+    targetHistogramRed[pixel[0]] += 1.0;
+    targetHistogramGreen[pixel[1]] += 1.0;
+    targetHistogramBlue[pixel[2]] += 1.0;
+  }
+
+  hasTargetHistogram = true;
+
+  return true;
+}
+
+bool HistogramEqualizationOp::LoadTargetHistogram(const std::string & file_path)
+{
+  // text file of 256 weights (one histogram used for every channel) or 3x256 weights (red, green then blue). the
+  // weights can be counts or probabilities and can be split by whitespace or commas
+
+  hasTargetHistogram = false;
+
+  std::ifstream histogram_file(file_path);
+
+  if (!histogram_file.is_open())
+  {
+    spdlog::warn("unable to open target histogram file: {}", file_path);
+    return false;
+  }
+
+  std::vector<double> weights;
+  std::string token;
+
+  while (std::getline(histogram_file, token, ','))
+  {
+    std::istringstream token_stream(token);
+    double weight = 0.0;
+    while (token_stream >> weight)
+    {
+      weights.emplace_back(std::max(weight, 0.0));
+    }
+  }
+
+  constexpr size_t number_of_bins = 256;
+
+  if ((weights.size() != number_of_bins) && (weights.size() != (number_of_bins * 3)))
+  {
+    spdlog::warn("target histogram file needs 256 or 768 values, found {}", weights.size());
+    return false;
+  }
+
+  const size_t number_of_channels = weights.size() / number_of_bins;
+  auto channel_weights = [&](size_t channel) {
+    std::array<double, 256> histogram = {};
+    std::copy_n(weights.begin() + static_cast<std::ptrdiff_t>((channel % number_of_channels) * number_of_bins), number_of_bins, histogram.begin());
+    return histogram;
+  };
+
+  targetHistogramRed = channel_weights(0);
+  targetHistogramGreen = channel_weights(1);
+  targetHistogramBlue = channel_weights(2);
+
+  // the gray histogram (channel average) can't be rebuilt from the per channel histograms so the mix of the
+  // normalized channels is used as an estimate
+
+  targetHistogramGray.fill(0.0);
+
+  for (const auto * histogram : {&targetHistogramRed, &targetHistogramGreen, &targetHistogramBlue})
+  {
+    double total = 0.0;
+    for (const auto & weight : *histogram)
+    {
+      total += weight;
+    }
+
+    for (size_t i=0; (total > 0.0) && (i<number_of_bins); i++)
+    {
+      targetHistogramGray[i] += (*histogram)[i] / total;
+    }
+  }
+
+  hasTargetHistogram = true;
+
+  return true;
+}
+
+bool HistogramEqualizationOp::HasTargetHistogram() const
+{
+  return hasTargetHistogram;
+}
+
 MenuOp_HistogramMethod HistogramEqualizationOp::GetCurrentSetOperation() const
 {
   return histogramMethod;
@@ -126,10 +603,6 @@ void HistogramEqualizationOp::ProcessHistogram(MenuOp_HistogramMethod operation
                                               ,const std::vector<uint8_t> & source_image
                                               ,uint8_t bpp)
 {
-  remappedValuesGray.clear();
-  remappedValuesRed.clear();
-  remappedValuesGreen.clear();
-  remappedValuesBlue.clear();
   remappedValuesNormalized.clear();
   remappedValuesNormalizedRed.clear();
   remappedValuesNormalizedGreen.clear();
@@ -151,224 +624,241 @@ void HistogramEqualizationOp::ProcessHistogram(MenuOp_HistogramMethod operation
       LocalizeEnhancementProcess(source_image, bpp);
       break;
 
+    case MenuOp_HistogramMethod::CLAHE:
+      ClaheProcess(source_image, bpp);
+      break;
+
+    case MenuOp_HistogramMethod::SPECIFICATION:
+      SpecificationProcess(source_image, bpp);
+      break;
+
     default:
       spdlog::warn("unrecognized method!");
       break;
   }
 }
 
-void HistogramEqualizationOp::GlobalProcess(const std::vector<uint8_t> & source_image
-                                           ,uint8_t bpp)
+void HistogramEqualizationOp::ProcessHistogram16(MenuOp_HistogramMethod operation
+                                                ,const std::vector<uint16_t> & source_image
+                                                ,uint8_t channels)
 {
-  result = source_image;
-
-  std::vector<int> sorted_gray_values;
-  std::vector<int> sorted_red_values;
-  std::vector<int> sorted_green_values;
-  std::vector<int> sorted_blue_values;
-
-  // sort pixel values by channel. iterating through the map should have the values as if sorted
+  remappedValuesNormalized.clear();
+  remappedValuesNormalizedRed.clear();
+  remappedValuesNormalizedGreen.clear();
+  remappedValuesNormalizedBlue.clear();
 
-  for(const auto & [opv, pvf] : histogramNormalizedGray)
-  {
-    sorted_gray_values.emplace_back(opv);
-  }
+  histogramMethod = operation;
 
-  for(const auto & [opv, pvf] : histogramNormalizedRed)
+  switch (operation)
   {
-    sorted_red_values.emplace_back(opv);
-  }
+    case MenuOp_HistogramMethod::GLOBAL:
+      GlobalProcess16(source_image, channels);
+      break;
 
-  for(const auto & [opv, pvf] : histogramNormalizedGreen)
-  {
-    sorted_green_values.emplace_back(opv);
+    default:
+      spdlog::warn("only the global method supports 16-bit images!");
+      result16 = source_image;
+      break;
   }
+}
 
-  for(const auto & [opv, pvf] : histogramNormalizedBlue)
-  {
-    sorted_blue_values.emplace_back(opv);
-  }
+void HistogramEqualizationOp::GlobalProcess16(const std::vector<uint16_t> & source_image
+                                             ,uint8_t channels)
+{
+  // same as the 8-bit global method but the lookup tables have an entry per value up to the max value. the
+  // cumulative counts are integers so the remapped value is rounded exactly without any float accumulation
 
-  // generate new mapped values for each channel
+  const size_t number_of_pixels = static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight);
 
-  for (size_t i=0; i<sorted_gray_values.size(); i++)
-  {
-    float new_mapped_value_gray = 0.0f;
+  auto equalize_lookup_table = [&](const std::vector<uint32_t> & histogram_counts) {
+    std::vector<uint16_t> lookup_table(histogram_counts.size(), 0);
+    uint64_t cumulative_count = 0;
 
-    for (size_t j=0; j<(i+1); j++)
+    for (size_t i=0; i<histogram_counts.size(); i++)
     {
-      new_mapped_value_gray += histogramNormalizedGray[sorted_gray_values[j]];
+      cumulative_count += histogram_counts[i];
+      lookup_table[i] = static_cast<uint16_t>(((cumulative_count * maxValue16) + (number_of_pixels / 2)) / std::max<size_t>(number_of_pixels, 1));
     }
 
-    remappedValuesGray[sorted_gray_values[i]] = static_cast<int>(std::round(static_cast<float>(HistogramOp::maxBppValue * new_mapped_value_gray)));
-  }
+    return lookup_table;
+  };
 
-  for (size_t i=0; i<sorted_red_values.size(); i++)
-  {
-    float new_mapped_value_red = 0.0f;
+  const auto lookup_table_gray = equalize_lookup_table(histogramCountsGray16);
+  const auto lookup_table_red = equalize_lookup_table(histogramCountsRed16);
+  const auto lookup_table_green = equalize_lookup_table(histogramCountsGreen16);
+  const auto lookup_table_blue = equalize_lookup_table(histogramCountsBlue16);
 
-    for (size_t j=0; j<(i+1); j++)
-    {
-      new_mapped_value_red += histogramNormalizedRed[sorted_red_values[j]];
-    }
+  result16 = source_image;
 
-    remappedValuesRed[sorted_red_values[i]] = static_cast<int>(std::round(static_cast<float>(HistogramOp::maxBppValue * new_mapped_value_red)));
-  }
+  const int32_t color_channels = std::min<int32_t>(channels, 3);
+  const uint32_t max_value = maxValue16;
 
-  for (size_t i=0; i<sorted_green_values.size(); i++)
-  {
-    float new_mapped_value_green = 0.0f;
+  progress.settotal(number_of_pixels);
 
-    for (size_t j=0; j<(i+1); j++)
-    {
-      new_mapped_value_green += histogramNormalizedGreen[sorted_green_values[j]];
-    }
+  RunBands(cpoolregistry::shared(), outHeight, outWidth, progress, [&](int32_t row_begin, int32_t row_end) {
+    const size_t pixel_begin = static_cast<size_t>(row_begin) * outWidth;
+    const size_t pixel_end = static_cast<size_t>(row_end) * outWidth;
+    const uint16_t * source = source_image.data();
+    uint16_t * destination = result16.data();
 
-    remappedValuesGreen[sorted_green_values[i]] = static_cast<int>(std::round(static_cast<float>(HistogramOp::maxBppValue * new_mapped_value_green)));
-  }
+    if ((inputColorType == MenuOp_HistogramColor::GRAY) || (color_channels == 1))
+    {
+      for (size_t i=pixel_begin; i<pixel_end; i++)
+      {
+        const size_t pixel_index = i * channels;
 
-  for (size_t i=0; i<sorted_blue_values.size(); i++)
-  {
-    float new_mapped_value_blue = 0.0f;
+        uint32_t gray_value = 0;
+        for (int32_t k=0; k<color_channels; k++)
+        {
+          gray_value += source[pixel_index + k];
+        }
 
-    for (size_t j=0; j<(i+1); j++)
+        const uint16_t remapped_value = lookup_table_gray[std::min(gray_value / color_channels, max_value)];
+        for (int32_t k=0; k<color_channels; k++)
+        {
+          destination[pixel_index + k] = remapped_value;
+        }
+      }
+    }
+    else // inputColorType == MenuOp_HistogramColor::RGBA
     {
-      new_mapped_value_blue += histogramNormalizedBlue[sorted_blue_values[j]];
+      for (size_t i=pixel_begin; i<pixel_end; i++)
+      {
+        const size_t pixel_index = i * channels;
+        destination[pixel_index + 0] = lookup_table_red[std::min<uint32_t>(source[pixel_index + 0], max_value)];
+        destination[pixel_index + 1] = lookup_table_green[std::min<uint32_t>(source[pixel_index + 1], max_value)];
+        destination[pixel_index + 2] = lookup_table_blue[std::min<uint32_t>(source[pixel_index + 2], max_value)];
+      }
     }
+  });
+}
 
-    remappedValuesBlue[sorted_blue_values[i]] = static_cast<int>(std::round(static_cast<float>(HistogramOp::maxBppValue * new_mapped_value_blue)));
-  }
+void HistogramEqualizationOp::GlobalProcess(const std::vector<uint8_t> & source_image
+                                           ,uint8_t bpp)
+{
+  // the remapped value of a pixel value is its cumulative probability scaled to the max value. iterating through
+  // the map has the values as if sorted so a running sum gives the cumulative probability
 
-  // remap the values for Histogram Equalization into the result buffer
+  auto equalize_lookup_table = [](const std::map<int32_t, float> & normalized_histogram) {
+    std::array<uint8_t, 256> lookup_table = {};
+    float cumulative_probability = 0.0f;
 
-  if (inputColorType == MenuOp_HistogramColor::GRAY)
-  {
-    for (size_t i=0; i<(outWidth*outHeight); i++)
+    for (const auto & [pixel_value, probability] : normalized_histogram)
     {
-      int32_t gray_value = (source_image[0 + i * bpp] + source_image[1 + i * bpp] + source_image[2 + i * bpp]) / 3;
-      result[0 + i * bpp] = remappedValuesGray[gray_value];
-      result[1 + i * bpp] = remappedValuesGray[gray_value];
-      result[2 + i * bpp] = remappedValuesGray[gray_value];
-      result[3 + i * bpp] = source_image[3 + i * bpp];
+      cumulative_probability += probability;
+      const auto remapped_value = static_cast<int32_t>(std::round(static_cast<float>(HistogramOp::maxBppValue * cumulative_probability)));
+      lookup_table[pixel_value] = static_cast<uint8_t>(std::clamp(remapped_value, 0, HistogramOp::maxBppValue));
     }
-  }
-  else if (inputColorType == MenuOp_HistogramColor::RGBA)
+
+    return lookup_table;
+  };
+
+  ApplyLookupTables(source_image
+                   ,bpp
+                   ,equalize_lookup_table(histogramNormalizedGray)
+                   ,equalize_lookup_table(histogramNormalizedRed)
+                   ,equalize_lookup_table(histogramNormalizedGreen)
+                   ,equalize_lookup_table(histogramNormalizedBlue));
+}
+
+void HistogramEqualizationOp::SpecificationProcess(const std::vector<uint8_t> & source_image
+                                                  ,uint8_t bpp)
+{
+  if (!hasTargetHistogram)
   {
-    for (size_t i = 0; i < (outWidth * outHeight); i++)
-    {
-      result[0 + i * bpp] = remappedValuesRed[source_image[0 + i * bpp]];
-      result[1 + i * bpp] = remappedValuesGreen[source_image[1 + i * bpp]];
-      result[2 + i * bpp] = remappedValuesBlue[source_image[2 + i * bpp]];
-      result[3 + i * bpp] = source_image[3 + i * bpp];
-    }
+    spdlog::warn("no target histogram to match! load a target image or histogram file first");
+    result = source_image;
+    return;
   }
+
+  ApplyLookupTables(source_image
+                   ,bpp
+                   ,BuildSpecificationLookupTable(histogramNormalizedGray, targetHistogramGray, HistogramOp::maxBppValue)
+                   ,BuildSpecificationLookupTable(histogramNormalizedRed, targetHistogramRed, HistogramOp::maxBppValue)
+                   ,BuildSpecificationLookupTable(histogramNormalizedGreen, targetHistogramGreen, HistogramOp::maxBppValue)
+                   ,BuildSpecificationLookupTable(histogramNormalizedBlue, targetHistogramBlue, HistogramOp::maxBppValue));
 }
 
-void HistogramEqualizationOp::LocalizeProcess(const std::vector<uint8_t> & source_image
-                                             ,uint8_t bpp)
+void HistogramEqualizationOp::ApplyLookupTables(const std::vector<uint8_t> & source_image
+                                               ,uint8_t bpp
+                                               ,const std::array<uint8_t, 256> & lookup_table_gray
+                                               ,const std::array<uint8_t, 256> & lookup_table_red
+                                               ,const std::array<uint8_t, 256> & lookup_table_green
+                                               ,const std::array<uint8_t, 256> & lookup_table_blue)
 {
+  // remap every pixel through a 256 entry table per channel. the tables stay in cache so this runs at the speed the
+  // rows can be streamed through, split into row bands over the pool
+
   result = source_image;
 
-  if (inputColorType == MenuOp_HistogramColor::GRAY)
-  {
-    std::vector<std::map<int32_t, int32_t>> kernel_histogram_remap(outWidth * outHeight);
+  progress.settotal(static_cast<size_t>(outWidth) * outHeight);
 
-    auto process_local_pixel = [this] (const std::vector<uint8_t> & source_image, std::vector<std::map<int32_t, int32_t>> & khr, uint8_t & bpp, int32_t i, int32_t j) {
-      auto [kernel_he_collection, min_value, max_value] = CollectPixelValues(source_image, outWidth, outHeight, j-(kernelSizeX / 2), i-(kernelSizeY / 2), j+(kernelSizeX / 2) + 1, i+(kernelSizeY / 2)+1, 0, 3, bpp);
-      auto kernel_he_normalized = NormalizeHistogramValues(kernel_he_collection, kernelSizeX, kernelSizeY);
+  RunBands(cpoolregistry::shared(), outHeight, outWidth, progress, [&](int32_t row_begin, int32_t row_end) {
+    const size_t pixel_begin = static_cast<size_t>(row_begin) * outWidth;
+    const size_t pixel_end = static_cast<size_t>(row_end) * outWidth;
+    const uint8_t * source = source_image.data();
+    uint8_t * destination = result.data();
 
-      float new_mapped_value_gray = 0.0f;
-      for (const auto & [k, v] : kernel_he_normalized)
+    if (inputColorType == MenuOp_HistogramColor::GRAY)
+    {
+      for (size_t i=pixel_begin; i<pixel_end; i++)
       {
-        new_mapped_value_gray += kernel_he_normalized[k];
-        khr[j + (i * outWidth)][k] = static_cast<int32_t>(std::round(static_cast<float>(HistogramOp::maxBppValue * new_mapped_value_gray)));
+        const size_t pixel_index = i * bpp;
+        const uint8_t gray_value = lookup_table_gray[(source[pixel_index + 0] + source[pixel_index + 1] + source[pixel_index + 2]) / 3];
+        destination[pixel_index + 0] = gray_value;
+        destination[pixel_index + 1] = gray_value;
+        destination[pixel_index + 2] = gray_value;
       }
-    };
-
-    for (int32_t i=0; i<outHeight; i++)
+    }
+    else // inputColorType == MenuOp_HistogramColor::RGBA
     {
-      for (int32_t j=0; j<outWidth; j++)
+      for (size_t i=pixel_begin; i<pixel_end; i++)
       {
-        workPool.addjob([&, ii=i, jj=j](){
-          process_local_pixel(source_image, kernel_histogram_remap, bpp, ii, jj);
-        });
+        const size_t pixel_index = i * bpp;
+        destination[pixel_index + 0] = lookup_table_red[source[pixel_index + 0]];
+        destination[pixel_index + 1] = lookup_table_green[source[pixel_index + 1]];
+        destination[pixel_index + 2] = lookup_table_blue[source[pixel_index + 2]];
       }
     }
+  });
+}
 
-    auto work_done = std::async([&](){
-      float work_completed = 0.0f;
-      while(work_completed < 1.0f)
-      {
-        work_completed = (static_cast<float>(outWidth * outHeight) - static_cast<float>(workPool.numberofjobs())) / static_cast<float>(outWidth * outHeight);
-        spdlog::info("histogram work completed: {:.2f}%", work_completed * 100.0f);
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-      }
-    });
+void HistogramEqualizationOp::LocalizeProcess(const std::vector<uint8_t> & source_image
+                                             ,uint8_t bpp)
+{
+  result = source_image;
 
-    workPool.waitforthread();
-    work_done.wait_for(std::chrono::milliseconds(1000));
+  // the rgba path reads each channel straight from the source. the gray path needs the channel average so it is
+  // computed once into a single plane (one byte per pixel) like the global method does
 
-    for (size_t i=0; i<(outWidth * outHeight); i++)
-    {
-      int32_t gray_value = (source_image[0 + i * bpp] + source_image[1 + i * bpp] + source_image[2 + i * bpp]) / 3;
-      result[0 + i * bpp] = kernel_histogram_remap[i][gray_value];
-      result[1 + i * bpp] = kernel_histogram_remap[i][gray_value];
-      result[2 + i * bpp] = kernel_histogram_remap[i][gray_value];
-      result[3 + i * bpp] = source_image[3 + i * bpp];
-    }
+  std::vector<uint8_t> gray_plane;
 
-  }
-  else // inputColorType == MenuOp_HistogramColor::RGBA
+  if (inputColorType == MenuOp_HistogramColor::GRAY)
   {
-    std::vector<std::map<int32_t, int32_t>> kernel_histogram_remap_red(outWidth * outHeight);
-    std::vector<std::map<int32_t, int32_t>> kernel_histogram_remap_green(outWidth * outHeight);
-    std::vector<std::map<int32_t, int32_t>> kernel_histogram_remap_blue(outWidth * outHeight);
+    gray_plane.resize(static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight));
 
-    auto process_local_pixel = [this] (const std::vector<uint8_t> & source_image, std::vector<std::map<int32_t, int32_t>> & khr, uint8_t & bpp, int32_t i, int32_t j, int32_t offset) {
-      auto [kernel_he_collection, min_value, max_value] = CollectPixelValues(source_image, outWidth, outHeight, j-(kernelSizeX / 2), i-(kernelSizeY / 2), j+(kernelSizeX / 2) + 1, i+(kernelSizeY / 2)+1, offset, 1, bpp);
-      auto kernel_he_normalized = NormalizeHistogramValues(kernel_he_collection, kernelSizeX, kernelSizeY);
-
-      float new_mapped_value_gray = 0.0f;
-      for (const auto & [k, v] : kernel_he_normalized)
-      {
-        new_mapped_value_gray += kernel_he_normalized[k];
-        khr[j + (i * outWidth)][k] = static_cast<int32_t>(std::round(static_cast<float>(HistogramOp::maxBppValue * new_mapped_value_gray)));
-      }
-    };
-
-    for (int32_t i=0; i<outHeight; i++)
+    for (size_t i=0; i<gray_plane.size(); i++)
     {
-      for (int32_t j=0; j<outWidth; j++)
-      {
-        workPool.addjob([&, ii=i, jj=j](){
-          process_local_pixel(source_image, kernel_histogram_remap_red, bpp, ii, jj, 0);
-          process_local_pixel(source_image, kernel_histogram_remap_green, bpp, ii, jj, 1);
-          process_local_pixel(source_image, kernel_histogram_remap_blue, bpp, ii, jj, 2);
-        });
-      }
+      gray_plane[i] = static_cast<uint8_t>((source_image[0 + i * bpp] + source_image[1 + i * bpp] + source_image[2 + i * bpp]) / 3);
     }
+  }
 
-    auto work_done = std::async([&](){
-      float work_completed = 0.0f;
-      while(work_completed < 1.0f)
-      {
-        work_completed = (static_cast<float>(outWidth * outHeight) - static_cast<float>(workPool.numberofjobs())) / static_cast<float>(outWidth * outHeight);
-        spdlog::info("histogram work completed: {:.2f}%", work_completed * 100.0f);
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-      }
-    });
+  // each job equalizes a band of rows and writes the remapped value of each pixel straight into the result buffer
 
-    workPool.waitforthread();
-    work_done.wait_for(std::chrono::milliseconds(1000));
+  progress.settotal(static_cast<size_t>(outWidth) * outHeight);
 
-    for (size_t i = 0; i < (outWidth * outHeight); i++)
+  RunBands(cpoolregistry::shared(), outHeight, outWidth, progress, [&](int32_t row_begin, int32_t row_end) {
+    if (inputColorType == MenuOp_HistogramColor::GRAY)
     {
-      result[0 + i * bpp] = kernel_histogram_remap_red[i][source_image[0 + i * bpp]];
-      result[1 + i * bpp] = kernel_histogram_remap_green[i][source_image[1 + i * bpp]];
-      result[2 + i * bpp] = kernel_histogram_remap_blue[i][source_image[2 + i * bpp]];
-      result[3 + i * bpp] = source_image[3 + i * bpp];
+      LocalizeEqualizeRows(gray_plane.data(), 1, 0, outWidth, outHeight, kernelSizeX, kernelSizeY, row_begin, row_end, result, bpp, 0, 3, HistogramOp::maxBppValue);
     }
-  }
+    else // inputColorType == MenuOp_HistogramColor::RGBA
+    {
+      LocalizeEqualizeRows(source_image.data(), bpp, 0, outWidth, outHeight, kernelSizeX, kernelSizeY, row_begin, row_end, result, bpp, 0, 1, HistogramOp::maxBppValue);
+      LocalizeEqualizeRows(source_image.data(), bpp, 1, outWidth, outHeight, kernelSizeX, kernelSizeY, row_begin, row_end, result, bpp, 1, 1, HistogramOp::maxBppValue);
+      LocalizeEqualizeRows(source_image.data(), bpp, 2, outWidth, outHeight, kernelSizeX, kernelSizeY, row_begin, row_end, result, bpp, 2, 1, HistogramOp::maxBppValue);
+    }
+  });
 }
 
 void HistogramEqualizationOp::LocalizeEnhancementProcess(const std::vector<uint8_t> & source_image
@@ -376,65 +866,108 @@ void HistogramEqualizationOp::LocalizeEnhancementProcess(const std::vector<uint8
 {
   result = source_image;
 
-  auto process_local_pixel = [this] (const std::vector<uint8_t> & source_image, std::vector<uint8_t> & r, float g_mean, float g_sd, float k0, float k1, float k2, float k3, float enhance_const, int32_t offset, int32_t count, uint8_t & bpp, int32_t i, int32_t j) {
-    auto [kernel_he_collection, min_value, max_value] = CollectPixelValues(source_image, outWidth, outHeight, j-(kernelSizeX / 2), i-(kernelSizeY / 2), j+(kernelSizeX / 2) + 1, i+(kernelSizeY / 2)+1, 0, 3, bpp);
-    auto kernel_he_normalized = NormalizeHistogramValues(kernel_he_collection, kernelSizeX, kernelSizeY);
-    auto kernel_mean = HistogramMean(kernel_he_normalized);
-    auto kernel_standard_deviation = HistogramStandardDeviation(kernel_he_normalized, kernel_mean);
+  // local mean and variance come from summed area tables of x and x^2 so each pixel costs the same no matter the
+  // kernel size. the window is clipped to the image and the statistics use the number of pixels actually inside it.
+  // the local statistics are always the ones of the gray (average of r, g and b) window, for rgba too, where every
+  // channel is tested against its own global statistics but enhanced where the gray window passes the test
 
-    if (((k0 * g_mean) <= kernel_mean && kernel_mean <= (k1 * g_mean)) && ((k2 * g_sd <= kernel_standard_deviation) && (kernel_standard_deviation <= k3 * g_sd)))
-    {
-      if (count > 0)
+  IntegralImage integral;
+
+  auto enhance_channel = [&](int32_t offset, int32_t sum_count, float global_mean, float global_standard_deviation) {
+    // the k0..k3 test is done on the mean and the variance so no square root is needed per pixel
+
+    const auto mean_low = static_cast<double>(kernelK0 * global_mean);
+    const auto mean_high = static_cast<double>(kernelK1 * global_mean);
+    const double sd_low = std::max(0.0, static_cast<double>(kernelK2 * global_standard_deviation));
+    const double sd_high = static_cast<double>(kernelK3 * global_standard_deviation);
+    const double variance_low = sd_low * sd_low;
+    const double variance_high = (sd_high < 0.0) ? -1.0 : (sd_high * sd_high);
+
+    RunBands(cpoolregistry::shared(), outHeight, outWidth, progress, [&](int32_t row_begin, int32_t row_end) {
+      for (int32_t i=row_begin; i<row_end; i++)
       {
-        float gray_value = 0.0f;
-        for (int32_t channel_counter = 0; channel_counter < count; channel_counter++)
+        const int32_t y_begin = std::max(i - (kernelSizeY / 2), 0);
+        const int32_t y_end = std::min(i - (kernelSizeY / 2) + kernelSizeY, outHeight);
+        const uint64_t * sum_top = &integral.sum[y_begin * integral.stride];
+        const uint64_t * sum_bottom = &integral.sum[y_end * integral.stride];
+        const uint64_t * sum_squared_top = &integral.sumSquared[y_begin * integral.stride];
+        const uint64_t * sum_squared_bottom = &integral.sumSquared[y_end * integral.stride];
+
+        for (int32_t j=0; j<outWidth; j++)
         {
-          gray_value += static_cast<float>(r[(j * bpp) + (i * outWidth * bpp) + offset + channel_counter]);
+          const int32_t x_begin = std::max(j - (kernelSizeX / 2), 0);
+          const int32_t x_end = std::min(j - (kernelSizeX / 2) + kernelSizeX, outWidth);
+
+          const auto window_count = static_cast<double>((x_end - x_begin) * (y_end - y_begin));
+          const auto window_sum = static_cast<double>(sum_bottom[x_end] - sum_bottom[x_begin] - sum_top[x_end] + sum_top[x_begin]);
+          const auto window_sum_squared = static_cast<double>(sum_squared_bottom[x_end] - sum_squared_bottom[x_begin] - sum_squared_top[x_end] + sum_squared_top[x_begin]);
+
+          const double mean = window_sum / window_count;
+          const double variance = (window_sum_squared / window_count) - (mean * mean);
+
+          const bool enhance = (mean_low <= mean) & (mean <= mean_high) & (variance_low <= variance) & (variance <= variance_high);
+
+          if (enhance)
+          {
+            const size_t pixel_index = (static_cast<size_t>(j) + static_cast<size_t>(i) * outWidth) * bpp;
+
+            if (sum_count > 1)
+            {
+              float gray_value = 0.0f;
+              for (int32_t k=0; k<sum_count; k++)
+              {
+                gray_value += static_cast<float>(source_image[pixel_index + offset + k]);
+              }
+              gray_value /= static_cast<float>(sum_count);
+
+              for (int32_t k=0; k<sum_count; k++)
+              {
+                result[pixel_index + offset + k] = static_cast<uint8_t>(std::clamp(gray_value * enhanceConst, 0.0f, 255.0f));
+              }
+            }
+            else
+            {
+              result[pixel_index + offset] = static_cast<uint8_t>(std::clamp(static_cast<float>(source_image[pixel_index + offset]) * enhanceConst, 0.0f, 255.0f));
+            }
+          }
         }
+      }
+    });
+  };
 
-        gray_value /= static_cast<float>(count);
+  // the gray integral image walks the image twice (row sums, column sums), then once per enhanced channel
 
-        for (int32_t channel_counter = 0; channel_counter < count; channel_counter++)
-        {
-          r[(j * bpp) + (i * outWidth * bpp) + offset + channel_counter] = static_cast<uint8_t>(std::clamp((gray_value * enhance_const), 0.0f, 255.0f));
-        }
+  const size_t number_of_passes = (inputColorType == MenuOp_HistogramColor::GRAY) ? 3 : 5;
+  progress.settotal(static_cast<size_t>(outWidth) * outHeight * number_of_passes);
 
-      }
-      else
-      {
-        r[(j * bpp) + (i * outWidth * bpp) + offset] = static_cast<uint8_t>(std::clamp(static_cast<float>(r[(j * bpp) + (i * outWidth * bpp) + offset]) * enhance_const, 0.0f,255.0f));
-      }
-    }
+  BuildIntegralImage(cpoolregistry::shared(), progress, source_image.data(), bpp, 0, 3, outWidth, outHeight, integral);
+
+  // the global statistics come from the power sums of the channel, collected in one pass over the source pixels.
+  // the standard deviation is taken about the rounded mean
+
+  const size_t number_of_pixels = static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight);
+
+  auto global_statistics = [&](int32_t offset, int32_t sum_count) {
+    const auto stats = HistogramStats::FromPixels(source_image.data(), number_of_pixels, bpp, offset, sum_count);
+    const auto mean = static_cast<float>(std::round(stats.Mean()));
+    const auto standard_deviation = static_cast<float>(std::round(std::sqrt(stats.CentralMoment(2, mean))));
+    return std::make_pair(mean, standard_deviation);
   };
 
   if (inputColorType == MenuOp_HistogramColor::GRAY)
   {
-    auto global_mean = std::round(HistogramMean(histogramNormalizedGray));
-    auto global_standard_deviation = std::round(HistogramStandardDeviation(histogramNormalizedGray, global_mean));
+    auto [global_mean, global_standard_deviation] = global_statistics(0, 3);
 
     spdlog::info("global mean: {}", global_mean);
     spdlog::info("global standard deviation: {}", global_standard_deviation);
 
-    for (int32_t i=0; i<outHeight; i++)
-    {
-      for (int32_t j=0; j<outWidth; j++)
-      {
-        workPool.addjob([&, ii=i, jj=j](){
-          process_local_pixel(source_image, result, global_mean, global_standard_deviation, kernelK0, kernelK1, kernelK2, kernelK3, enhanceConst, 0, 3, bpp, ii, jj);
-        });
-      }
-    }
+    enhance_channel(0, 3, global_mean, global_standard_deviation);
   }
   else // MenuOp_HistogramColor::RGBA
   {
-    auto global_mean_red = std::round(HistogramMean(histogramNormalizedRed));
-    auto global_standard_deviation_red = std::round(HistogramStandardDeviation(histogramNormalizedRed, global_mean_red));
-
-    auto global_mean_green = std::round(HistogramMean(histogramNormalizedGreen));
-    auto global_standard_deviation_green = std::round(HistogramStandardDeviation(histogramNormalizedGreen, global_mean_green));
-
-    auto global_mean_blue = std::round(HistogramMean(histogramNormalizedBlue));
-    auto global_standard_deviation_blue = std::round(HistogramStandardDeviation(histogramNormalizedBlue, global_mean_blue));
+    auto [global_mean_red, global_standard_deviation_red] = global_statistics(0, 1);
+    auto [global_mean_green, global_standard_deviation_green] = global_statistics(1, 1);
+    auto [global_mean_blue, global_standard_deviation_blue] = global_statistics(2, 1);
 
     spdlog::info("global mean (red): {}", global_mean_red);
     spdlog::info("global standard deviation (red): {}", global_standard_deviation_red);
@@ -445,30 +978,130 @@ void HistogramEqualizationOp::LocalizeEnhancementProcess(const std::vector<uint8
     spdlog::info("global mean (blue): {}", global_mean_blue);
     spdlog::info("global standard deviation (blue): {}", global_standard_deviation_blue);
 
-    for (int32_t i=0; i<outHeight; i++)
+    enhance_channel(0, 1, global_mean_red, global_standard_deviation_red);
+    enhance_channel(1, 1, global_mean_green, global_standard_deviation_green);
+    enhance_channel(2, 1, global_mean_blue, global_standard_deviation_blue);
+  }
+}
+
+void HistogramEqualizationOp::ClaheProcess(const std::vector<uint8_t> & source_image
+                                          ,uint8_t bpp)
+{
+  result = source_image;
+
+  const int32_t tiles_x = std::clamp(claheTilesX, 1, outWidth);
+  const int32_t tiles_y = std::clamp(claheTilesY, 1, outHeight);
+  const int32_t number_of_tiles = tiles_x * tiles_y;
+
+  std::vector<uint8_t> gray_plane;
+
+  if (inputColorType == MenuOp_HistogramColor::GRAY)
+  {
+    gray_plane.resize(static_cast<size_t>(outWidth) * static_cast<size_t>(outHeight));
+
+    for (size_t i=0; i<gray_plane.size(); i++)
     {
-      for (int32_t j=0; j<outWidth; j++)
-      {
-        workPool.addjob([&, ii=i, jj=j](){
-          process_local_pixel(source_image, result, global_mean_red, global_standard_deviation_red, kernelK0, kernelK1, kernelK2, kernelK3, enhanceConst, 0, 0, bpp, ii, jj);
-          process_local_pixel(source_image, result, global_mean_green, global_standard_deviation_green, kernelK0, kernelK1, kernelK2, kernelK3, enhanceConst, 1, 0, bpp, ii, jj);
-          process_local_pixel(source_image, result, global_mean_blue, global_standard_deviation_blue, kernelK0, kernelK1, kernelK2, kernelK3, enhanceConst, 2, 0, bpp, ii, jj);
-        });
-      }
+      gray_plane[i] = static_cast<uint8_t>((source_image[0 + i * bpp] + source_image[1 + i * bpp] + source_image[2 + i * bpp]) / 3);
     }
   }
 
-  auto work_done = std::async([&](){
-    float work_completed = 0.0f;
-    while(work_completed < 1.0f)
+  // every pixel blends the lookup tables of the (up to) 4 tiles whose centers surround it. the tile indices and
+  // blend weights only depend on the column (or row) so they are computed once
+
+  struct TileBlend
+  {
+    int32_t tile0 = 0;
+    int32_t tile1 = 0;
+    float weight = 0.0f;
+  };
+
+  auto tile_blends = [](int32_t size, int32_t tiles) {
+    // the centers of the actual tile bounds (tiles can differ by a pixel), before the first and after the last
+    // center only that tile's table is used
+
+    const auto tile_center = [&](int32_t tile) {
+      return 0.5f * static_cast<float>(tile_bound(tile, size, tiles) + tile_bound(tile + 1, size, tiles));
+    };
+
+    std::vector<TileBlend> blends(size);
+    int32_t tile0 = 0;
+
+    for (int32_t i=0; i<size; i++)
     {
-      work_completed = (static_cast<float>(outWidth * outHeight) - static_cast<float>(workPool.numberofjobs())) / static_cast<float>(outWidth * outHeight);
-      spdlog::info("histogram work completed: {:.2f}%", work_completed * 100.0f);
-      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+      const float position = static_cast<float>(i) + 0.5f;
+
+      while (((tile0 + 1) < tiles) && (tile_center(tile0 + 1) <= position))
+      {
+        tile0++;
+      }
+
+      blends[i].tile0 = tile0;
+      blends[i].tile1 = std::min(tile0 + 1, tiles - 1);
+
+      if (blends[i].tile1 != tile0)
+      {
+        const float center0 = tile_center(tile0);
+        blends[i].weight = std::clamp((position - center0) / (tile_center(tile0 + 1) - center0), 0.0f, 1.0f);
+      }
     }
-  });
+    return blends;
+  };
+
+  const auto column_blends = tile_blends(outWidth, tiles_x);
+  const auto row_blends = tile_blends(outHeight, tiles_y);
+
+  // tiles are counted in the progress by their average area
+  const size_t tile_area = std::max<size_t>(1, (static_cast<size_t>(outWidth) * outHeight) / number_of_tiles);
+
+  std::vector<std::array<uint8_t, 256>> lookup_tables(number_of_tiles);
+
+  auto equalize_channel = [&](const uint8_t * source, int32_t source_bpp, int32_t source_offset, int32_t offset, int32_t count) {
+    RunBands(cpoolregistry::shared(), number_of_tiles, tile_area, progress, [&](int32_t tile_begin, int32_t tile_end) {
+      BuildClaheLookupTables(source, source_bpp, source_offset, outWidth, outHeight, tiles_x, tiles_y, tile_begin, tile_end, claheClipLimit, HistogramOp::maxBppValue, lookup_tables);
+    });
+
+    RunBands(cpoolregistry::shared(), outHeight, outWidth, progress, [&](int32_t row_begin, int32_t row_end) {
+      for (int32_t i=row_begin; i<row_end; i++)
+      {
+        const auto & row_blend = row_blends[i];
+        const auto * tables_top = &lookup_tables[row_blend.tile0 * tiles_x];
+        const auto * tables_bottom = &lookup_tables[row_blend.tile1 * tiles_x];
+
+        for (int32_t j=0; j<outWidth; j++)
+        {
+          const auto & column_blend = column_blends[j];
+          const size_t pixel_index = static_cast<size_t>(j) + static_cast<size_t>(i) * outWidth;
+          const uint8_t pixel_value = source[(pixel_index * source_bpp) + source_offset];
+
+          const float top = static_cast<float>(tables_top[column_blend.tile0][pixel_value]) * (1.0f - column_blend.weight)
+                          + static_cast<float>(tables_top[column_blend.tile1][pixel_value]) * column_blend.weight;
+          const float bottom = static_cast<float>(tables_bottom[column_blend.tile0][pixel_value]) * (1.0f - column_blend.weight)
+                             + static_cast<float>(tables_bottom[column_blend.tile1][pixel_value]) * column_blend.weight;
+          const auto remapped_value = static_cast<uint8_t>(std::lround(top * (1.0f - row_blend.weight) + bottom * row_blend.weight));
+
+          for (int32_t c=0; c<count; c++)
+          {
+            result[(pixel_index * bpp) + offset + c] = remapped_value;
+          }
+        }
+      }
+    });
+  };
+
+  // every channel pass builds the tile tables (counted by tile area) and then blends each pixel
 
-  workPool.waitforthread();
-  work_done.wait();
+  const size_t number_of_passes = (inputColorType == MenuOp_HistogramColor::GRAY) ? 1 : 3;
+  const size_t tile_work = static_cast<size_t>(number_of_tiles) * tile_area;
+  progress.settotal((tile_work + static_cast<size_t>(outWidth) * outHeight) * number_of_passes);
 
+  if (inputColorType == MenuOp_HistogramColor::GRAY)
+  {
+    equalize_channel(gray_plane.data(), 1, 0, 0, 3);
+  }
+  else // inputColorType == MenuOp_HistogramColor::RGBA
+  {
+    equalize_channel(source_image.data(), bpp, 0, 0, 1);
+    equalize_channel(source_image.data(), bpp, 1, 1, 1);
+    equalize_channel(source_image.data(), bpp, 2, 2, 1);
+  }
 }
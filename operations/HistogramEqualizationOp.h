@@ -1,13 +1,14 @@
 #pragma once
 
 #include <map>
+#include <array>
+#include <string>
 #include "HistogramOp.h"
-#include "common/cthreadpool.h"
 
 class HistogramEqualizationOp : public HistogramOp
 {
   public:
-    HistogramEqualizationOp();
+    HistogramEqualizationOp() = default;
     ~HistogramEqualizationOp() = default;
 
     [[nodiscard]] const std::map<int32_t, float> & GetHistogramRemap() override;
@@ -20,6 +21,16 @@ class HistogramEqualizationOp : public HistogramOp
     void SetHistogramColorType(MenuOp_HistogramColor color_type);
     void SetLocalizeKernelSize(int32_t x, int32_t y);
     void SetLocalizeKernelConstants(float k0, float k1, float k2, float k3, float c);
+    void SetClaheTileGrid(int32_t tiles_x, int32_t tiles_y);
+    void SetClaheClipLimit(float clip_limit);
+    bool SetTargetHistogram(const std::vector<uint8_t> & target_image
+                           ,uint32_t width
+                           ,uint32_t height
+                           ,uint8_t bpp);
+    // a target that fails to load leaves the op without one (not with the previous target)
+    bool LoadTargetHistogram(const std::string & file_path);
+
+    [[nodiscard]] bool HasTargetHistogram() const;
 
     [[nodiscard]] MenuOp_HistogramMethod GetCurrentSetOperation() const;
 
@@ -28,11 +39,11 @@ class HistogramEqualizationOp : public HistogramOp
                          ,const std::vector<uint8_t> & source_image
                          ,uint8_t bpp) override;
 
+    void ProcessHistogram16(MenuOp_HistogramMethod operation
+                           ,const std::vector<uint16_t> & source_image
+                           ,uint8_t channels) override;
+
   private:
-    std::map<int, int> remappedValuesGray;
-    std::map<int, int> remappedValuesRed;
-    std::map<int, int> remappedValuesGreen;
-    std::map<int, int> remappedValuesBlue;
     std::map<int32_t, float> remappedValuesNormalized;
     std::map<int32_t, float> remappedValuesNormalizedRed;
     std::map<int32_t, float> remappedValuesNormalizedGreen;
@@ -48,8 +59,15 @@ class HistogramEqualizationOp : public HistogramOp
     float kernelK2 = 0.25f;
     float kernelK3 = 0.75f;
     float enhanceConst = 22.8f;
+    int32_t claheTilesX = 8;
+    int32_t claheTilesY = 8;
+    float claheClipLimit = 2.0f;
+    std::array<double, 256> targetHistogramGray = {}; // index => pixel value, value => weight of the pixel value
+    std::array<double, 256> targetHistogramRed = {};
+    std::array<double, 256> targetHistogramGreen = {};
+    std::array<double, 256> targetHistogramBlue = {};
+    bool hasTargetHistogram = false;
 
-    cthreadpool workPool;
 
     void GlobalProcess(const std::vector<uint8_t> & source_image
                       ,uint8_t bpp);
@@ -59,4 +77,20 @@ class HistogramEqualizationOp : public HistogramOp
 
     void LocalizeEnhancementProcess(const std::vector<uint8_t> & source_image
                                    ,uint8_t bpp);
+
+    void ClaheProcess(const std::vector<uint8_t> & source_image
+                     ,uint8_t bpp);
+
+    void SpecificationProcess(const std::vector<uint8_t> & source_image
+                             ,uint8_t bpp);
+
+    void GlobalProcess16(const std::vector<uint16_t> & source_image
+                        ,uint8_t channels);
+
+    void ApplyLookupTables(const std::vector<uint8_t> & source_image
+                          ,uint8_t bpp
+                          ,const std::array<uint8_t, 256> & lookup_table_gray
+                          ,const std::array<uint8_t, 256> & lookup_table_red
+                          ,const std::array<uint8_t, 256> & lookup_table_green
+                          ,const std::array<uint8_t, 256> & lookup_table_blue);
 };
@@ -3,15 +3,25 @@
 #include <limits>
 #include <algorithm>
 #include <cmath>
+#include <array>
+#include <spdlog/spdlog.h>
+#include "AsyncOp.h"
 
 std::vector<uint8_t> HistogramOp::ProcessImage
   (MenuOp_HistogramMethod operation
-  ,const std::vector<uint8_t> & source_image
-  ,uint32_t width
-  ,uint32_t height
-  ,uint8_t bpp
+  ,const cimageview & source_view
   ,uint16_t iterations)
 {
+  // the histograms and remaps index the pixels as one packed buffer. a whole owning view is that buffer already, a
+  // borrowed one or a roi is packed once here
+
+  std::vector<uint8_t> storage;
+  const std::vector<uint8_t> & source_image = source_view.packed(storage);
+
+  const uint32_t width = source_view.width();
+  const uint32_t height = source_view.height();
+  const uint8_t bpp = source_view.channels();
+
   histogramNormalizedGray.clear();
   histogramNormalizedRed.clear();
   histogramNormalizedGreen.clear();
@@ -24,6 +34,10 @@ std::vector<uint8_t> HistogramOp::ProcessImage
   outWidth = static_cast<int32_t>(width);
   outHeight = static_cast<int32_t>(height);
 
+  // the total is filled in by the method once it knows how much work it has to do
+
+  progress.begin(0);
+
   minPixelValueGray = (source_image[0] + source_image[1] + source_image[2]) / 3;
   maxPixelValueGray = (source_image[0] + source_image[1] + source_image[2]) / 3;
 
@@ -52,14 +66,124 @@ std::vector<uint8_t> HistogramOp::ProcessImage
 
   ProcessHistogram(operation, source_image, bpp);
 
+  progress.finish();
+
   return result;
 }
 
+ctask<std::vector<uint8_t>> HistogramOp::ProcessImageAsync(MenuOp_HistogramMethod operation
+                                                          ,cimageview source_image
+                                                          ,uint16_t iterations)
+{
+  return AsyncOp::Run(this, &HistogramOp::ProcessImage, operation, std::move(source_image), iterations);
+}
+
+std::vector<uint16_t> HistogramOp::ProcessImage16(MenuOp_HistogramMethod operation
+                                                 ,const std::vector<uint16_t> & source_image
+                                                 ,uint32_t width
+                                                 ,uint32_t height
+                                                 ,uint8_t channels
+                                                 ,uint16_t max_value)
+{
+  outWidth = static_cast<int32_t>(width);
+  outHeight = static_cast<int32_t>(height);
+  channels16 = std::clamp<uint8_t>(channels, 1, 4);
+  maxValue16 = std::max<uint16_t>(max_value, 1);
+
+  const size_t number_of_pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+
+  if (source_image.size() < (number_of_pixels * channels16))
+  {
+    spdlog::warn("16-bit source image is smaller than its size!");
+    result16.clear();
+    result.clear();
+    return result16;
+  }
+
+  progress.begin(0);
+
+  // flat histograms with a bin per value up to the max value (4096 bins for a 12-bit image, 65536 for 16-bit). a
+  // single channel image uses its histogram for every channel
+
+  const int32_t color_channels = std::min<int32_t>(channels16, 3);
+
+  histogramCountsGray16 = CollectPixelCounts16(source_image, number_of_pixels, channels16, 0, color_channels, maxValue16);
+
+  if (color_channels == 1)
+  {
+    histogramCountsRed16 = histogramCountsGreen16 = histogramCountsBlue16 = histogramCountsGray16;
+  }
+  else
+  {
+    histogramCountsRed16 = CollectPixelCounts16(source_image, number_of_pixels, channels16, 0, 1, maxValue16);
+    histogramCountsGreen16 = CollectPixelCounts16(source_image, number_of_pixels, channels16, 1, 1, maxValue16);
+    histogramCountsBlue16 = CollectPixelCounts16(source_image, number_of_pixels, channels16, 2, 1, maxValue16);
+  }
+
+  // the 8-bit histograms are only used for display so the bins are folded down to 256
+
+  histogramPixelValuesGray.clear();
+  histogramPixelValuesRed.clear();
+  histogramPixelValuesGreen.clear();
+  histogramPixelValuesBlue.clear();
+  histogramNormalizedGray = NormalizeHistogramCounts16(histogramCountsGray16, number_of_pixels, maxValue16);
+  histogramNormalizedRed = NormalizeHistogramCounts16(histogramCountsRed16, number_of_pixels, maxValue16);
+  histogramNormalizedGreen = NormalizeHistogramCounts16(histogramCountsGreen16, number_of_pixels, maxValue16);
+  histogramNormalizedBlue = NormalizeHistogramCounts16(histogramCountsBlue16, number_of_pixels, maxValue16);
+
+  ProcessHistogram16(operation, source_image, channels16);
+
+  // 8-bit rgba preview of the result so it can be shown like any other processed image
+
+  result.resize(number_of_pixels * 4);
+
+  for (size_t i=0; (i<number_of_pixels) && (result16.size() >= (number_of_pixels * channels16)); i++)
+  {
+    const uint16_t * pixel = &result16[i * channels16];
+    for (int32_t k=0; k<3; k++)
+    {
+      const uint32_t pixel_value = pixel[std::min(k, color_channels - 1)];
+      result[(i * 4) + k] = static_cast<uint8_t>(((pixel_value * maxBppValue) + (maxValue16 / 2)) / maxValue16);
+    }
+
+    result[(i * 4) + 3] = (channels16 == 4) ? static_cast<uint8_t>(((static_cast<uint32_t>(pixel[3]) * maxBppValue) + (maxValue16 / 2)) / maxValue16) : maxBppValue;
+  }
+
+  progress.finish();
+
+  return result16;
+}
+
+ctask<std::vector<uint16_t>> HistogramOp::ProcessImage16Async(MenuOp_HistogramMethod operation
+                                                             ,std::vector<uint16_t> source_image
+                                                             ,uint32_t width
+                                                             ,uint32_t height
+                                                             ,uint8_t channels
+                                                             ,uint16_t max_value)
+{
+  return AsyncOp::Run(this, &HistogramOp::ProcessImage16, operation, std::move(source_image), width, height, channels, max_value);
+}
+
 const std::vector<uint8_t> & HistogramOp::GetImage() const
 {
   return result;
 }
 
+const std::vector<uint16_t> & HistogramOp::GetImage16() const
+{
+  return result16;
+}
+
+uint8_t HistogramOp::GetChannels16() const
+{
+  return channels16;
+}
+
+uint16_t HistogramOp::GetMaxValue16() const
+{
+  return maxValue16;
+}
+
 const std::map<int32_t, float> & HistogramOp::GetHistogram() const
 {
   return histogramNormalizedGray;
@@ -110,6 +234,11 @@ int32_t HistogramOp::GetHeight() const
   return outHeight;
 }
 
+const cprogress & HistogramOp::GetProgress() const
+{
+  return progress;
+}
+
 std::tuple<std::map<int32_t, std::vector<int32_t>>, int32_t, int32_t> HistogramOp::CollectPixelValues
   (const std::vector<uint8_t> & source_image
   ,uint32_t width
@@ -167,8 +296,8 @@ std::tuple<std::map<int32_t, std::vector<int32_t>>, int32_t, int32_t> HistogramO
   {
     for(int32_t j=x_pos_start; j<x_pos_end; j++)
     {
-      int32_t ii = std::clamp(i, static_cast<int32_t>(0), static_cast<int32_t>(width)-1);
-      int32_t jj = std::clamp(j, static_cast<int32_t>(0), static_cast<int32_t>(height)-1);
+      int32_t ii = std::clamp(i, static_cast<int32_t>(0), static_cast<int32_t>(height)-1);
+      int32_t jj = std::clamp(j, static_cast<int32_t>(0), static_cast<int32_t>(width)-1);
       int32_t pixel_value = 0;
       if (sum_count > 0)
       {
@@ -196,15 +325,7 @@ std::tuple<std::map<int32_t, std::vector<int32_t>>, int32_t, int32_t> HistogramO
 
 float HistogramOp::HistogramMean(const std::map<int32_t, float> & normalized_pixel_probability_map)
 {
-  float mean = 0.0f;
-
-  for (const auto & [pixel_value, probability] : normalized_pixel_probability_map)
-  {
-    mean += (static_cast<float>(pixel_value) * probability);
-  }
-
-  return mean;
-
+  return static_cast<float>(HistogramStats::FromHistogram(normalized_pixel_probability_map).Mean());
 }
 
 float HistogramOp::HistogramVariance(const std::map<int32_t, float> & normalized_pixel_probability_map
@@ -223,14 +344,28 @@ float HistogramOp::HistogramNthMoment(const std::map<int32_t, float> & normalize
                                      ,float mean
                                      ,int32_t root)
 {
-  float moment = 0.0f;
+  // the power sums only go up to HistogramStats::maxPower. anything higher is done directly (still without std::pow)
+
+  if (root <= HistogramStats::maxPower)
+  {
+    return static_cast<float>(HistogramStats::FromHistogram(normalized_pixel_probability_map).CentralMoment(root, mean));
+  }
+
+  double moment = 0.0;
 
   for (const auto & [pixel_value, probability] : normalized_pixel_probability_map)
   {
-    moment += ((static_cast<float>(std::pow(static_cast<float>(pixel_value) - mean, root)) * probability));
+    const double difference = static_cast<double>(pixel_value) - static_cast<double>(mean);
+    double difference_power = 1.0;
+    for (int32_t i=0; i<root; i++)
+    {
+      difference_power *= difference;
+    }
+
+    moment += difference_power * static_cast<double>(probability);
   }
 
-  return moment;
+  return static_cast<float>(moment);
 }
 
 std::map<int32_t, float> HistogramOp::NormalizeHistogramValues(const std::map<int32_t, std::vector<int32_t>> & histogram
@@ -249,8 +384,70 @@ std::map<int32_t, float> HistogramOp::NormalizeHistogramValues(const std::map<in
   return normalized_histogram;
 }
 
+std::vector<uint32_t> HistogramOp::CollectPixelCounts16(const std::vector<uint16_t> & source_image
+                                                       ,size_t number_of_pixels
+                                                       ,int32_t channels
+                                                       ,int32_t offset
+                                                       ,int32_t sum_count
+                                                       ,uint16_t max_value)
+{
+  // count every value of a channel (or the average of sum_count channels starting at offset) into a flat histogram.
+  // values above the max value are counted in the last bin
+
+  std::vector<uint32_t> histogram_counts(static_cast<size_t>(max_value) + 1, 0);
+  sum_count = std::max(1, sum_count);
+
+  for (size_t i=0; i<number_of_pixels; i++)
+  {
+    const uint16_t * pixel = &source_image[(i * channels) + offset];
+
+    uint32_t pixel_value = 0;
+    for (int32_t k=0; k<sum_count; k++)
+    {
+      pixel_value += pixel[k];
+    }
+
+    histogram_counts[std::min<uint32_t>(pixel_value / sum_count, max_value)]++;
+  }
+
+  return histogram_counts;
+}
+
+std::map<int32_t, float> HistogramOp::NormalizeHistogramCounts16(const std::vector<uint32_t> & histogram_counts
+                                                                ,size_t number_of_pixels
+                                                                ,uint16_t max_value)
+{
+  // fold the bins into the 256 bins of the 8-bit histograms and normalize by the number of pixels
+
+  std::array<uint64_t, (maxBppValue + 1)> folded_counts = {};
+
+  for (size_t i=0; i<histogram_counts.size(); i++)
+  {
+    folded_counts[((i * maxBppValue) + (max_value / 2)) / max_value] += histogram_counts[i];
+  }
+
+  std::map<int32_t, float> normalized_histogram;
+
+  for (int32_t i=0; i<static_cast<int32_t>(folded_counts.size()); i++)
+  {
+    if (folded_counts[i] > 0)
+    {
+      normalized_histogram[i] = static_cast<float>(folded_counts[i]) / static_cast<float>(number_of_pixels);
+    }
+  }
+
+  return normalized_histogram;
+}
+
 void HistogramOp::ProcessHistogram(MenuOp_HistogramMethod operation
                                   ,const std::vector<uint8_t> & source_image
                                   ,uint8_t bpp)
 {
+}
+
+void HistogramOp::ProcessHistogram16([[maybe_unused]] MenuOp_HistogramMethod operation
+                                    ,const std::vector<uint16_t> & source_image
+                                    ,[[maybe_unused]] uint8_t channels)
+{
+  result16 = source_image;
 }
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include <cstdint>
 #include <tuple>
 #include "MenuOps.h"
+#include "HistogramStats.h"
+#include "common/cimageview.h"
+#include "common/cprogress.h"
+#include "common/ctask.h"
 
 class HistogramOp
 {
@@ -13,13 +17,33 @@ class HistogramOp
     ~HistogramOp() = default;
 
     std::vector<uint8_t> ProcessImage(MenuOp_HistogramMethod operation
-                                     ,const std::vector<uint8_t> & source_image
-                                     ,uint32_t width
-                                     ,uint32_t height
-                                     ,uint8_t bpp
+                                     ,const cimageview & source_image
                                      ,uint16_t iterations);
 
+    // ProcessImage on the shared pool (see AsyncOp)
+    ctask<std::vector<uint8_t>> ProcessImageAsync(MenuOp_HistogramMethod operation
+                                                 ,cimageview source_image
+                                                 ,uint16_t iterations);
+
+    // high bit depth (ex. 12/16-bit microscopy) images. channels are interleaved uint16 values (1 = gray, 3 = rgb,
+    // 4 = rgba) in [0, max_value]. the 8-bit image/histograms are filled with a preview of the result
+
+    std::vector<uint16_t> ProcessImage16(MenuOp_HistogramMethod operation
+                                        ,const std::vector<uint16_t> & source_image
+                                        ,uint32_t width
+                                        ,uint32_t height
+                                        ,uint8_t channels
+                                        ,uint16_t max_value);
+
+    ctask<std::vector<uint16_t>> ProcessImage16Async(MenuOp_HistogramMethod operation
+                                                    ,std::vector<uint16_t> source_image
+                                                    ,uint32_t width
+                                                    ,uint32_t height
+                                                    ,uint8_t channels
+                                                    ,uint16_t max_value);
+
     [[nodiscard]] const std::vector<uint8_t> & GetImage() const;
+    [[nodiscard]] const std::vector<uint16_t> & GetImage16() const;
     [[nodiscard]] const std::map<int32_t, float> & GetHistogram() const;
     [[nodiscard]] const std::map<int32_t, float> & GetHistogramRed() const;
     [[nodiscard]] const std::map<int32_t, float> & GetHistogramGreen() const;
@@ -29,8 +53,12 @@ class HistogramOp
     [[nodiscard]] virtual const std::map<int32_t, float> & GetHistogramRemapGreen();
     [[nodiscard]] virtual const std::map<int32_t, float> & GetHistogramRemapBlue();
 
+    [[nodiscard]] uint8_t GetChannels16() const;
+    [[nodiscard]] uint16_t GetMaxValue16() const;
+
     [[nodiscard]] int32_t GetWidth() const;
     [[nodiscard]] int32_t GetHeight() const;
+    [[nodiscard]] const cprogress & GetProgress() const;
 
   protected:
 
@@ -68,9 +96,25 @@ class HistogramOp
                                                             ,uint32_t width
                                                             ,uint32_t height);
 
+    static std::vector<uint32_t> CollectPixelCounts16(const std::vector<uint16_t> & source_image
+                                                     ,size_t number_of_pixels
+                                                     ,int32_t channels
+                                                     ,int32_t offset
+                                                     ,int32_t sum_count
+                                                     ,uint16_t max_value);
+
+    static std::map<int32_t, float> NormalizeHistogramCounts16(const std::vector<uint32_t> & histogram_counts
+                                                              ,size_t number_of_pixels
+                                                              ,uint16_t max_value);
+
     virtual void ProcessHistogram(MenuOp_HistogramMethod operation
                                  ,const std::vector<uint8_t> & source_image
                                  ,uint8_t bpp);
+
+    virtual void ProcessHistogram16(MenuOp_HistogramMethod operation
+                                   ,const std::vector<uint16_t> & source_image
+                                   ,uint8_t channels);
+
     int32_t outWidth = 0;
     int32_t outHeight = 0;
     int32_t minPixelValueGray = 0;
@@ -90,9 +134,18 @@ class HistogramOp
     std::map<int32_t, std::vector<int32_t>> histogramPixelValuesBlue; // key => pixel value, value => pixel index
     std::map<int32_t, float> histogramNormalizedBlue; // key => pixel value, value => normalized amount of pixels for the key value
 
+    std::vector<uint32_t> histogramCountsGray16; // index => pixel value, value => number of pixels with the value
+    std::vector<uint32_t> histogramCountsRed16;
+    std::vector<uint32_t> histogramCountsGreen16;
+    std::vector<uint32_t> histogramCountsBlue16;
+    uint8_t channels16 = 1;
+    uint16_t maxValue16 = 65535;
+
     static constexpr int32_t maxBppValue = 255;
 
     std::vector<uint8_t> result;
+    std::vector<uint16_t> result16;
+    cprogress progress;
 
   private:
     std::map<int32_t, float> dummy;
@@ -0,0 +1,147 @@
+#include "HistogramStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+HistogramStats HistogramStats::FromHistogram(const uint32_t * bin_counts
+                                            ,size_t number_of_bins)
+{
+  // the bin index is the pixel value. the powers of the value are built up by multiplying instead of std::pow
+
+  HistogramStats stats;
+
+  for (size_t i=0; i<number_of_bins; i++)
+  {
+    if (bin_counts[i] > 0)
+    {
+      stats.Add(static_cast<double>(i), static_cast<double>(bin_counts[i]));
+    }
+  }
+
+  return stats;
+}
+
+HistogramStats HistogramStats::FromHistogram(const std::map<int32_t, float> & normalized_pixel_probability_map)
+{
+  // the weights are probabilities so the count of the stats ends up being (close to) 1
+
+  HistogramStats stats;
+
+  for (const auto & [pixel_value, probability] : normalized_pixel_probability_map)
+  {
+    stats.Add(static_cast<double>(pixel_value), static_cast<double>(probability));
+  }
+
+  return stats;
+}
+
+HistogramStats HistogramStats::FromPixels(const uint8_t * source
+                                         ,size_t number_of_pixels
+                                         ,int32_t bpp
+                                         ,int32_t offset
+                                         ,int32_t sum_count)
+{
+  // one pass over the pixels counts each value (sum_count > 1 averages that many channels starting at offset like
+  // the gray channel does). the power sums are then taken over the 256 bins instead of every pixel
+
+  std::array<uint32_t, 256> bin_counts = {};
+  sum_count = std::max(1, sum_count);
+
+  for (size_t i=0; i<number_of_pixels; i++)
+  {
+    const uint8_t * pixel = source + (i * bpp) + offset;
+
+    int32_t pixel_value = 0;
+    for (int32_t k=0; k<sum_count; k++)
+    {
+      pixel_value += pixel[k];
+    }
+
+    bin_counts[pixel_value / sum_count]++;
+  }
+
+  return FromHistogram(bin_counts.data(), bin_counts.size());
+}
+
+void HistogramStats::Add(double value, double weight)
+{
+  double value_power = weight;
+  for (auto & power_sum : powerSums)
+  {
+    power_sum += value_power;
+    value_power *= value;
+  }
+}
+
+void HistogramStats::Merge(const HistogramStats & other)
+{
+  for (size_t i=0; i<powerSums.size(); i++)
+  {
+    powerSums[i] += other.powerSums[i];
+  }
+}
+
+double HistogramStats::Count() const
+{
+  return powerSums[0];
+}
+
+double HistogramStats::PowerSum(int32_t power) const
+{
+  return powerSums[std::clamp(power, 0, maxPower)];
+}
+
+double HistogramStats::Mean() const
+{
+  return (Count() > 0.0) ? (powerSums[1] / Count()) : 0.0;
+}
+
+double HistogramStats::Variance() const
+{
+  return CentralMoment(2);
+}
+
+double HistogramStats::StandardDeviation() const
+{
+  return std::sqrt(Variance());
+}
+
+double HistogramStats::CentralMoment(int32_t nth) const
+{
+  return CentralMoment(nth, Mean());
+}
+
+double HistogramStats::CentralMoment(int32_t nth, double center) const
+{
+  // E[(x - c)^n] = sum over k of C(n, k) * (-c)^(n - k) * E[x^k]. only moments up to maxPower can be derived
+
+  if ((Count() <= 0.0) || (nth < 0) || (nth > maxPower))
+  {
+    return 0.0;
+  }
+
+  double moment = 0.0;
+  double binomial = 1.0;
+  double center_power = 1.0;
+
+  // walk k from n down to 0 so (-c)^(n - k) grows by one factor of -c per step
+
+  for (int32_t k=nth; k>=0; k--)
+  {
+    moment += binomial * center_power * powerSums[k];
+
+    binomial = binomial * static_cast<double>(k) / static_cast<double>(nth - k + 1);
+    center_power *= -center;
+  }
+
+  moment /= Count();
+
+  // the variance (and any even moment) can't be negative. rounding when the spread is tiny can push it below 0
+
+  if ((nth % 2) == 0)
+  {
+    moment = std::max(moment, 0.0);
+  }
+
+  return moment;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+
+// power sums (count, sum of x, sum of x^2, ... sum of x^maxPower) of a set of pixel values. they are collected in a
+// single pass over a flat histogram or the raw pixels and every statistic (mean, variance, nth central moment about
+// any center) is derived from them afterwards without going back over the data
+
+class HistogramStats
+{
+  public:
+    static constexpr int32_t maxPower = 4;
+
+    HistogramStats() = default;
+    ~HistogramStats() = default;
+
+    static HistogramStats FromHistogram(const uint32_t * bin_counts
+                                       ,size_t number_of_bins);
+
+    static HistogramStats FromHistogram(const std::map<int32_t, float> & normalized_pixel_probability_map);
+
+    static HistogramStats FromPixels(const uint8_t * source
+                                    ,size_t number_of_pixels
+                                    ,int32_t bpp
+                                    ,int32_t offset
+                                    ,int32_t sum_count);
+
+    void Add(double value, double weight = 1.0);
+    void Merge(const HistogramStats & other);
+
+    [[nodiscard]] double Count() const;
+    [[nodiscard]] double PowerSum(int32_t power) const;
+    [[nodiscard]] double Mean() const;
+    [[nodiscard]] double Variance() const;
+    [[nodiscard]] double StandardDeviation() const;
+    [[nodiscard]] double CentralMoment(int32_t nth) const;
+    [[nodiscard]] double CentralMoment(int32_t nth, double center) const;
+
+  private:
+    std::array<double, maxPower + 1> powerSums = {};
+};
@@ -0,0 +1,405 @@
+#include "LazyImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include "NetpbmCodec.h"
+#include "common/cparallel.h"
+#include "common/cpoolregistry.h"
+
+namespace
+{
+  // an export band is cut into tile_size wide regions, as many rows as fit in this many bytes (at most a tile)
+  constexpr size_t export_band_bytes = static_cast<size_t>(32) << 20;
+
+  int32_t level_size(int32_t size, uint32_t level)
+  {
+    const int64_t factor = static_cast<int64_t>(1) << level;
+    return static_cast<int32_t>((static_cast<int64_t>(size) + factor - 1) / factor);
+  }
+
+  // work runs as an INTERACTIVE job of the shared pool (the loops it starts get the same priority) so a view doesn't
+  // queue up behind an export or a full render
+  ctask<void> run_interactive(std::function<void()> work)
+  {
+    co_await cpoolregistry::shared().schedule(cjobpriority::INTERACTIVE);
+
+    work();
+  }
+}
+
+void LazyImage::Reset(int32_t width
+                     ,int32_t height
+                     ,uint8_t bpp
+                     ,uint32_t max_level
+                     ,bool is_virtual
+                     ,RegionFunction evaluate)
+{
+  Clear();
+
+  imageWidth = std::max(0, width);
+  imageHeight = std::max(0, height);
+  imageBpp = bpp;
+  maxLevel = max_level;
+  isVirtual = is_virtual;
+  evaluateRegion = std::move(evaluate);
+}
+
+void LazyImage::Clear()
+{
+  imageWidth = 0;
+  imageHeight = 0;
+  maxLevel = 0;
+  isVirtual = false;
+  evaluateRegion = nullptr;
+
+  tiles.clear();
+  tileLookup.clear();
+  cachedBytes = 0;
+
+  // a view still being evaluated finishes on its own, nothing waits for it
+  pendingView.reset();
+  pendingTask = std::future<void>();
+  renderedView = Region();
+}
+
+bool LazyImage::RenderView(uint32_t level
+                          ,int32_t view_x
+                          ,int32_t view_y
+                          ,int32_t view_width
+                          ,int32_t view_height
+                          ,std::vector<uint8_t> & view_pixels)
+{
+  view_width = std::max(0, view_width);
+  view_height = std::max(0, view_height);
+  const size_t view_bytes = static_cast<size_t>(view_width) * static_cast<size_t>(view_height) * imageBpp;
+
+  if (IsEmpty())
+  {
+    view_pixels.assign(view_bytes, 0);
+    return true;
+  }
+
+  const bool has_new_tiles = FinishPendingView();
+
+  level = std::min(level, maxLevel);
+
+  const int32_t level_width = GetLevelWidth(level);
+  const int32_t level_height = GetLevelHeight(level);
+  const size_t view_stride = static_cast<size_t>(view_width) * imageBpp;
+
+  // the part of the view that's inside the image
+
+  const int32_t x_begin = std::max(view_x, 0);
+  const int32_t y_begin = std::max(view_y, 0);
+  const int32_t x_end = std::min(view_x + view_width, level_width);
+  const int32_t y_end = std::min(view_y + view_height, level_height);
+
+  if ((x_begin >= x_end) || (y_begin >= y_end))
+  {
+    view_pixels.assign(view_bytes, 0);
+    renderedView = Region();
+    return true;
+  }
+
+  const auto view_offset = [view_x, view_y, view_stride, bpp = imageBpp](int32_t x, int32_t y) {
+    return (static_cast<size_t>(y - view_y) * view_stride) + (static_cast<size_t>(x - view_x) * bpp);
+  };
+
+  if (isVirtual)
+  {
+    // only a lookup into the source, cheap enough to evaluate straight into the view on the calling thread
+
+    view_pixels.assign(view_bytes, 0);
+
+    const Region region{level, level_width, level_height, x_begin, y_begin, x_end - x_begin, y_end - y_begin};
+    evaluateRegion(region, view_pixels.data() + view_offset(x_begin, y_begin), view_stride);
+
+    return true;
+  }
+
+  // the same view again only needs handing back when tiles have landed since. its missing tiles are queued already (or
+  // go once the tiles being evaluated land)
+
+  const bool is_same_view = (renderedView.level == level)
+                         && (renderedView.x == view_x)
+                         && (renderedView.y == view_y)
+                         && (renderedView.width == view_width)
+                         && (renderedView.height == view_height);
+
+  if (is_same_view && !has_new_tiles)
+  {
+    return false;
+  }
+
+  const int32_t tile_x_begin = x_begin / tile_size;
+  const int32_t tile_y_begin = y_begin / tile_size;
+  const int32_t tile_x_end = ((x_end - 1) / tile_size) + 1;
+  const int32_t tile_y_end = ((y_end - 1) / tile_size) + 1;
+
+  // copies the covered part of a tile of the level into the view. a tile of a coarser level (shift levels up, the one
+  // holding tile_x/tile_y of the level) is scaled up to it, nearest
+
+  const auto copy_tile = [&](const Tile & tile, int32_t tile_x, int32_t tile_y, uint32_t shift) {
+    const int32_t copy_x_begin = std::max(x_begin, tile_x * tile_size);
+    const int32_t copy_y_begin = std::max(y_begin, tile_y * tile_size);
+    const int32_t copy_x_end = std::min(x_end, (tile_x + 1) * tile_size);
+    const int32_t copy_y_end = std::min(y_end, (tile_y + 1) * tile_size);
+    const int32_t source_x = (tile_x >> shift) * tile_size;
+    const int32_t source_y = (tile_y >> shift) * tile_size;
+    const size_t tile_stride = static_cast<size_t>(tile.width) * imageBpp;
+
+    for (int32_t y=copy_y_begin; y<copy_y_end; y++)
+    {
+      const uint8_t * tile_row = tile.pixels.data() + (static_cast<size_t>((y >> shift) - source_y) * tile_stride);
+      uint8_t * view_row = view_pixels.data() + view_offset(copy_x_begin, y);
+
+      if (shift == 0)
+      {
+        std::memcpy(view_row, tile_row + (static_cast<size_t>(copy_x_begin - source_x) * imageBpp), static_cast<size_t>(copy_x_end - copy_x_begin) * imageBpp);
+        continue;
+      }
+
+      for (int32_t x=copy_x_begin; x<copy_x_end; x++, view_row+=imageBpp)
+      {
+        std::memcpy(view_row, tile_row + (static_cast<size_t>((x >> shift) - source_x) * imageBpp), imageBpp);
+      }
+    }
+  };
+
+  // cached tiles of the view move to the front of the lru list. a missing tile is drawn from the closest coarser level
+  // that has it cached until it's evaluated, the missing ones are evaluated together on the pool (unless tiles of an
+  // earlier view still are, then they go once those are done)
+
+  view_pixels.assign(view_bytes, 0);
+
+  std::vector<Region> missing_regions;
+
+  for (int32_t tile_y=tile_y_begin; tile_y<tile_y_end; tile_y++)
+  {
+    for (int32_t tile_x=tile_x_begin; tile_x<tile_x_end; tile_x++)
+    {
+      const auto cached = tileLookup.find(TileKey(level, tile_x, tile_y));
+
+      if (cached != tileLookup.end())
+      {
+        tiles.splice(tiles.begin(), tiles, cached->second);
+        copy_tile(*cached->second, tile_x, tile_y, 0);
+        continue;
+      }
+
+      missing_regions.emplace_back(TileRegion(level, tile_x, tile_y));
+
+      for (uint32_t coarse_level=level+1; coarse_level<=maxLevel; coarse_level++)
+      {
+        const uint32_t shift = coarse_level - level;
+        const auto coarse = tileLookup.find(TileKey(coarse_level, tile_x >> shift, tile_y >> shift));
+
+        if (coarse != tileLookup.end())
+        {
+          copy_tile(*coarse->second, tile_x, tile_y, shift);
+          break;
+        }
+      }
+    }
+  }
+
+  if (!missing_regions.empty() && !pendingTask.valid())
+  {
+    auto pending = std::make_shared<PendingView>();
+    for (const Region & region : missing_regions)
+    {
+      pending->tiles.emplace_back(Tile{TileKey(level, region.x / tile_size, region.y / tile_size), region.width, region.height, {}});
+    }
+    pending->regions = std::move(missing_regions);
+
+    pendingView = pending;
+    pendingTask = to_future(run_interactive([pending, evaluate = evaluateRegion, bpp = imageBpp]() {
+      parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), pending->tiles.size(), [&](size_t i) {
+        Tile & tile = pending->tiles[i];
+        tile.pixels.resize(static_cast<size_t>(tile.width) * static_cast<size_t>(tile.height) * bpp);
+        evaluate(pending->regions[i], tile.pixels.data(), static_cast<size_t>(tile.width) * bpp);
+      }, 1, cparallelschedule::DYNAMIC);
+    }));
+  }
+
+  TrimCache();
+
+  renderedView = Region{level, level_width, level_height, view_x, view_y, view_width, view_height};
+
+  return true;
+}
+
+bool LazyImage::WritePam(const std::string & file_path)
+{
+  if (IsEmpty())
+  {
+    spdlog::warn("no lazy output to export!");
+    return false;
+  }
+
+  std::ofstream file(file_path, std::ofstream::binary);
+
+  if (!file.is_open())
+  {
+    spdlog::warn("unable to create pam file: {}", file_path);
+    return false;
+  }
+
+  file << NetpbmCodec::PamHeader(static_cast<uint32_t>(imageWidth), static_cast<uint32_t>(imageHeight), imageBpp, 255);
+
+  const size_t stride = static_cast<size_t>(imageWidth) * imageBpp;
+  const int32_t band_rows = static_cast<int32_t>(std::clamp(export_band_bytes / stride, static_cast<size_t>(1), static_cast<size_t>(tile_size)));
+  std::vector<uint8_t> band(stride * static_cast<size_t>(band_rows));
+
+  exportProgress.begin(static_cast<size_t>(imageWidth) * static_cast<size_t>(imageHeight));
+
+  for (int32_t band_y=0; (band_y<imageHeight) && file; band_y+=band_rows)
+  {
+    const int32_t rows = std::min(band_rows, imageHeight - band_y);
+
+    parallel_for_2d(cpoolregistry::shared(), imageWidth, rows, tile_size, rows, [&](int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+      const Region region{0, imageWidth, imageHeight, x0, band_y + y0, x1 - x0, y1 - y0};
+      evaluateRegion(region, band.data() + (static_cast<size_t>(y0) * stride) + (static_cast<size_t>(x0) * imageBpp), stride);
+      exportProgress.advance(static_cast<size_t>(x1 - x0) * static_cast<size_t>(y1 - y0));
+    });
+
+    file.write(reinterpret_cast<const char*>(band.data()), static_cast<std::streamsize>(stride * static_cast<size_t>(rows)));
+  }
+
+  exportProgress.finish();
+
+  if (!file)
+  {
+    spdlog::warn("unable to write pam file: {}", file_path);
+    return false;
+  }
+
+  return true;
+}
+
+ctask<bool> LazyImage::WritePamAsync(std::string file_path)
+{
+  co_await cpoolregistry::shared().schedule(cjobpriority::BACKGROUND);
+
+  co_return WritePam(file_path);
+}
+
+bool LazyImage::IsViewPending() const
+{
+  return pendingTask.valid() || pendingView;
+}
+
+bool LazyImage::IsEmpty() const
+{
+  return (imageWidth == 0) || (imageHeight == 0) || !evaluateRegion;
+}
+
+bool LazyImage::IsVirtual() const
+{
+  return isVirtual;
+}
+
+int32_t LazyImage::GetWidth() const
+{
+  return imageWidth;
+}
+
+int32_t LazyImage::GetHeight() const
+{
+  return imageHeight;
+}
+
+int32_t LazyImage::GetLevelWidth(uint32_t level) const
+{
+  return level_size(imageWidth, level);
+}
+
+int32_t LazyImage::GetLevelHeight(uint32_t level) const
+{
+  return level_size(imageHeight, level);
+}
+
+uint32_t LazyImage::GetMaxLevel() const
+{
+  return maxLevel;
+}
+
+void LazyImage::SetCacheBudget(size_t max_bytes)
+{
+  cacheBudget = max_bytes;
+  TrimCache();
+}
+
+size_t LazyImage::GetCachedBytes() const
+{
+  return cachedBytes;
+}
+
+size_t LazyImage::GetCachedTiles() const
+{
+  return tiles.size();
+}
+
+const cprogress & LazyImage::GetExportProgress() const
+{
+  return exportProgress;
+}
+
+uint64_t LazyImage::TileKey(uint32_t level, int32_t tile_x, int32_t tile_y)
+{
+  // 8 bits of level and 28 bits per tile coordinate (more tiles than a 2^36 pixel wide image has)
+  return (static_cast<uint64_t>(level) << 56) | (static_cast<uint64_t>(tile_y) << 28) | static_cast<uint64_t>(tile_x);
+}
+
+LazyImage::Region LazyImage::TileRegion(uint32_t level, int32_t tile_x, int32_t tile_y) const
+{
+  Region region;
+  region.level = level;
+  region.levelWidth = GetLevelWidth(level);
+  region.levelHeight = GetLevelHeight(level);
+  region.x = tile_x * tile_size;
+  region.y = tile_y * tile_size;
+  region.width = std::min(tile_size, region.levelWidth - region.x);
+  region.height = std::min(tile_size, region.levelHeight - region.y);
+
+  return region;
+}
+
+void LazyImage::TrimCache()
+{
+  // the least recently used tiles go first, the view just rendered is at the front so it's the last to go
+
+  while ((cachedBytes > cacheBudget) && !tiles.empty())
+  {
+    cachedBytes -= tiles.back().pixels.size();
+    tileLookup.erase(tiles.back().key);
+    tiles.pop_back();
+  }
+}
+
+bool LazyImage::FinishPendingView()
+{
+  // the tiles of a finished evaluation go in the cache even if the view has moved on since (it's likely to come back).
+  // true when tiles went in
+
+  if (!pendingTask.valid() || (pendingTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+  {
+    return false;
+  }
+
+  pendingTask.get();
+
+  for (auto & tile : pendingView->tiles)
+  {
+    cachedBytes += tile.pixels.size();
+    tiles.emplace_front(std::move(tile));
+    tileLookup[tiles.front().key] = tiles.begin();
+  }
+
+  pendingView.reset();
+
+  return true;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include "common/cprogress.h"
+#include "common/ctask.h"
+
+// an output too big to keep in memory (ex. a 5 level upsample of a 4k image is 128k x 64k pixels). the op hands over a
+// function that fills any rectangle of the output and nothing is evaluated until a view or an export asks for it. level
+// l of the image is the output shrunk by 2^l (what a zoomed out view shows) so a view only ever costs its own pixels.
+// the tiles a view evaluates are kept in an lru cache bounded by bytes, a virtual image (ex. nearest upsample, which is
+// only a lookup into the source) is evaluated straight into the view and never stored. the tiles of the other images
+// are evaluated on the shared pool without the caller waiting for them (see RenderView) so a frame never stalls on a
+// slow tile
+
+class LazyImage
+{
+  public:
+    struct Region
+    {
+      uint32_t level = 0;
+      int32_t levelWidth = 0;
+      int32_t levelHeight = 0;
+      int32_t x = 0;
+      int32_t y = 0;
+      int32_t width = 0;
+      int32_t height = 0;
+    };
+
+    // fills the region (rows of region.width * bpp bytes, stride bytes apart). it's called from the pool threads for
+    // different regions at the same time
+    using RegionFunction = std::function<void(const Region & region, uint8_t * pixels, size_t stride)>;
+
+    static constexpr int32_t tile_size = 256;
+    static constexpr size_t default_cache_bytes = static_cast<size_t>(256) << 20;
+
+    LazyImage() = default;
+    ~LazyImage() = default;
+
+    void Reset(int32_t width
+              ,int32_t height
+              ,uint8_t bpp
+              ,uint32_t max_level
+              ,bool is_virtual
+              ,RegionFunction evaluate);
+    void Clear();
+
+    // the view_width x view_height rectangle at (view_x, view_y) of the level, outside the image is left transparent.
+    // a tile that's still being evaluated on the pool is drawn from a coarser level that has it cached (or left
+    // transparent), ask again (ex. next frame) as long as IsViewPending() to get the view with the tiles that landed.
+    // false (and view_pixels left alone) when the view is the same as last time and no tile has landed since
+    bool RenderView(uint32_t level
+                   ,int32_t view_x
+                   ,int32_t view_y
+                   ,int32_t view_width
+                   ,int32_t view_height
+                   ,std::vector<uint8_t> & view_pixels);
+
+    // the full resolution image as a pam file, evaluated and written a band of rows at a time (the cache is left alone)
+    bool WritePam(const std::string & file_path);
+
+    // WritePam as a BACKGROUND coroutine on the shared pool (co_await it or start it with to_future). the image must
+    // not be reset until it's done
+    ctask<bool> WritePamAsync(std::string file_path);
+
+    [[nodiscard]] bool IsViewPending() const;
+    [[nodiscard]] bool IsEmpty() const;
+    [[nodiscard]] bool IsVirtual() const;
+    [[nodiscard]] int32_t GetWidth() const;
+    [[nodiscard]] int32_t GetHeight() const;
+    [[nodiscard]] int32_t GetLevelWidth(uint32_t level) const;
+    [[nodiscard]] int32_t GetLevelHeight(uint32_t level) const;
+    [[nodiscard]] uint32_t GetMaxLevel() const;
+
+    void SetCacheBudget(size_t max_bytes);
+    [[nodiscard]] size_t GetCachedBytes() const;
+    [[nodiscard]] size_t GetCachedTiles() const;
+    [[nodiscard]] const cprogress & GetExportProgress() const;
+
+  private:
+    struct Tile
+    {
+      uint64_t key = 0;
+      int32_t width = 0;
+      int32_t height = 0;
+      std::vector<uint8_t> pixels;
+    };
+
+    // the missing tiles of a view being evaluated on the pool. the task holds on to it and to its own copy of the
+    // region function so the image can be reset without waiting for the task
+    struct PendingView
+    {
+      std::vector<Region> regions;
+      std::vector<Tile> tiles;
+    };
+
+    static uint64_t TileKey(uint32_t level, int32_t tile_x, int32_t tile_y);
+    Region TileRegion(uint32_t level, int32_t tile_x, int32_t tile_y) const;
+    void TrimCache();
+    [[nodiscard]] bool FinishPendingView();
+
+    int32_t imageWidth = 0;
+    int32_t imageHeight = 0;
+    uint8_t imageBpp = 4;
+    uint32_t maxLevel = 0;
+    bool isVirtual = false;
+    RegionFunction evaluateRegion;
+
+    // most recently used tile first
+    std::list<Tile> tiles;
+    std::unordered_map<uint64_t, std::list<Tile>::iterator> tileLookup;
+    size_t cachedBytes = 0;
+    size_t cacheBudget = default_cache_bytes;
+
+    std::shared_ptr<PendingView> pendingView;
+    std::future<void> pendingTask;
+    // the view RenderView handed back last (width 0 when there's none)
+    Region renderedView;
+
+    cprogress exportProgress;
+};
@@ -0,0 +1,167 @@
+#include "NetpbmCodec.h"
+
+#include <fstream>
+#include <cctype>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace {
+  bool ReadHeaderValue(std::ifstream & file, uint32_t & value)
+  {
+    // header values are separated by whitespace and comments run from '#' to the end of the line
+
+    int32_t c = file.peek();
+    while ((c != EOF) && ((std::isspace(c) != 0) || (c == '#')))
+    {
+      if (c == '#')
+      {
+        std::string comment;
+        std::getline(file, comment);
+      }
+      else
+      {
+        file.get();
+      }
+      c = file.peek();
+    }
+
+    return static_cast<bool>(file >> value);
+  }
+}
+
+bool NetpbmCodec::Read(const std::string & file_path
+                      ,std::vector<uint16_t> & image_data
+                      ,uint32_t & width
+                      ,uint32_t & height
+                      ,uint8_t & channels
+                      ,uint16_t & max_value)
+{
+  std::ifstream file(file_path, std::ifstream::binary);
+
+  if (!file.is_open())
+  {
+    spdlog::warn("unable to open netpbm file: {}", file_path);
+    return false;
+  }
+
+  std::string magic(2, '\0');
+  file.read(magic.data(), 2);
+
+  if ((magic != "P5") && (magic != "P6"))
+  {
+    spdlog::warn("only binary netpbm (P5/P6) files are supported: {}", file_path);
+    return false;
+  }
+
+  uint32_t max_sample = 0;
+  if (!ReadHeaderValue(file, width) || !ReadHeaderValue(file, height) || !ReadHeaderValue(file, max_sample))
+  {
+    spdlog::warn("invalid netpbm header: {}", file_path);
+    return false;
+  }
+
+  if ((width == 0) || (height == 0) || (max_sample == 0) || (max_sample > 65535))
+  {
+    spdlog::warn("invalid netpbm size or max value: {}", file_path);
+    return false;
+  }
+
+  // a single whitespace byte separates the header from the samples
+
+  file.get();
+
+  channels = (magic == "P5") ? 1 : 3;
+  max_value = static_cast<uint16_t>(max_sample);
+
+  const size_t number_of_samples = static_cast<size_t>(width) * static_cast<size_t>(height) * channels;
+  const size_t bytes_per_sample = (max_sample > 255) ? 2 : 1;
+
+  std::vector<uint8_t> raw_data(number_of_samples * bytes_per_sample);
+  file.read(reinterpret_cast<char*>(raw_data.data()), static_cast<std::streamsize>(raw_data.size()));
+
+  if (static_cast<size_t>(file.gcount()) != raw_data.size())
+  {
+    spdlog::warn("netpbm file is missing pixel data: {}", file_path);
+    return false;
+  }
+
+  // 16-bit samples are stored big endian
+
+  image_data.resize(number_of_samples);
+
+  for (size_t i=0; i<number_of_samples; i++)
+  {
+    image_data[i] = (bytes_per_sample == 2) ? static_cast<uint16_t>((raw_data[i * 2] << 8) | raw_data[(i * 2) + 1])
+                                            : raw_data[i];
+  }
+
+  return true;
+}
+
+bool NetpbmCodec::Write(const std::string & file_path
+                       ,const std::vector<uint16_t> & image_data
+                       ,uint32_t width
+                       ,uint32_t height
+                       ,uint8_t channels
+                       ,uint16_t max_value)
+{
+  // gray images are written as P5, anything else as P6 (alpha is dropped)
+
+  const size_t number_of_pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+  const uint8_t output_channels = (channels == 1) ? 1 : 3;
+
+  if ((channels == 0) || (max_value == 0) || (image_data.size() < (number_of_pixels * channels)))
+  {
+    spdlog::warn("netpbm image data is smaller than its size!");
+    return false;
+  }
+
+  std::ofstream file(file_path, std::ofstream::binary);
+
+  if (!file.is_open())
+  {
+    spdlog::warn("unable to create netpbm file: {}", file_path);
+    return false;
+  }
+
+  file << ((output_channels == 1) ? "P5" : "P6") << "\n" << width << " " << height << "\n" << max_value << "\n";
+
+  const size_t bytes_per_sample = (max_value > 255) ? 2 : 1;
+  std::vector<uint8_t> raw_data;
+  raw_data.reserve(number_of_pixels * output_channels * bytes_per_sample);
+
+  for (size_t i=0; i<number_of_pixels; i++)
+  {
+    for (size_t k=0; k<output_channels; k++)
+    {
+      const uint16_t sample = image_data[(i * channels) + std::min<size_t>(k, channels - 1)];
+
+      if (bytes_per_sample == 2)
+      {
+        raw_data.emplace_back(static_cast<uint8_t>(sample >> 8));
+      }
+      raw_data.emplace_back(static_cast<uint8_t>(sample & 0xFF));
+    }
+  }
+
+  file.write(reinterpret_cast<const char*>(raw_data.data()), static_cast<std::streamsize>(raw_data.size()));
+
+  return static_cast<bool>(file);
+}
+
+std::string NetpbmCodec::PamHeader(uint32_t width
+                                  ,uint32_t height
+                                  ,uint8_t channels
+                                  ,uint16_t max_value)
+{
+  constexpr const char * tuple_types[] = {"GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA"};
+
+  const uint8_t depth = std::clamp<uint8_t>(channels, 1, 4);
+
+  return "P7\nWIDTH " + std::to_string(width)
+       + "\nHEIGHT " + std::to_string(height)
+       + "\nDEPTH " + std::to_string(depth)
+       + "\nMAXVAL " + std::to_string(max_value)
+       + "\nTUPLTYPE " + tuple_types[depth - 1]
+       + "\nENDHDR\n";
+}
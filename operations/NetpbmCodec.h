@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <vector>
+
+// binary netpbm images (P5 gray / P6 rgb) up to 16 bits per channel. samples are kept at full precision so high
+// bit depth images (ex. 12/16-bit microscopy captures) can be processed without converting them down to 8-bit
+
+class NetpbmCodec
+{
+  public:
+    NetpbmCodec() = default;
+
+    static bool Read(const std::string & file_path
+                    ,std::vector<uint16_t> & image_data
+                    ,uint32_t & width
+                    ,uint32_t & height
+                    ,uint8_t & channels
+                    ,uint16_t & max_value);
+
+    static bool Write(const std::string & file_path
+                     ,const std::vector<uint16_t> & image_data
+                     ,uint32_t width
+                     ,uint32_t height
+                     ,uint8_t channels
+                     ,uint16_t max_value);
+
+    // header of a P7 (pam) image, for writers that stream the samples after it instead of holding the whole image.
+    // samples are 1 byte up to a max value of 255 and 2 bytes (big endian) above, like P5/P6
+    static std::string PamHeader(uint32_t width
+                                ,uint32_t height
+                                ,uint8_t channels
+                                ,uint16_t max_value);
+};
@@ -0,0 +1,477 @@
+#include "ResampleOp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <numbers>
+#include <spdlog/spdlog.h>
+#include "AsyncOp.h"
+#include "common/cparallel.h"
+#include "common/cpoolregistry.h"
+#include "common/csimd.h"
+
+namespace
+{
+  // weights are 2.14 fixed point. the horizontal pass keeps 6 fraction bits in its int16 output, enough headroom for
+  // the overshoot of the bicubic/lanczos lobes (roughly -80 to 335) without losing precision between the passes
+  constexpr int32_t weight_bits = 14;
+  constexpr int32_t intermediate_bits = 6;
+  constexpr int32_t horizontal_shift = weight_bits - intermediate_bits;
+  constexpr int32_t vertical_shift = weight_bits + intermediate_bits;
+
+  struct filter_taps
+  {
+    // first source index of every output, taps weights per output (padded to an even count with zeros so the simd
+    // loops can take them in pairs)
+    std::vector<int32_t> first;
+    std::vector<int16_t> weights;
+    size_t taps = 0;
+  };
+
+  double filter_radius(MenuOp_Resample filter)
+  {
+    switch (filter)
+    {
+      case MenuOp_Resample::BILINEAR:
+        return 1.0;
+
+      case MenuOp_Resample::BICUBIC:
+        return 2.0;
+
+      case MenuOp_Resample::LANCZOS3:
+        return 3.0;
+    }
+
+    return 1.0;
+  }
+
+  double filter_weight(MenuOp_Resample filter, double x)
+  {
+    x = std::abs(x);
+
+    switch (filter)
+    {
+      case MenuOp_Resample::BILINEAR:
+        return std::max(0.0, 1.0 - x);
+
+      case MenuOp_Resample::BICUBIC:
+      {
+        // keys cubic with a = -0.5
+        constexpr double a = -0.5;
+
+        if (x < 1.0)
+        {
+          return ((a + 2.0) * x * x * x) - ((a + 3.0) * x * x) + 1.0;
+        }
+
+        if (x < 2.0)
+        {
+          return (a * x * x * x) - (5.0 * a * x * x) + (8.0 * a * x) - (4.0 * a);
+        }
+
+        return 0.0;
+      }
+
+      case MenuOp_Resample::LANCZOS3:
+      {
+        constexpr double lobes = 3.0;
+
+        if (x < 1e-8)
+        {
+          return 1.0;
+        }
+
+        if (x >= lobes)
+        {
+          return 0.0;
+        }
+
+        const double pi_x = std::numbers::pi * x;
+        return (lobes * std::sin(pi_x) * std::sin(pi_x / lobes)) / (pi_x * pi_x);
+      }
+    }
+
+    return 0.0;
+  }
+
+  filter_taps make_taps(MenuOp_Resample filter, uint32_t source_size, uint32_t target_size)
+  {
+    // output o is centered on source position (o + 0.5) / scale - 0.5. taps that fall off the image are dropped and
+    // the rest renormalized, so the kernels never need a bounds check
+
+    const double scale = static_cast<double>(target_size) / static_cast<double>(source_size);
+    const double stretch = std::max(1.0, 1.0 / scale);
+    const double support = filter_radius(filter) * stretch;
+
+    filter_taps table;
+    table.taps = std::min(static_cast<size_t>(std::ceil(support)) * 2 + 1, static_cast<size_t>(source_size));
+    table.taps += (table.taps % 2);
+    table.first.resize(target_size);
+    table.weights.assign(static_cast<size_t>(target_size) * table.taps, 0);
+
+    std::vector<double> weights(table.taps);
+
+    for (uint32_t o=0; o<target_size; o++)
+    {
+      const double center = ((static_cast<double>(o) + 0.5) / scale) - 0.5;
+      const auto left = static_cast<int32_t>(std::max(0.0, std::ceil(center - support)));
+      const auto right = static_cast<int32_t>(std::min(static_cast<double>(source_size - 1), std::floor(center + support)));
+      const int32_t first = std::clamp(left, 0, std::max(0, static_cast<int32_t>(source_size) - static_cast<int32_t>(table.taps)));
+
+      double total = 0.0;
+      for (size_t k=0; k<table.taps; k++)
+      {
+        const int32_t i = first + static_cast<int32_t>(k);
+        weights[k] = ((i >= left) && (i <= right) && (i < static_cast<int32_t>(source_size))) ? filter_weight(filter, (static_cast<double>(i) - center) / stretch) : 0.0;
+        total += weights[k];
+      }
+
+      // quantize and put the rounding error on the biggest weight so every row of weights adds up to exactly 1.0
+
+      int16_t * output_weights = table.weights.data() + (static_cast<size_t>(o) * table.taps);
+      int32_t quantized_total = 0;
+      size_t biggest = 0;
+
+      for (size_t k=0; k<table.taps; k++)
+      {
+        const double weight = (total != 0.0) ? (weights[k] / total) : ((k == 0) ? 1.0 : 0.0);
+        output_weights[k] = static_cast<int16_t>(std::lround(weight * (1 << weight_bits)));
+        quantized_total += output_weights[k];
+        biggest = (output_weights[k] > output_weights[biggest]) ? k : biggest;
+      }
+
+      output_weights[biggest] = static_cast<int16_t>(output_weights[biggest] + ((1 << weight_bits) - quantized_total));
+      table.first[o] = first;
+    }
+
+    return table;
+  }
+
+  int16_t clamp_int16(int32_t value)
+  {
+    return static_cast<int16_t>(std::clamp(value, -32768, 32767));
+  }
+
+  void resample_row(const uint8_t * source_row, int16_t * output_row, const filter_taps & columns, uint32_t x_begin, uint32_t x_end, uint8_t bpp)
+  {
+    // output columns [x_begin, x_end) go to the start of output_row
+
+#ifdef CSIMD_SSE2
+    if (bpp == 4)
+    {
+      // 2 taps per madd: the channels of the 2 pixels interleaved against (w0, w1) pairs give 4 int32 sums
+
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i rounding = _mm_set1_epi32(1 << (horizontal_shift - 1));
+
+      for (uint32_t x=x_begin; x<x_end; x++)
+      {
+        const uint8_t * pixels = source_row + (static_cast<size_t>(columns.first[x]) * 4);
+        const int16_t * weights = columns.weights.data() + (static_cast<size_t>(x) * columns.taps);
+        __m128i sum = _mm_setzero_si128();
+
+        for (size_t k=0; k<columns.taps; k+=2)
+        {
+          int32_t pixel_0 = 0;
+          int32_t pixel_1 = 0;
+          int32_t weight_pair = 0;
+          std::memcpy(&pixel_0, pixels + (k * 4), 4);
+          std::memcpy(&weight_pair, weights + k, 4);
+
+          // the padding tap can be one past the last pixel, its weight is 0 so it's left at 0
+          if (weights[k + 1] != 0)
+          {
+            std::memcpy(&pixel_1, pixels + ((k + 1) * 4), 4);
+          }
+
+          const __m128i channels_0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel_0), zero);
+          const __m128i channels_1 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel_1), zero);
+          sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(channels_0, channels_1), _mm_set1_epi32(weight_pair)));
+        }
+
+        const __m128i value = _mm_srai_epi32(_mm_add_epi32(sum, rounding), horizontal_shift);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(output_row + (static_cast<size_t>(x - x_begin) * 4)), _mm_packs_epi32(value, value));
+      }
+
+      return;
+    }
+#endif
+
+    for (uint32_t x=x_begin; x<x_end; x++)
+    {
+      const uint8_t * pixels = source_row + (static_cast<size_t>(columns.first[x]) * bpp);
+      const int16_t * weights = columns.weights.data() + (static_cast<size_t>(x) * columns.taps);
+
+      for (size_t c=0; c<bpp; c++)
+      {
+        int32_t sum = 0;
+        for (size_t k=0; k<columns.taps; k++)
+        {
+          sum += (weights[k] != 0) ? (weights[k] * static_cast<int32_t>(pixels[(k * bpp) + c])) : 0;
+        }
+
+        output_row[(static_cast<size_t>(x - x_begin) * bpp) + c] = clamp_int16((sum + (1 << (horizontal_shift - 1))) >> horizontal_shift);
+      }
+    }
+  }
+
+  void resample_column(const std::vector<int16_t> & intermediate, uint8_t * output_row, const int16_t * weights, int32_t first, size_t taps, size_t row_size)
+  {
+    // every tap is a whole intermediate row, a block of 8 values keeps its sums in registers over all the taps
+
+    const int16_t * rows = intermediate.data() + (static_cast<size_t>(first) * row_size);
+    size_t i = 0;
+
+#ifdef CSIMD_SSE2
+    const __m128i rounding = _mm_set1_epi32(1 << (vertical_shift - 1));
+
+    for (; (i + 8)<=row_size; i+=8)
+    {
+      __m128i sum_low = _mm_setzero_si128();
+      __m128i sum_high = _mm_setzero_si128();
+
+      for (size_t k=0; k<taps; k+=2)
+      {
+        int32_t weight_pair = 0;
+        std::memcpy(&weight_pair, weights + k, 4);
+        const __m128i weight_pairs = _mm_set1_epi32(weight_pair);
+
+        const __m128i row_0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + (k * row_size) + i));
+        const __m128i row_1 = (weights[k + 1] != 0) ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + ((k + 1) * row_size) + i)) : _mm_setzero_si128();
+
+        sum_low = _mm_add_epi32(sum_low, _mm_madd_epi16(_mm_unpacklo_epi16(row_0, row_1), weight_pairs));
+        sum_high = _mm_add_epi32(sum_high, _mm_madd_epi16(_mm_unpackhi_epi16(row_0, row_1), weight_pairs));
+      }
+
+      const __m128i value_low = _mm_srai_epi32(_mm_add_epi32(sum_low, rounding), vertical_shift);
+      const __m128i value_high = _mm_srai_epi32(_mm_add_epi32(sum_high, rounding), vertical_shift);
+      const __m128i value_16 = _mm_packs_epi32(value_low, value_high);
+
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(output_row + i), _mm_packus_epi16(value_16, value_16));
+    }
+#endif
+
+    for (; i<row_size; i++)
+    {
+      int32_t sum = 0;
+      for (size_t k=0; k<taps; k++)
+      {
+        sum += (weights[k] != 0) ? (weights[k] * static_cast<int32_t>(rows[(k * row_size) + i])) : 0;
+      }
+
+      output_row[i] = static_cast<uint8_t>(std::clamp((sum + (1 << (vertical_shift - 1))) >> vertical_shift, 0, 255));
+    }
+  }
+
+  // what the region function of a lazy output reads, shared with it so the op can start another one meanwhile. level
+  // l is the source resampled to the level's size, one table of taps per level
+  struct lazy_source
+  {
+    cimageview image;
+    std::vector<filter_taps> columns;
+    std::vector<filter_taps> rows;
+  };
+
+  void resample_region(const lazy_source & source, const LazyImage::Region & region, uint8_t * pixels, size_t stride)
+  {
+    // both passes restricted to the region: the horizontal one over the source rows its taps read, only for the
+    // region's columns
+
+    const filter_taps & columns = source.columns[region.level];
+    const filter_taps & rows = source.rows[region.level];
+
+    const size_t row_size = static_cast<size_t>(region.width) * source.image.channels();
+
+    const int32_t first_row = rows.first[region.y];
+    const int32_t last_row = std::min(static_cast<int32_t>(source.image.height()), rows.first[region.y + region.height - 1] + static_cast<int32_t>(rows.taps));
+
+    std::vector<int16_t> intermediate(static_cast<size_t>(last_row - first_row) * row_size, 0);
+
+    for (int32_t y=first_row; y<last_row; y++)
+    {
+      resample_row(source.image.row(static_cast<uint32_t>(y))
+                  ,intermediate.data() + (static_cast<size_t>(y - first_row) * row_size)
+                  ,columns
+                  ,static_cast<uint32_t>(region.x)
+                  ,static_cast<uint32_t>(region.x + region.width)
+                  ,source.image.channels());
+    }
+
+    for (int32_t y=0; y<region.height; y++)
+    {
+      const auto row = static_cast<size_t>(region.y + y);
+
+      resample_column(intermediate
+                     ,pixels + (static_cast<size_t>(y) * stride)
+                     ,rows.weights.data() + (row * rows.taps)
+                     ,rows.first[row] - first_row
+                     ,rows.taps
+                     ,row_size);
+    }
+  }
+}
+
+std::vector<uint8_t> ResampleOp::ProcessImage(MenuOp_Resample filter
+                                             ,const cimageview & source_image
+                                             ,uint32_t target_width
+                                             ,uint32_t target_height)
+{
+  const uint32_t width = source_image.width();
+  const uint32_t height = source_image.height();
+  const uint8_t bpp = source_image.channels();
+
+  if (source_image.empty() || (target_width == 0) || (target_height == 0))
+  {
+    spdlog::warn("unable to resample a {}x{} image to {}x{}", width, height, target_width, target_height);
+
+    outWidth = 0;
+    outHeight = 0;
+    result.clear();
+
+    return result;
+  }
+
+  lazyImage.Clear();
+
+  outWidth = static_cast<int32_t>(target_width);
+  outHeight = static_cast<int32_t>(target_height);
+  result.assign(static_cast<size_t>(target_width) * target_height * bpp, 0);
+
+  switch (filter)
+  {
+    case MenuOp_Resample::BILINEAR:
+      spdlog::info("perform bilinear resample operation");
+      break;
+
+    case MenuOp_Resample::BICUBIC:
+      spdlog::info("perform bicubic resample operation");
+      break;
+
+    case MenuOp_Resample::LANCZOS3:
+      spdlog::info("perform lanczos-3 resample operation");
+      break;
+  }
+
+  const filter_taps columns = make_taps(filter, width, target_width);
+  const filter_taps rows = make_taps(filter, height, target_height);
+
+  const size_t row_size = static_cast<size_t>(target_width) * bpp;
+
+  // progress counts output pixels of both passes
+  progress.begin((static_cast<size_t>(height) + target_height) * target_width);
+
+  // horizontal pass over the source rows the vertical pass reads (all of them unless the image is only cropped)
+
+  const int32_t first_row = rows.first.front();
+  const int32_t last_row = std::min(static_cast<int32_t>(height), rows.first.back() + static_cast<int32_t>(rows.taps));
+  progress.advance((static_cast<size_t>(height) - static_cast<size_t>(last_row - first_row)) * target_width);
+
+  std::vector<int16_t> intermediate(static_cast<size_t>(height) * row_size, 0);
+
+  parallel_for(cpoolregistry::shared(), first_row, last_row, [&](int32_t y) {
+    resample_row(source_image.row(static_cast<uint32_t>(y)), intermediate.data() + (static_cast<size_t>(y) * row_size), columns, 0, target_width, bpp);
+    progress.advance(target_width);
+  });
+
+  // vertical pass straight into the output
+
+  parallel_for(cpoolregistry::shared(), 0, static_cast<int32_t>(target_height), [&](int32_t y) {
+    resample_column(intermediate
+                   ,result.data() + (static_cast<size_t>(y) * row_size)
+                   ,rows.weights.data() + (static_cast<size_t>(y) * rows.taps)
+                   ,rows.first[y]
+                   ,rows.taps
+                   ,row_size);
+    progress.advance(target_width);
+  });
+
+  progress.finish();
+
+  return result;
+}
+
+ctask<std::vector<uint8_t>> ResampleOp::ProcessImageAsync(MenuOp_Resample filter
+                                                         ,cimageview source_image
+                                                         ,uint32_t target_width
+                                                         ,uint32_t target_height)
+{
+  return AsyncOp::Run(this, &ResampleOp::ProcessImage, filter, std::move(source_image), target_width, target_height);
+}
+
+void ResampleOp::ProcessLazy(MenuOp_Resample filter
+                            ,const cimageview & source_image
+                            ,uint32_t target_width
+                            ,uint32_t target_height)
+{
+  // the materialized result of a previous ProcessImage is dropped, only the source is kept (shared if the view owns
+  // its pixels)
+
+  const uint32_t width = source_image.width();
+  const uint32_t height = source_image.height();
+
+  result.clear();
+  result.shrink_to_fit();
+
+  if (source_image.empty() || (target_width == 0) || (target_height == 0))
+  {
+    spdlog::warn("unable to resample a {}x{} image to {}x{}", width, height, target_width, target_height);
+
+    outWidth = 0;
+    outHeight = 0;
+    lazyImage.Clear();
+
+    return;
+  }
+
+  spdlog::info("lazy resample operation to {}x{}", target_width, target_height);
+
+  outWidth = static_cast<int32_t>(target_width);
+  outHeight = static_cast<int32_t>(target_height);
+
+  auto source = std::make_shared<lazy_source>();
+  source->image = source_image.owned();
+
+  // zooming out stops at the first level that is no bigger than the source
+
+  uint32_t max_level = 0;
+  while ((((target_width - 1) >> max_level) >= width) || (((target_height - 1) >> max_level) >= height))
+  {
+    max_level++;
+  }
+
+  lazyImage.Reset(outWidth, outHeight, source_image.channels(), max_level, false, [source](const LazyImage::Region & region, uint8_t * pixels, size_t stride) {
+    resample_region(*source, region, pixels, stride);
+  });
+
+  for (uint32_t level=0; level<=max_level; level++)
+  {
+    source->columns.emplace_back(make_taps(filter, width, static_cast<uint32_t>(lazyImage.GetLevelWidth(level))));
+    source->rows.emplace_back(make_taps(filter, height, static_cast<uint32_t>(lazyImage.GetLevelHeight(level))));
+  }
+}
+
+LazyImage & ResampleOp::GetLazyImage()
+{
+  return lazyImage;
+}
+
+const std::vector<uint8_t> & ResampleOp::GetImage() const
+{
+  return result;
+}
+
+int32_t ResampleOp::GetWidth() const
+{
+  return outWidth;
+}
+
+int32_t ResampleOp::GetHeight() const
+{
+  return outHeight;
+}
+
+const cprogress & ResampleOp::GetProgress() const
+{
+  return progress;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "MenuOps.h"
+#include "LazyImage.h"
+#include "common/cimageview.h"
+#include "common/cprogress.h"
+#include "common/ctask.h"
+
+// resize to any width x height with a separable filter (bilinear, bicubic or lanczos-3) in one horizontal and one
+// vertical pass. every output column (and row) gets its own table of source taps and fixed point weights up front,
+// for a ratio of p/q those repeat every p outputs (the phases of a polyphase filter). when shrinking the filter is
+// stretched by the ratio so it averages over every source pixel it covers instead of skipping some
+
+class ResampleOp
+{
+  public:
+    ResampleOp() = default;
+    ~ResampleOp() = default;
+
+    std::vector<uint8_t> ProcessImage(MenuOp_Resample filter
+                                     ,const cimageview & source_image
+                                     ,uint32_t target_width
+                                     ,uint32_t target_height);
+
+    // ProcessImage on the shared pool (see AsyncOp)
+    ctask<std::vector<uint8_t>> ProcessImageAsync(MenuOp_Resample filter
+                                                 ,cimageview source_image
+                                                 ,uint32_t target_width
+                                                 ,uint32_t target_height);
+
+    // the same output without computing it, GetLazyImage evaluates the tiles a view or export asks for (each tile
+    // runs both passes over just the source it covers)
+    void ProcessLazy(MenuOp_Resample filter
+                    ,const cimageview & source_image
+                    ,uint32_t target_width
+                    ,uint32_t target_height);
+
+    [[nodiscard]] LazyImage & GetLazyImage();
+    [[nodiscard]] const std::vector<uint8_t> & GetImage() const;
+
+    [[nodiscard]] int32_t GetWidth() const;
+    [[nodiscard]] int32_t GetHeight() const;
+    [[nodiscard]] const cprogress & GetProgress() const;
+
+  private:
+    int32_t outWidth = 0;
+    int32_t outHeight = 0;
+    std::vector<uint8_t> result;
+    LazyImage lazyImage;
+    cprogress progress;
+};
@@ -3,14 +3,42 @@
 #include <algorithm>
 #include <array>
 #include <spdlog/spdlog.h>
+#include "AsyncOp.h"
+#include "common/cparallel.h"
+#include "common/cpoolregistry.h"
+
+namespace {
+  // min/max of the color channels over the rows a filter ran on (merged across the pool threads)
+
+  struct ChannelRange
+  {
+    std::array<float, 3> minValue = {0.0f};
+    std::array<float, 3> maxValue = {0.0f};
+  };
+
+  void MergeChannelRange(ChannelRange & range, const ChannelRange & other)
+  {
+    for (size_t k=0; k<3; k++)
+    {
+      range.minValue[k] = std::min(range.minValue[k], other.minValue[k]);
+      range.maxValue[k] = std::max(range.maxValue[k], other.maxValue[k]);
+    }
+  }
+}
 
 std::vector<uint8_t> SpatialFilterOp::ProcessImage(MenuOp_SpatialFilter operation
-                                                  ,const std::vector<uint8_t> & source_image
-                                                  ,uint32_t width
-                                                  ,uint32_t height
-                                                  ,uint8_t bpp
+                                                  ,const cimageview & source_view
                                                   ,uint16_t iterations)
 {
+  // the kernels index the pixels as one packed buffer. a whole owning view is that buffer already, a borrowed one or
+  // a roi is packed once here
+
+  std::vector<uint8_t> storage;
+  const std::vector<uint8_t> & source_image = source_view.packed(storage);
+
+  const uint32_t width = source_view.width();
+  const uint32_t height = source_view.height();
+  const uint8_t bpp = source_view.channels();
 
   result = source_image;
 
@@ -69,10 +97,19 @@ std::vector<uint8_t> SpatialFilterOp::ProcessImage(MenuOp_SpatialFilter operatio
       break;
   }
 
+  progress.finish();
+
   return result;
 
 }
 
+ctask<std::vector<uint8_t>> SpatialFilterOp::ProcessImageAsync(MenuOp_SpatialFilter operation
+                                                              ,cimageview source_image
+                                                              ,uint16_t iterations)
+{
+  return AsyncOp::Run(this, &SpatialFilterOp::ProcessImage, operation, std::move(source_image), iterations);
+}
+
 const std::vector<uint8_t> & SpatialFilterOp::GetImage() const
 {
   return result;
@@ -88,6 +125,11 @@ int32_t SpatialFilterOp::GetHeight() const
   return outHeight;
 }
 
+const cprogress & SpatialFilterOp::GetProgress() const
+{
+  return progress;
+}
+
 void SpatialFilterOp::SetKernelSize(int32_t kernel_x, int32_t kernel_y)
 {
   kernelX = kernel_x;
@@ -367,7 +409,7 @@ float SpatialFilterOp::MedianValue(const std::vector<uint8_t> & source
   return median_value;
 }
 
-void SpatialFilterOp::SmoothingFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
+void SpatialFilterOp::SmoothingFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp, bool begin_progress)
 {
   spdlog::info("begin spatial filter: smoothing");
   outWidth = static_cast<int32_t>(width);
@@ -382,8 +424,12 @@ void SpatialFilterOp::SmoothingFilter(const std::vector<uint8_t> & source_image,
   }
   smooth_kernel_div = 1.0f / smooth_kernel_div;
 
-  for (size_t i=0; i<height; i++)
+  if (begin_progress)
   {
+    progress.begin(static_cast<size_t>(width) * height);
+  }
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       double filter_value_red = std::clamp(ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, smooth_kernel, kernelX, kernelY, smooth_kernel_div), 0.0, 255.0);
@@ -396,7 +442,9 @@ void SpatialFilterOp::SmoothingFilter(const std::vector<uint8_t> & source_image,
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(filter_value_blue);
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(filter_alpha_value);
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
 void SpatialFilterOp::MedianFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -407,8 +455,9 @@ void SpatialFilterOp::MedianFilter(const std::vector<uint8_t> & source_image, ui
 
   const float median_scale_factor = 1.0f;
 
-  for (size_t i=0; i<height; i++)
-  {
+  progress.begin(static_cast<size_t>(width) * height);
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       float filter_value_red = std::clamp(MedianValue(source_image, j, i, width, height, 0, 0, bpp, kernelX, kernelY, median_scale_factor), 0.0f, 255.0f);
@@ -421,7 +470,9 @@ void SpatialFilterOp::MedianFilter(const std::vector<uint8_t> & source_image, ui
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(filter_value_blue);
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(filter_alpha_value);
     }
-  }
+
+    progress.advance(width);
+  }, 0, cparallelschedule::DYNAMIC);
 }
 
 void SpatialFilterOp::SharpenFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -457,12 +508,13 @@ void SpatialFilterOp::SharpenFilter(const std::vector<uint8_t> & source_image, u
 
   constexpr float kernel_div = 1.0f;
 
-  std::array<float, 3> min_value = {0.0f};
-  std::array<float, 3> max_value = {0.0f};
   std::vector<float> sharp_mask (width * height * bpp, 0.0f);
 
-  for (size_t i=0; i<height; i++)
-  {
+  progress.begin(static_cast<size_t>(width) * height);
+
+  // the range of the filter is only tracked (per band of rows) so it can be scaled when the filter itself is shown
+
+  const ChannelRange sharp_range = parallel_reduce(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), ChannelRange(), [&](size_t i, ChannelRange & range) {
     for (size_t j=0; j<width; j++)
     {
       float filter_value_red = ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, laplacian_kernel, kernelX, kernelY, kernel_div) * sharpenConstant;
@@ -473,13 +525,13 @@ void SpatialFilterOp::SharpenFilter(const std::vector<uint8_t> & source_image, u
 
       if (showSharpenFilter)
       {
-        min_value[0] = std::min(min_value[0], filter_value_red);
-        min_value[1] = std::min(min_value[1], filter_value_green);
-        min_value[2] = std::min(min_value[2], filter_value_blue);
+        range.minValue[0] = std::min(range.minValue[0], filter_value_red);
+        range.minValue[1] = std::min(range.minValue[1], filter_value_green);
+        range.minValue[2] = std::min(range.minValue[2], filter_value_blue);
 
-        max_value[0] = std::max(max_value[0], filter_value_red);
-        max_value[1] = std::max(max_value[1], filter_value_green);
-        max_value[2] = std::max(max_value[2], filter_value_blue);
+        range.maxValue[0] = std::max(range.maxValue[0], filter_value_red);
+        range.maxValue[1] = std::max(range.maxValue[1], filter_value_green);
+        range.maxValue[2] = std::max(range.maxValue[2], filter_value_blue);
 
         if (!showSharpenFilterScaling)
         {
@@ -504,12 +556,16 @@ void SpatialFilterOp::SharpenFilter(const std::vector<uint8_t> & source_image, u
         result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(static_cast<float>(source_image[(j*bpp) + (i*width*bpp) + 3]) + filter_value_alpha, 0.0f, 255.0f));
       }
     }
-  }
+
+    progress.advance(width);
+  }, MergeChannelRange);
+
+  const std::array<float, 3> & min_value = sharp_range.minValue;
+  const std::array<float, 3> & max_value = sharp_range.maxValue;
 
   if (showSharpenFilterScaling && showSharpenFilter)
   {
-    for (size_t i=0; i<height; i++)
-    {
+    parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
       for (size_t j=0; j<width; j++)
       {
         float scale_value_red;
@@ -534,7 +590,7 @@ void SpatialFilterOp::SharpenFilter(const std::vector<uint8_t> & source_image, u
         result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(scale_value_blue, 0.0f, 255.0f));
         result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(255.0f);
       }
-    }
+    });
   }
 
 }
@@ -548,13 +604,15 @@ void SpatialFilterOp::HighBoostFilter(const std::vector<uint8_t> & source_image,
 
   std::vector<float> unsharp_mask (width * height * bpp);
 
-  SmoothingFilter(source_image, width, height, bpp);
+  // smoothing, mask and boost passes
+  progress.begin(static_cast<size_t>(width) * height * 3);
+
+  SmoothingFilter(source_image, width, height, bpp, false);
   std::vector<uint8_t> blur_image = result;
 
   float unsharp_filter_scaling = showUnSharpenFilterScaling ? 128.0f : 0.0f;
 
-  for (size_t i=0; i<height; i++)
-  {
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j = 0; j < width; j++)
     {
       unsharp_mask[((j * bpp) + (i * width * bpp)) + 0] = unsharpConstant * (static_cast<float>(source_image[((j * bpp) + (i * width * bpp)) + 0]) - static_cast<float>(blur_image[((j * bpp) + (i * width * bpp)) + 0]));
@@ -562,10 +620,11 @@ void SpatialFilterOp::HighBoostFilter(const std::vector<uint8_t> & source_image,
       unsharp_mask[((j * bpp) + (i * width * bpp)) + 2] = unsharpConstant * (static_cast<float>(source_image[((j * bpp) + (i * width * bpp)) + 2]) - static_cast<float>(blur_image[((j * bpp) + (i * width * bpp)) + 2]));
       unsharp_mask[((j * bpp) + (i * width * bpp)) + 3] = unsharpConstant * (static_cast<float>(source_image[((j * bpp) + (i * width * bpp)) + 3]) - static_cast<float>(blur_image[((j * bpp) + (i * width * bpp)) + 3]));
     }
-  }
 
-  for (size_t i=0; i<height; i++)
-  {
+    progress.advance(width);
+  });
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j = 0; j < width; j++)
     {
       if (!showUnSharpenFilter)
@@ -583,7 +642,9 @@ void SpatialFilterOp::HighBoostFilter(const std::vector<uint8_t> & source_image,
         result[((j * bpp) + (i * width * bpp)) + 3] = 255;
       }
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
 void SpatialFilterOp::ArithMeanFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -596,8 +657,9 @@ void SpatialFilterOp::ArithMeanFilter(const std::vector<uint8_t> & source_image,
   std::vector<float> kernel (kernelX * kernelY, 1.0f);
   float kernel_div = 1.0f;
 
-  for (size_t i=0; i<height; i++)
-  {
+  progress.begin(static_cast<size_t>(width) * height);
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       float filter_value_red = ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, kernel, kernelX, kernelY, kernel_div) / static_cast<float>(kernelX * kernelY);
@@ -610,7 +672,9 @@ void SpatialFilterOp::ArithMeanFilter(const std::vector<uint8_t> & source_image,
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0f, 255.0f));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0f, 255.0f));
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
 void SpatialFilterOp::GeoMeanFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -623,8 +687,9 @@ void SpatialFilterOp::GeoMeanFilter(const std::vector<uint8_t> & source_image, u
   std::vector<float> kernel (kernelX * kernelY, 1.0f);
   float kernel_div = 1.0f;
 
-  for (size_t i=0; i<height; i++)
-  {
+  progress.begin(static_cast<size_t>(width) * height);
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       double filter_value_red = ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, kernel, kernelX, kernelY, kernel_div, CONV_TYPE::MULT);
@@ -642,10 +707,12 @@ void SpatialFilterOp::GeoMeanFilter(const std::vector<uint8_t> & source_image, u
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0, 255.0));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0, 255.0));
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
-void SpatialFilterOp::MinFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
+void SpatialFilterOp::MinFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp, bool begin_progress)
 {
   spdlog::info("begin spatial filter: min");
 
@@ -655,8 +722,12 @@ void SpatialFilterOp::MinFilter(const std::vector<uint8_t> & source_image, uint3
   std::vector<float> kernel (kernelX * kernelY, 1.0f);
   float kernel_div = 1.0f;
 
-  for (size_t i=0; i<height; i++)
+  if (begin_progress)
   {
+    progress.begin(static_cast<size_t>(width) * height);
+  }
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       double filter_value_red = ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, kernel, kernelX, kernelY, kernel_div, CONV_TYPE::MIN);
@@ -669,10 +740,12 @@ void SpatialFilterOp::MinFilter(const std::vector<uint8_t> & source_image, uint3
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0, 255.0));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0, 255.0));
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
-void SpatialFilterOp::MaxFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
+void SpatialFilterOp::MaxFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp, bool begin_progress)
 {
   spdlog::info("begin spatial filter: max");
 
@@ -682,8 +755,12 @@ void SpatialFilterOp::MaxFilter(const std::vector<uint8_t> & source_image, uint3
   std::vector<float> kernel (kernelX * kernelY, 1.0f);
   float kernel_div = 1.0f;
 
-  for (size_t i=0; i<height; i++)
+  if (begin_progress)
   {
+    progress.begin(static_cast<size_t>(width) * height);
+  }
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       double filter_value_red = ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, kernel, kernelX, kernelY, kernel_div, CONV_TYPE::MAX);
@@ -696,7 +773,9 @@ void SpatialFilterOp::MaxFilter(const std::vector<uint8_t> & source_image, uint3
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0, 255.0));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0, 255.0));
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
 void SpatialFilterOp::MidPointFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -706,13 +785,15 @@ void SpatialFilterOp::MidPointFilter(const std::vector<uint8_t> & source_image,
   outWidth = static_cast<int32_t>(width);
   outHeight = static_cast<int32_t>(height);
 
-  MinFilter(source_image, width, height, bpp);
+  // min, max and midpoint passes
+  progress.begin(static_cast<size_t>(width) * height * 3);
+
+  MinFilter(source_image, width, height, bpp, false);
   auto min_filter = result;
-  MaxFilter(source_image, width, height, bpp);
+  MaxFilter(source_image, width, height, bpp, false);
   auto max_filter = result;
 
-  for (size_t i=0; i<height; i++)
-  {
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       double filter_value_red = (min_filter[(j*bpp) + (i*width*bpp) + 0] + max_filter[(j*bpp) + (i*width*bpp) + 0]) / 2.0;
@@ -725,7 +806,9 @@ void SpatialFilterOp::MidPointFilter(const std::vector<uint8_t> & source_image,
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0, 255.0));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0, 255.0));
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
 void SpatialFilterOp::HarmonicFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -738,8 +821,9 @@ void SpatialFilterOp::HarmonicFilter(const std::vector<uint8_t> & source_image,
   std::vector<float> kernel (kernelX * kernelY, 1.0f);
   float kernel_div = 1.0f;
 
-  for (size_t i=0; i<height; i++)
-  {
+  progress.begin(static_cast<size_t>(width) * height);
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       double filter_value_red = static_cast<double>(kernelX * kernelY) / ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, kernel, kernelX, kernelY, kernel_div, CONV_TYPE::FRAC);
@@ -752,7 +836,9 @@ void SpatialFilterOp::HarmonicFilter(const std::vector<uint8_t> & source_image,
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0, 255.0));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0, 255.0));
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
 void SpatialFilterOp::ContraHarmonicFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -765,8 +851,9 @@ void SpatialFilterOp::ContraHarmonicFilter(const std::vector<uint8_t> & source_i
   std::vector<float> kernel (kernelX * kernelY, 1.0f);
   float q_value = contraHarmonicConstant;
 
-  for (size_t i=0; i<height; i++)
-  {
+  progress.begin(static_cast<size_t>(width) * height);
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       double filter_value_red_0 = ConvolutionValue(source_image, j, i, width, height, 0, 0, bpp, kernel, kernelX, kernelY, q_value + 1.0, CONV_TYPE::POW);
@@ -789,7 +876,9 @@ void SpatialFilterOp::ContraHarmonicFilter(const std::vector<uint8_t> & source_i
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0, 255.0));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0, 255.0));
     }
-  }
+
+    progress.advance(width);
+  });
 }
 
 void SpatialFilterOp::AlphaTrimFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp)
@@ -804,8 +893,9 @@ void SpatialFilterOp::AlphaTrimFilter(const std::vector<uint8_t> & source_image,
 
   alphaTrimConstant = std::clamp(alphaTrimConstant, 0, (kernelX * kernelY) - 1);
 
-  for (size_t i=0; i<height; i++)
-  {
+  progress.begin(static_cast<size_t>(width) * height);
+
+  parallel_for(cpoolregistry::shared(), static_cast<size_t>(0), static_cast<size_t>(height), [&](size_t i) {
     for (size_t j=0; j<width; j++)
     {
       auto kernel_red = CollectValues(source_image, j, i, width, height, 0, 0, bpp, kernelX, kernelY, 1.0f);
@@ -860,5 +950,7 @@ void SpatialFilterOp::AlphaTrimFilter(const std::vector<uint8_t> & source_image,
       result[(j*bpp) + (i*width*bpp) + 2] = static_cast<uint8_t>(std::clamp(filter_value_blue, 0.0f, 255.0f));
       result[(j*bpp) + (i*width*bpp) + 3] = static_cast<uint8_t>(std::clamp(filter_value_alpha, 0.0f, 255.0f));
     }
-  }
+
+    progress.advance(width);
+  }, 0, cparallelschedule::DYNAMIC);
 }
@@ -2,6 +2,9 @@
 
 #include <vector>
 #include "MenuOps.h"
+#include "common/cimageview.h"
+#include "common/cprogress.h"
+#include "common/ctask.h"
 
 class SpatialFilterOp
 {
@@ -10,16 +13,19 @@ class SpatialFilterOp
     ~SpatialFilterOp() = default;
 
     std::vector<uint8_t> ProcessImage(MenuOp_SpatialFilter operation
-                                     ,const std::vector<uint8_t> & source_image
-                                     ,uint32_t width
-                                     ,uint32_t height
-                                     ,uint8_t bpp
+                                     ,const cimageview & source_image
                                      ,uint16_t iterations);
 
+    // ProcessImage on the shared pool (see AsyncOp)
+    ctask<std::vector<uint8_t>> ProcessImageAsync(MenuOp_SpatialFilter operation
+                                                 ,cimageview source_image
+                                                 ,uint16_t iterations);
+
     [[nodiscard]] const std::vector<uint8_t> & GetImage() const;
 
     [[nodiscard]] int32_t GetWidth() const;
     [[nodiscard]] int32_t GetHeight() const;
+    [[nodiscard]] const cprogress & GetProgress() const;
 
     void SetKernelSize(int32_t kernel_x, int32_t kernel_y);
     void SetSharpenConstant(float sharp_const);
@@ -75,20 +81,23 @@ class SpatialFilterOp
                             ,int32_t kernel_height
                             ,float median_scale_factor);
 
-    void SmoothingFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
+    // begin_progress is false when the filter is a step of another one (high-boost, midpoint) that began the
+    // progress with the work of all of its steps
+    void SmoothingFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp, bool begin_progress = true);
     void MedianFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
     void SharpenFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
     void HighBoostFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
     void ArithMeanFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
     void GeoMeanFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
-    void MinFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
-    void MaxFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
+    void MinFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp, bool begin_progress = true);
+    void MaxFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp, bool begin_progress = true);
     void MidPointFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
     void HarmonicFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
     void ContraHarmonicFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
     void AlphaTrimFilter(const std::vector<uint8_t> & source_image, uint32_t width, uint32_t height, int32_t bpp);
 
     std::vector<uint8_t> result;
+    cprogress progress;
     int32_t outWidth = 0;
     int32_t outHeight = 0;
     int32_t kernelX = 3;
@@ -1,107 +1,292 @@
 #include "UpsampleOp.h"
 
-#include <array>
 #include <algorithm>
-#include <limits>
+#include <cstring>
+#include <memory>
 #include <spdlog/spdlog.h>
+#include "AsyncOp.h"
+#include "common/cparallel.h"
+#include "common/cpoolregistry.h"
+#include "common/csimd.h"
 
 namespace
 {
-  std::array<uint8_t, 4> pixel_gather(const int32_t & x
-                                     ,const int32_t & y
-                                     ,const int32_t & w
-                                     ,const int32_t & h
-                                     ,const int32_t & number_of_pixel_neighbors
-                                     ,const int32_t & bpp
-                                     ,const std::vector<uint8_t> & source_image)
+  // lerp weights are 1.7 fixed point. for a 2^n upsample the output centers fall on multiples of 1 / 2^(n+1) between
+  // two source pixels, so up to n = 6 the weights are exact. a row lerp fits in int16 (255 * 128) which lets the simd
+  // path use madd for both directions
+  constexpr int32_t lerp_bits = 7;
+  constexpr int32_t lerp_one = 1 << lerp_bits;
+
+  struct lerp_axis
+  {
+    // the 2 source pixels of every output and the weight of the second one
+    std::vector<int32_t> first;
+    std::vector<int32_t> second;
+    std::vector<int16_t> weight;
+  };
+
+  lerp_axis make_lerp_axis(uint32_t source_size, uint16_t levels, bool interpolate)
   {
-    int32_t pixel_value_red = 0;
-    int32_t pixel_value_green = 0;
-    int32_t pixel_value_blue = 0;
-    int32_t pixel_value_alpha = 0;
+    // output o is centered on source position (o + 0.5) / 2^levels - 0.5 = (2o + 1 - 2^levels) / 2^(levels+1). edge
+    // outputs past the first/last source center repeat the edge pixel. without interpolation every output takes the
+    // source pixel it lies in
+
+    const int64_t factor = static_cast<int64_t>(1) << levels;
+    const int64_t denominator = factor * 2;
+    const auto last = static_cast<int32_t>(source_size) - 1;
 
-    for (int32_t i=0; i<(number_of_pixel_neighbors + 1); i++)
+    lerp_axis axis;
+    axis.first.resize(static_cast<size_t>(source_size) << levels);
+    axis.second.resize(axis.first.size());
+    axis.weight.resize(axis.first.size());
+
+    for (size_t o=0; o<axis.first.size(); o++)
     {
-      const size_t pixel_byte_index_r = ((x + i) * bpp) + (y * w * bpp) + 3;
-      if ((pixel_byte_index_r > 0) && (pixel_byte_index_r < w))
+      if (!interpolate)
       {
-        pixel_value_red += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 0]);
-        pixel_value_green += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 1]);
-        pixel_value_blue += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 2]);
-        pixel_value_alpha += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 3]);
+        axis.first[o] = axis.second[o] = static_cast<int32_t>(o >> levels);
+        axis.weight[o] = 0;
+        continue;
       }
-      else
+
+      const int64_t numerator = (static_cast<int64_t>(o) * 2) + 1 - factor;
+      const int64_t whole = (numerator >= 0) ? (numerator / denominator) : -(((-numerator) + denominator - 1) / denominator);
+      const int64_t fraction = numerator - (whole * denominator);
+
+      axis.first[o] = std::clamp(static_cast<int32_t>(whole), 0, last);
+      axis.second[o] = std::clamp(static_cast<int32_t>(whole) + 1, 0, last);
+      axis.weight[o] = static_cast<int16_t>(((fraction * lerp_one) + (denominator / 2)) / denominator);
+    }
+
+    return axis;
+  }
+
+  void lerp_row(const uint8_t * top_row
+               ,const uint8_t * bottom_row
+               ,int16_t row_weight
+               ,const lerp_axis & columns
+               ,uint32_t x_begin
+               ,uint32_t x_end
+               ,uint8_t bpp
+               ,uint8_t * output_row)
+  {
+    // output columns [x_begin, x_end) go to the start of output_row
+    uint32_t x = x_begin;
+
+#ifdef CSIMD_SSE2
+    if (bpp == 4)
+    {
+      // per pixel: the 2 columns of the top and bottom rows are lerped with one madd each (channels of the left and
+      // right pixel interleaved against (1 - w, w) pairs) and the results lerped again between the rows
+
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i rounding = _mm_set1_epi32(1 << ((2 * lerp_bits) - 1));
+      const __m128i row_weights = _mm_set1_epi32((static_cast<int32_t>(row_weight) << 16) | (lerp_one - row_weight));
+
+      const auto load_pixel = [&zero](const uint8_t * pixel) -> __m128i {
+        int32_t value = 0;
+        std::memcpy(&value, pixel, 4);
+        return _mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero);
+      };
+
+      for (; x<x_end; x++)
+      {
+        const size_t left = static_cast<size_t>(columns.first[x]) * 4;
+        const size_t right = static_cast<size_t>(columns.second[x]) * 4;
+        const __m128i column_weights = _mm_set1_epi32((static_cast<int32_t>(columns.weight[x]) << 16) | (lerp_one - columns.weight[x]));
+
+        const __m128i top = _mm_madd_epi16(_mm_unpacklo_epi16(load_pixel(top_row + left), load_pixel(top_row + right)), column_weights);
+        const __m128i bottom = _mm_madd_epi16(_mm_unpacklo_epi16(load_pixel(bottom_row + left), load_pixel(bottom_row + right)), column_weights);
+
+        const __m128i top_16 = _mm_packs_epi32(top, top);
+        const __m128i bottom_16 = _mm_packs_epi32(bottom, bottom);
+        const __m128i value = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(top_16, bottom_16), row_weights), rounding), 2 * lerp_bits);
+        const __m128i value_16 = _mm_packs_epi32(value, value);
+
+        const auto pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(value_16, value_16)));
+        std::memcpy(output_row + (static_cast<size_t>(x - x_begin) * 4), &pixel, 4);
+      }
+    }
+#endif
+
+    for (; x<x_end; x++)
+    {
+      const size_t left = static_cast<size_t>(columns.first[x]) * bpp;
+      const size_t right = static_cast<size_t>(columns.second[x]) * bpp;
+      const int32_t column_weight = columns.weight[x];
+
+      for (size_t c=0; c<bpp; c++)
       {
-        const int32_t x_fix = std::clamp(x, 0, (w - 1));
-        const int32_t y_fix = std::clamp(y, 0, (h - 1));
+        const int32_t top = (top_row[left + c] * (lerp_one - column_weight)) + (top_row[right + c] * column_weight);
+        const int32_t bottom = (bottom_row[left + c] * (lerp_one - column_weight)) + (bottom_row[right + c] * column_weight);
+        const int32_t value = ((top * (lerp_one - row_weight)) + (bottom * row_weight) + (1 << ((2 * lerp_bits) - 1))) >> (2 * lerp_bits);
 
-        pixel_value_red += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 0]);
-        pixel_value_green += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 1]);
-        pixel_value_blue += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 2]);
-        pixel_value_alpha += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 3]);
+        output_row[(static_cast<size_t>(x - x_begin) * bpp) + c] = static_cast<uint8_t>(value);
       }
     }
+  }
 
-    pixel_value_red /= (number_of_pixel_neighbors + 1);
-    pixel_value_red = std::clamp(pixel_value_red, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+  void nearest_rows(const cimageview & source_image
+                   ,uint32_t shift
+                   ,uint32_t x_begin
+                   ,uint32_t x_end
+                   ,uint32_t y_begin
+                   ,uint32_t y_end
+                   ,uint8_t * output
+                   ,size_t output_stride)
+  {
+    // every output pixel (of a 2^shift upsample) is the source pixel it lies in, nothing is interpolated so a lazy
+    // output doesn't need to store anything
 
-    pixel_value_green /= (number_of_pixel_neighbors + 1);
-    pixel_value_green = std::clamp(pixel_value_green, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+    const uint8_t bpp = source_image.channels();
 
-    pixel_value_blue /= (number_of_pixel_neighbors + 1);
-    pixel_value_blue = std::clamp(pixel_value_blue, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+    for (uint32_t y=y_begin; y<y_end; y++)
+    {
+      const uint8_t * source_row = source_image.row(y >> shift);
+      uint8_t * output_row = output + (static_cast<size_t>(y - y_begin) * output_stride);
 
-    pixel_value_alpha /= (number_of_pixel_neighbors + 1);
-    pixel_value_alpha = std::clamp(pixel_value_alpha, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+      for (uint32_t x=x_begin; x<x_end; x++)
+      {
+        std::memcpy(output_row + (static_cast<size_t>(x - x_begin) * bpp), source_row + (static_cast<size_t>(x >> shift) * bpp), bpp);
+      }
+    }
+  }
+
+  // what the region function of a lazy output reads, shared with it so the op can start another one meanwhile.
+  // level l of a 2^n upsample is evaluated as a 2^(n-l) upsample of the source, one lerp table per level
+  struct lazy_source
+  {
+    cimageview image;
+    uint16_t iterations = 0;
+    std::vector<lerp_axis> columns;
+    std::vector<lerp_axis> rows;
+  };
 
-    return {static_cast<uint8_t>(pixel_value_red)
-           ,static_cast<uint8_t>(pixel_value_green)
-           ,static_cast<uint8_t>(pixel_value_blue)
-           ,static_cast<uint8_t>(pixel_value_alpha)};
+  void nearest_region(const lazy_source & source, const LazyImage::Region & region, uint8_t * pixels, size_t stride)
+  {
+    nearest_rows(source.image
+                ,source.iterations - region.level
+                ,static_cast<uint32_t>(region.x)
+                ,static_cast<uint32_t>(region.x + region.width)
+                ,static_cast<uint32_t>(region.y)
+                ,static_cast<uint32_t>(region.y + region.height)
+                ,pixels
+                ,stride);
   }
 
-  void set_pixel(const uint32_t & x
-                ,const uint32_t & y
-                ,const uint32_t & width
-                ,const uint32_t & bpp
-                ,std::vector<uint8_t> & image
-                ,const std::array<uint8_t, 4> & pixel_color_rgb)
+  void interpolate_region(const lazy_source & source, const LazyImage::Region & region, uint8_t * pixels, size_t stride)
   {
-    image[(x * bpp) + (y * width * bpp) + 0] = pixel_color_rgb[0];
-    image[(x * bpp) + (y * width * bpp) + 1] = pixel_color_rgb[1];
-    image[(x * bpp) + (y * width * bpp) + 2] = pixel_color_rgb[2];
-    image[(x * bpp) + (y * width * bpp) + 3] = pixel_color_rgb[3];
+    const lerp_axis & columns = source.columns[region.level];
+    const lerp_axis & rows = source.rows[region.level];
+
+    for (int32_t y=0; y<region.height; y++)
+    {
+      const auto row = static_cast<size_t>(region.y + y);
+
+      lerp_row(source.image.row(static_cast<uint32_t>(rows.first[row]))
+              ,source.image.row(static_cast<uint32_t>(rows.second[row]))
+              ,rows.weight[row]
+              ,columns
+              ,static_cast<uint32_t>(region.x)
+              ,static_cast<uint32_t>(region.x + region.width)
+              ,source.image.channels()
+              ,pixels + (static_cast<size_t>(y) * stride));
+    }
   }
 }
 
 std::vector<uint8_t> UpsampleOp::ProcessImage(MenuOp_Upsample operation
-                                             ,const std::vector<uint8_t> & source_image
-                                             ,uint32_t width
-                                             ,uint32_t height
-                                             ,uint8_t bpp
+                                             ,const cimageview & source_image
                                              ,uint16_t iterations)
 {
+  lazyImage.Clear();
+
   switch (operation)
   {
     case MenuOp_Upsample::NEAREST:
       spdlog::info("perform nearest upsample operation");
-      NearestAlgorithm(source_image, width, height, bpp, iterations);
+      NearestAlgorithm(source_image, iterations);
       break;
 
     case MenuOp_Upsample::LINEAR:
       spdlog::info("perform linear upsample operation");
-      LinearAlgorithm(source_image, width, height, bpp, iterations);
+      LinearAlgorithm(source_image, iterations);
       break;
 
     case MenuOp_Upsample::BILINEAR:
       spdlog::info("perform bilinear upsample operation");
-      BilinearAlgorithm(source_image, width, height, bpp, iterations);
+      BilinearAlgorithm(source_image, iterations);
       break;
   }
 
+  progress.finish();
+
   return result;
 }
 
+ctask<std::vector<uint8_t>> UpsampleOp::ProcessImageAsync(MenuOp_Upsample operation
+                                                         ,cimageview source_image
+                                                         ,uint16_t iterations)
+{
+  return AsyncOp::Run(this, &UpsampleOp::ProcessImage, operation, std::move(source_image), iterations);
+}
+
+void UpsampleOp::ProcessLazy(MenuOp_Upsample operation
+                            ,const cimageview & source_image
+                            ,uint16_t iterations)
+{
+  // the materialized result of a previous ProcessImage is dropped, only the source is kept (shared if the view owns
+  // its pixels)
+
+  outWidth = static_cast<int32_t>(source_image.width() << iterations);
+  outHeight = static_cast<int32_t>(source_image.height() << iterations);
+  result.clear();
+  result.shrink_to_fit();
+
+  if (source_image.empty())
+  {
+    spdlog::warn("unable to upsample a {}x{} image", source_image.width(), source_image.height());
+
+    outWidth = 0;
+    outHeight = 0;
+    lazyImage.Clear();
+
+    return;
+  }
+
+  auto source = std::make_shared<lazy_source>();
+  source->image = source_image.owned();
+  source->iterations = iterations;
+
+  if (operation == MenuOp_Upsample::NEAREST)
+  {
+    spdlog::info("lazy nearest upsample operation");
+
+    lazyImage.Reset(outWidth, outHeight, source_image.channels(), iterations, true, [source](const LazyImage::Region & region, uint8_t * pixels, size_t stride) {
+      nearest_region(*source, region, pixels, stride);
+    });
+
+    return;
+  }
+
+  spdlog::info("lazy {} upsample operation", (operation == MenuOp_Upsample::LINEAR) ? "linear" : "bilinear");
+
+  for (uint16_t level=0; level<=iterations; level++)
+  {
+    source->columns.emplace_back(make_lerp_axis(source_image.width(), iterations - level, true));
+    source->rows.emplace_back(make_lerp_axis(source_image.height(), iterations - level, (operation == MenuOp_Upsample::BILINEAR)));
+  }
+
+  lazyImage.Reset(outWidth, outHeight, source_image.channels(), iterations, false, [source](const LazyImage::Region & region, uint8_t * pixels, size_t stride) {
+    interpolate_region(*source, region, pixels, stride);
+  });
+}
+
+LazyImage & UpsampleOp::GetLazyImage()
+{
+  return lazyImage;
+}
+
 const std::vector<uint8_t> & UpsampleOp::GetImage() const
 {
   return result;
@@ -117,298 +302,73 @@ int32_t UpsampleOp::GetHeight() const
   return outHeight;
 }
 
-void UpsampleOp::NearestAlgorithm(const std::vector<uint8_t> & source_image
-                                 ,uint32_t width
-                                 ,uint32_t height
-                                 ,uint8_t bpp
+const cprogress & UpsampleOp::GetProgress() const
+{
+  return progress;
+}
+
+void UpsampleOp::NearestAlgorithm(const cimageview & source_image
                                  ,uint16_t iterations)
 {
-  constexpr uint32_t combine_value = 1;
+  // straight from the source, every output pixel is written once (no intermediate levels)
 
-  auto dest_result = result = source_image;
+  outWidth = static_cast<int32_t>(source_image.width() << iterations);
+  outHeight = static_cast<int32_t>(source_image.height() << iterations);
 
-  outWidth = static_cast<int32_t>(width << iterations);
-  outHeight = static_cast<int32_t>(height << iterations);
+  const auto out_width = static_cast<uint32_t>(outWidth);
+  const size_t out_stride = static_cast<size_t>(out_width) * source_image.channels();
 
-  for (int32_t r=0; r<iterations; r++)
-  {
-    const auto new_size = static_cast<uint32_t>( std::floor(width << (r+1)))
-                                               * static_cast<uint32_t>(std::floor(height << (r+1)))
-                                               * bpp;
+  result.resize(out_stride * static_cast<size_t>(outHeight));
 
-    result.resize(new_size, 0);
+  progress.begin(static_cast<size_t>(out_width) * static_cast<size_t>(outHeight));
 
-    for (int32_t i=0; i<(height << r); i++)
-    {
-      for (int32_t j=0; j<(width << r); j++)
-      {
-        // grab the pixel value of the source and set the pixel to the correct destination
-        auto pixel_rgb_value = pixel_gather(j
-                                           ,i
-                                           ,static_cast<int32_t>(width << r)
-                                           ,static_cast<int32_t>(height << r)
-                                           ,combine_value
-                                           ,bpp
-                                           ,dest_result);
-
-        set_pixel((j * 2)
-                 ,(i * 2)
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2) + 1
-                 ,(i * 2)
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2)
-                 ,(i * 2) + 1
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2) + 1
-                 ,(i * 2) + 1
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-      }
-    }
+  parallel_for(cpoolregistry::shared(), 0, outHeight, [&](int32_t y) {
+    const auto row = static_cast<uint32_t>(y);
+    nearest_rows(source_image, iterations, 0, out_width, row, row + 1, result.data() + (static_cast<size_t>(y) * out_stride), out_stride);
 
-    dest_result = result;
-  }
+    progress.advance(out_width);
+  });
 }
 
-void UpsampleOp::LinearAlgorithm(const std::vector<uint8_t> & source_image
-                                  ,uint32_t width
-                                  ,uint32_t height
-                                  ,uint8_t bpp
-                                  ,uint16_t iterations)
+void UpsampleOp::LinearAlgorithm(const cimageview & source_image
+                                ,uint16_t iterations)
 {
-  constexpr uint32_t combine_value = 1;
-
-  auto dest_result = result = source_image;
-
-  outWidth = static_cast<int32_t>(width << iterations);
-  outHeight = static_cast<int32_t>(height << iterations);
-
-  for (int32_t r=0; r<iterations; r++)
-  {
-    const auto new_size = static_cast<uint32_t>( std::floor(width << (r+1)))
-                                               * static_cast<uint32_t>(std::floor(height << (r+1)))
-                                               * bpp;
-
-    result.resize(new_size, 0);
-
-    for (int32_t i=0; i<(height << r); i++)
-    {
-      for (int32_t j=0; j<(width << r); j++)
-      {
-        // grab the pixel value of the source and set the pixel to the correct destination
-        auto pixel_rgb_value_left = pixel_gather((j - 1)
-                                                ,i
-                                                ,static_cast<int32_t>(width << r)
-                                                ,static_cast<int32_t>(height << r)
-                                                ,combine_value
-                                                ,bpp
-                                                ,dest_result);
-
-        auto pixel_rgb_value_right = pixel_gather((j + 1)
-                                                 ,i
-                                                 ,static_cast<int32_t>(width << r)
-                                                 ,static_cast<int32_t>(height << r)
-                                                 ,combine_value
-                                                 ,bpp
-                                                 ,dest_result);
-
-        // get the 2 (x,y) coordinates (left and right neighboring pixels) that need to be used to produce a linear factor to be multiplied
-        // against the intensity values at those corners. This needs to be done for each channel. Assuming
-        // an RGB pixel (ignoring the Alpha channel)
-
-        std::array<int32_t, 4> pixel_rgb_value_sum = {0, 0, 0};
-
-        auto idx_tr = static_cast<float>(j+1);
-        auto idx_tl = static_cast<float>(j-1);
-        auto idx_px  = (idx_tr + idx_tl) / 2.0f;
-
-        for (size_t k=0; k<4; k++)
-        {
-          float pix_1 = ((idx_tr - idx_px) / (idx_tr - idx_tl)) * static_cast<float>(pixel_rgb_value_left[k]);
-          float pix_2 = ((idx_px - idx_tl) / (idx_tr - idx_tl)) * static_cast<float>(pixel_rgb_value_right[k]);
-          float pix_p = (pix_1 + pix_2);
-
-          pixel_rgb_value_sum[k] = static_cast<int32_t>(pix_p);
-        }
-
-        std::array<uint8_t, 4> pixel_rgb_value = {static_cast<uint8_t>(pixel_rgb_value_sum[0])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_sum[1])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_sum[2])
-                                                 ,static_cast<uint8_t>(pixel_rgb_value_sum[3])};
-
-        set_pixel((j * 2)
-                 ,(i * 2)
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2) + 1
-                 ,(i * 2)
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2)
-                 ,(i * 2) + 1
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2) + 1
-                 ,(i * 2) + 1
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-      }
-    }
-
-    dest_result = result;
-  }
+  // interpolated along the rows, every row repeated 2^iterations times
+  InterpolateAlgorithm(source_image, iterations, false);
 }
 
-void UpsampleOp::BilinearAlgorithm(const std::vector<uint8_t> & source_image
-                                  ,uint32_t width
-                                  ,uint32_t height
-                                  ,uint8_t bpp
+void UpsampleOp::BilinearAlgorithm(const cimageview & source_image
                                   ,uint16_t iterations)
 {
-  constexpr uint32_t combine_value = 1;
+  InterpolateAlgorithm(source_image, iterations, true);
+}
 
-  auto dest_result = result = source_image;
+void UpsampleOp::InterpolateAlgorithm(const cimageview & source_image
+                                     ,uint16_t iterations
+                                     ,bool interpolate_rows)
+{
+  // straight from the source to the 2^iterations larger output, every output pixel is written once from its 4
+  // source neighbors (no intermediate levels)
 
-  outWidth = static_cast<int32_t>(width << iterations);
-  outHeight = static_cast<int32_t>(height << iterations);
+  outWidth = static_cast<int32_t>(source_image.width() << iterations);
+  outHeight = static_cast<int32_t>(source_image.height() << iterations);
 
-  for (int32_t r=0; r<iterations; r++)
-  {
-    const auto new_size = static_cast<uint32_t>( std::floor(width << (r+1)))
-                                               * static_cast<uint32_t>(std::floor(height << (r+1)))
-                                               * bpp;
+  const lerp_axis columns = make_lerp_axis(source_image.width(), iterations, true);
+  const lerp_axis rows = make_lerp_axis(source_image.height(), iterations, interpolate_rows);
 
-    result.resize(new_size, 0);
+  const auto out_width = static_cast<uint32_t>(outWidth);
+  const size_t out_stride = static_cast<size_t>(out_width) * source_image.channels();
 
-    for (int32_t i=0; i<(height << r); i++)
-    {
-      for (int32_t j=0; j<(width << r); j++)
-      {
-        // grab the pixel value of the source and set the pixel to the correct destination
-
-        auto pixel_rgb_value_topleft = pixel_gather((j - 1)
-                                                   ,(i - 1)
-                                                   ,static_cast<int32_t>(width << r)
-                                                   ,static_cast<int32_t>(height << r)
-                                                   ,combine_value
-                                                   ,bpp
-                                                   ,dest_result);
-
-        auto pixel_rgb_value_topright = pixel_gather((j + 1)
-                                                    ,(i - 1)
-                                                    ,static_cast<int32_t>(width << r)
-                                                    ,static_cast<int32_t>(height << r)
-                                                    ,combine_value
-                                                    ,bpp
-                                                    ,dest_result);
-
-        auto pixel_rgb_value_bottomleft = pixel_gather((j - 1)
-                                                      ,(i + 1)
-                                                      ,static_cast<int32_t>(width << r)
-                                                      ,static_cast<int32_t>(height << r)
-                                                      ,combine_value
-                                                      ,bpp
-                                                      ,dest_result);
-
-        auto pixel_rgb_value_bottomright = pixel_gather((j + 1)
-                                                       ,(i + 1)
-                                                       ,static_cast<int32_t>(width << r)
-                                                       ,static_cast<int32_t>(height << r)
-                                                       ,combine_value
-                                                       ,bpp
-                                                       ,dest_result);
-
-        // get the 4 (x,y) coordinates that need to be used to produce a linear factor to be multiplied
-        // against the intensity values at those corners. This needs to be done for each channel. Assuming
-        // an RGB pixel (ignoring the Alpha channel)
-
-        std::array<int32_t, 4> pixel_rgb_value_sum = {0, 0, 0};
-
-        auto idx_tr = static_cast<float>(j+1);
-        auto idx_tl = static_cast<float>(j-1);
-        auto idx_px  = (idx_tr + idx_tl) / 2.0f;
-        auto idx_t = static_cast<float>(i-1);
-        auto idx_b  = static_cast<float>(i+1);
-        auto idx_py = (idx_t + idx_b) / 2.0f;
-
-        for (size_t k=0; k<4; k++)
-        {
-          float pix_top_1 =  ((idx_tr - idx_px) / (idx_tr - idx_tl)) * static_cast<float>(pixel_rgb_value_topleft[k]);
-          float pix_top_2 =  ((idx_px - idx_tl) / (idx_tr - idx_tl)) * static_cast<float>(pixel_rgb_value_topright[k]);
-          float pix_top = (pix_top_1 + pix_top_2);
-
-          float pix_bot_1 =  ((idx_tr - idx_px) / (idx_tr - idx_tl)) * static_cast<float>(pixel_rgb_value_bottomleft[k]);
-          float pix_bot_2 =  ((idx_tr - idx_px) / (idx_tr - idx_tl)) * static_cast<float>(pixel_rgb_value_bottomright[k]);
-          float pix_bot = (pix_bot_1 + pix_bot_2);
-
-          float pix_p_1 =  ((idx_b - idx_py) / (idx_b - idx_t)) * pix_bot;
-          float pix_p_2 =  ((idx_py - idx_t) / (idx_b - idx_t)) * pix_top;
-          float pix_p = (pix_p_1 + pix_p_2);
-
-          pixel_rgb_value_sum[k] = static_cast<int32_t>(pix_p);
-        }
-
-        std::array<uint8_t, 4> pixel_rgb_value = {std::clamp(static_cast<uint8_t>(pixel_rgb_value_sum[0]), uint8_t(0), uint8_t(255))
-                                                 ,std::clamp(static_cast<uint8_t>(pixel_rgb_value_sum[1]), uint8_t(0), uint8_t(255))
-                                                 ,std::clamp(static_cast<uint8_t>(pixel_rgb_value_sum[2]), uint8_t(0), uint8_t(255))
-                                                 ,std::clamp(static_cast<uint8_t>(pixel_rgb_value_sum[3]), uint8_t(0), uint8_t(255))};
-
-        set_pixel((j * 2)
-                 ,(i * 2)
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2) + 1
-                 ,(i * 2)
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2)
-                 ,(i * 2) + 1
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-
-        set_pixel((j * 2) + 1
-                 ,(i * 2) + 1
-                 ,static_cast<int32_t>(width << (r+1))
-                 ,bpp
-                 ,result
-                 ,pixel_rgb_value);
-      }
-    }
+  result.resize(out_stride * static_cast<size_t>(outHeight));
 
-    dest_result = result;
-  }
+  progress.begin(static_cast<size_t>(out_width) * static_cast<size_t>(outHeight));
+
+  parallel_for(cpoolregistry::shared(), 0, outHeight, [&](int32_t y) {
+    const uint8_t * top_row = source_image.row(static_cast<uint32_t>(rows.first[y]));
+    const uint8_t * bottom_row = source_image.row(static_cast<uint32_t>(rows.second[y]));
+
+    lerp_row(top_row, bottom_row, rows.weight[y], columns, 0, out_width, source_image.channels(), result.data() + (static_cast<size_t>(y) * out_stride));
+
+    progress.advance(out_width);
+  });
 }
@@ -3,6 +3,10 @@
 #include <vector>
 #include <cstdint>
 #include "MenuOps.h"
+#include "LazyImage.h"
+#include "common/cimageview.h"
+#include "common/cprogress.h"
+#include "common/ctask.h"
 
 class UpsampleOp
 {
@@ -11,37 +15,44 @@ class UpsampleOp
     ~UpsampleOp() = default;
 
     std::vector<uint8_t> ProcessImage(MenuOp_Upsample operation
-                                     ,const std::vector<uint8_t> & source_image
-                                     ,uint32_t width
-                                     ,uint32_t height
-                                     ,uint8_t bpp
+                                     ,const cimageview & source_image
                                      ,uint16_t iterations);
 
+    // ProcessImage on the shared pool (see AsyncOp)
+    ctask<std::vector<uint8_t>> ProcessImageAsync(MenuOp_Upsample operation
+                                                 ,cimageview source_image
+                                                 ,uint16_t iterations);
+
+    // the same output without computing it, GetLazyImage evaluates the parts a view or export asks for. nearest is
+    // a virtual image read straight from the source, linear/bilinear keep the tiles they evaluate in its cache
+    void ProcessLazy(MenuOp_Upsample operation
+                    ,const cimageview & source_image
+                    ,uint16_t iterations);
+
+    [[nodiscard]] LazyImage & GetLazyImage();
     [[nodiscard]] const std::vector<uint8_t> & GetImage() const;
 
     [[nodiscard]] int32_t GetWidth() const;
     [[nodiscard]] int32_t GetHeight() const;
+    [[nodiscard]] const cprogress & GetProgress() const;
 
   private:
     int32_t outWidth = 0;
     int32_t outHeight = 0;
     std::vector<uint8_t> result;
+    LazyImage lazyImage;
+    cprogress progress;
 
-    void NearestAlgorithm(const std::vector<uint8_t> & source_image
-                         ,uint32_t width
-                         ,uint32_t height
-                         ,uint8_t bpp
+    void NearestAlgorithm(const cimageview & source_image
                          ,uint16_t iterations);
 
-    void LinearAlgorithm(const std::vector<uint8_t> & source_image
-                          ,uint32_t width
-                          ,uint32_t height
-                          ,uint8_t bpp
-                          ,uint16_t iterations);
+    void LinearAlgorithm(const cimageview & source_image
+                        ,uint16_t iterations);
 
-    void BilinearAlgorithm(const std::vector<uint8_t> & source_image
-                          ,uint32_t width
-                          ,uint32_t height
-                          ,uint8_t bpp
+    void BilinearAlgorithm(const cimageview & source_image
                           ,uint16_t iterations);
+
+    void InterpolateAlgorithm(const cimageview & source_image
+                             ,uint16_t iterations
+                             ,bool interpolate_rows);
 };
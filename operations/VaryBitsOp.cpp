@@ -2,8 +2,12 @@
 
 #include <array>
 #include <algorithm>
-#include <limits>
+#include <bitset>
 #include <spdlog/spdlog.h>
+#include "AsyncOp.h"
+#include "common/cimageview.h"
+#include "common/cparallel.h"
+#include "common/cpoolregistry.h"
 
 #define PRINT_DEBUG_VARYING_BITS false
 
@@ -13,57 +17,24 @@
 
 namespace
 {
-  std::array<uint8_t, 4> pixel_gather(const int32_t & x
-                                     ,const int32_t & y
-                                     ,const int32_t & w
-                                     ,const int32_t & h
-                                     ,const int32_t & number_of_pixel_neighbors
-                                     ,const int32_t & bpp
-                                     ,const std::vector<uint8_t> & source_image)
-  {
-    int32_t pixel_value_red = 0;
-    int32_t pixel_value_green = 0;
-    int32_t pixel_value_blue = 0;
-    int32_t pixel_value_alpha = 0;
+  // the gray values seen by a band of rows. merged once the bands are done instead of every pixel going through the
+  // (shared) std::set
 
-    for (int32_t i=0; i<(number_of_pixel_neighbors + 1); i++)
-    {
-      const size_t pixel_byte_index_r = ((x + i) * bpp) + (y * w * bpp) + 3;
-      if ((pixel_byte_index_r > 0) && (pixel_byte_index_r < w))
-      {
-        pixel_value_red += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 0]);
-        pixel_value_green += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 1]);
-        pixel_value_blue += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 2]);
-        pixel_value_alpha += static_cast<int32_t>(source_image[((x + i) * bpp) + (y * w * bpp) + 3]);
-      }
-      else
-      {
-        const int32_t x_fix = std::clamp(x, 0, (w - 1));
-        const int32_t y_fix = std::clamp(y, 0, (h - 1));
+  using pixel_value_set = std::bitset<256>;
 
-        pixel_value_red += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 0]);
-        pixel_value_green += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 1]);
-        pixel_value_blue += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 2]);
-        pixel_value_alpha += static_cast<int32_t>(source_image[(x_fix * bpp) + (y_fix * w * bpp) + 3]);
-      }
-    }
-
-    pixel_value_red /= (number_of_pixel_neighbors + 1);
-    pixel_value_red = std::clamp(pixel_value_red, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
-
-    pixel_value_green /= (number_of_pixel_neighbors + 1);
-    pixel_value_green = std::clamp(pixel_value_green, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+  void MergePixelValueSet(pixel_value_set & values, const pixel_value_set & other)
+  {
+    values |= other;
+  }
 
-    pixel_value_blue /= (number_of_pixel_neighbors + 1);
-    pixel_value_blue = std::clamp(pixel_value_blue, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+  std::array<uint8_t, 4> pixel_gather(const cimageview & source_image, uint32_t x, uint32_t y)
+  {
+    // the channels of pixel (x, y), missing ones stay 0
 
-    pixel_value_alpha /= (number_of_pixel_neighbors + 1);
-    pixel_value_alpha = std::clamp(pixel_value_alpha, 0, static_cast<int32_t>(std::numeric_limits<uint8_t>::max()));
+    std::array<uint8_t, 4> pixel_rgb_value = {0, 0, 0, 0};
+    std::copy_n(source_image.pixel(x, y), std::min<size_t>(source_image.channels(), pixel_rgb_value.size()), pixel_rgb_value.begin());
 
-    return {static_cast<uint8_t>(pixel_value_red)
-           ,static_cast<uint8_t>(pixel_value_green)
-           ,static_cast<uint8_t>(pixel_value_blue)
-           ,static_cast<uint8_t>(pixel_value_alpha)};
+    return pixel_rgb_value;
   }
 
   void set_pixel(const uint32_t & x
@@ -95,24 +66,30 @@ namespace
 
 std::vector<uint8_t> VaryBitsOp::ProcessImage(int32_t bit_level_operation
                                              ,bool bit_contrast
-                                             ,const std::vector<uint8_t> & source_image
-                                             ,uint32_t width
-                                             ,uint32_t height
-                                             ,uint8_t bpp)
+                                             ,const cimageview & source_image)
 {
   if (bit_level_operation < 0)
   {
     spdlog::info("remove/show bit levels");
-    BitLevelRemovalAlgorithm(source_image, width, height, bpp, bit_level_operation, bit_contrast);
+    BitLevelRemovalAlgorithm(source_image, bit_level_operation, bit_contrast);
   }
   else
   {
     spdlog::info("varying bits level: {}", bit_level_operation);
-    BitLevelAlgorithm(source_image, width, height, bpp, bit_level_operation, bit_contrast);
+    BitLevelAlgorithm(source_image, bit_level_operation, bit_contrast);
   }
+  progress.finish();
+
   return result;
 }
 
+ctask<std::vector<uint8_t>> VaryBitsOp::ProcessImageAsync(int32_t bit_level_operation
+                                                         ,bool bit_contrast
+                                                         ,cimageview source_image)
+{
+  return AsyncOp::Run(this, &VaryBitsOp::ProcessImage, bit_level_operation, bit_contrast, std::move(source_image));
+}
+
 const std::vector<uint8_t> & VaryBitsOp::GetImage() const
 {
   return result;
@@ -128,11 +105,27 @@ int32_t VaryBitsOp::GetHeight() const
   return outHeight;
 }
 
+const cprogress & VaryBitsOp::GetProgress() const
+{
+  return progress;
+}
+
 std::set<uint32_t> VaryBitsOp::GetUniquePixelValues() const
 {
   return uniquePixelValues;
 }
 
+void VaryBitsOp::InsertUniquePixelValues(const std::bitset<256> & unique_pixel_values)
+{
+  for (size_t i=0; i<unique_pixel_values.size(); i++)
+  {
+    if (unique_pixel_values.test(i))
+    {
+      uniquePixelValues.emplace(static_cast<uint32_t>(i));
+    }
+  }
+}
+
 void VaryBitsOp::SetUseColorChannels(bool use_color_channels)
 {
   useColor = use_color_channels;
@@ -143,33 +136,29 @@ void VaryBitsOp::SetShowBitPlanes(const std::array<bool, 8> & show_bit_planes)
   showBitPlanes = show_bit_planes;
 }
 
-void VaryBitsOp::BitLevelAlgorithm(const std::vector<uint8_t> & source_image
-                                  ,uint32_t width
-                                  ,uint32_t height
-                                  ,uint8_t bpp
+void VaryBitsOp::BitLevelAlgorithm(const cimageview & source_image
                                   ,uint32_t bit_level
                                   ,bool bit_contrast)
 {
-  constexpr uint32_t combine_value = 0;
-  auto dest_result = result = source_image;
+  const uint32_t width = source_image.width();
+  const uint32_t height = source_image.height();
+  const uint8_t bpp = source_image.channels();
+
+  // every byte of the result is written below, nothing is copied from the source up front
+  result.resize(static_cast<size_t>(width) * height * bpp);
 
   outWidth = static_cast<int32_t>(width);
   outHeight = static_cast<int32_t>(height);
 
   const uint32_t bits_to_shift = (8 - bit_level);
 
-  for (int32_t i=0; i<height; i++)
-  {
-    for (int32_t j=0; j<width; j++)
+  progress.begin(height);
+
+  const pixel_value_set unique_pixel_values = parallel_reduce(cpoolregistry::shared(), 0, static_cast<int32_t>(height), pixel_value_set(), [&](int32_t i, pixel_value_set & row_unique_pixel_values) {
+    for (uint32_t j=0; j<width; j++)
     {
       // grab the pixel value of the source and set the pixel to the correct destination
-      auto pixel_rgb_value = pixel_gather(j
-                                         ,i
-                                         ,static_cast<int32_t>(width)
-                                         ,static_cast<int32_t>(height)
-                                         ,combine_value
-                                         ,bpp
-                                         ,dest_result);
+      auto pixel_rgb_value = pixel_gather(source_image, j, static_cast<uint32_t>(i));
 
       if (useColor)
       {
@@ -190,7 +179,7 @@ void VaryBitsOp::BitLevelAlgorithm(const std::vector<uint8_t> & source_image
 
         unique_gray_value /= 3;
 
-        uniquePixelValues.emplace(static_cast<uint8_t>(unique_gray_value));
+        row_unique_pixel_values.set(static_cast<uint8_t>(unique_gray_value));
       }
       else
       {
@@ -216,7 +205,11 @@ void VaryBitsOp::BitLevelAlgorithm(const std::vector<uint8_t> & source_image
                ,result
                ,pixel_rgb_value);
     }
-  }
+
+    progress.advance();
+  }, MergePixelValueSet);
+
+  InsertUniquePixelValues(unique_pixel_values);
 
   #if PRINT_DEBUG_VARYING_BITS
   for (const int32_t & pixel_value : uniquePixelValues)
@@ -227,42 +220,37 @@ void VaryBitsOp::BitLevelAlgorithm(const std::vector<uint8_t> & source_image
   #endif
 }
 
-void VaryBitsOp::BitLevelRemovalAlgorithm(const std::vector<uint8_t> & source_image
-                                         ,uint32_t width
-                                         ,uint32_t height
-                                         ,uint8_t bpp
+void VaryBitsOp::BitLevelRemovalAlgorithm(const cimageview & source_image
                                          ,uint32_t bit_level
                                          ,bool bit_contrast)
 {
-  constexpr uint32_t combine_value = 0;
-  auto dest_result = result = source_image;
+  const uint32_t width = source_image.width();
+  const uint32_t height = source_image.height();
+  const uint8_t bpp = source_image.channels();
+
+  result.assign(static_cast<size_t>(width) * height * bpp, 0);
 
   outWidth = static_cast<int32_t>(width);
   outHeight = static_cast<int32_t>(height);
 
-  const uint32_t bits_to_shift = (8 - bit_level);
+  const auto number_of_bit_planes = static_cast<size_t>(std::count(showBitPlanes.begin(), showBitPlanes.end(), true));
 
-  std::fill(result.begin(), result.end(), 0);
+  progress.begin(static_cast<size_t>(height) * number_of_bit_planes);
 
-  for (int32_t k=0; k<showBitPlanes.size(); k++)
-  {
-    if (!showBitPlanes[k])
-    {
-      continue;
-    }
+  // the bit planes are or'd into the result so each band of rows can go through all of the planes on its own
 
-    for (int32_t i=0; i<height; i++)
+  const pixel_value_set unique_pixel_values = parallel_reduce(cpoolregistry::shared(), 0, static_cast<int32_t>(height), pixel_value_set(), [&](int32_t i, pixel_value_set & row_unique_pixel_values) {
+    for (int32_t k=0; k<showBitPlanes.size(); k++)
     {
-      for (int32_t j=0; j<width; j++)
+      if (!showBitPlanes[k])
+      {
+        continue;
+      }
+
+      for (uint32_t j=0; j<width; j++)
       {
         // grab the pixel value of the source and set the pixel to the correct destination
-        auto pixel_rgb_value = pixel_gather(j
-                                           ,i
-                                           ,static_cast<int32_t>(width)
-                                           ,static_cast<int32_t>(height)
-                                           ,combine_value
-                                           ,bpp
-                                           ,dest_result);
+        auto pixel_rgb_value = pixel_gather(source_image, j, static_cast<uint32_t>(i));
 
         if (useColor)
         {
@@ -281,7 +269,7 @@ void VaryBitsOp::BitLevelRemovalAlgorithm(const std::vector<uint8_t> & source_im
 
           unique_gray_value /= 3;
 
-          uniquePixelValues.emplace(static_cast<uint8_t>(unique_gray_value));
+          row_unique_pixel_values.set(static_cast<uint8_t>(unique_gray_value));
         }
         else
         {
@@ -306,7 +294,11 @@ void VaryBitsOp::BitLevelRemovalAlgorithm(const std::vector<uint8_t> & source_im
                     ,pixel_rgb_value);
       }
     }
-  }
+
+    progress.advance(number_of_bit_planes);
+  }, MergePixelValueSet);
+
+  InsertUniquePixelValues(unique_pixel_values);
 
   #if PRINT_DEBUG_VARYING_BITS
   for (const int32_t & pixel_value : uniquePixelValues)
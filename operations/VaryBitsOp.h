@@ -4,6 +4,10 @@
 #include <vector>
 #include <set>
 #include <array>
+#include <bitset>
+#include "common/cimageview.h"
+#include "common/cprogress.h"
+#include "common/ctask.h"
 
 class VaryBitsOp
 {
@@ -13,15 +17,18 @@ class VaryBitsOp
 
     std::vector<uint8_t> ProcessImage(int32_t bit_level_operation
                                      ,bool bit_contrast
-                                     ,const std::vector<uint8_t> & source_image
-                                     ,uint32_t width
-                                     ,uint32_t height
-                                     ,uint8_t bpp);
+                                     ,const cimageview & source_image);
+
+    // ProcessImage on the shared pool (see AsyncOp)
+    ctask<std::vector<uint8_t>> ProcessImageAsync(int32_t bit_level_operation
+                                                 ,bool bit_contrast
+                                                 ,cimageview source_image);
 
     [[nodiscard]] const std::vector<uint8_t> & GetImage() const;
 
     [[nodiscard]] int32_t GetWidth() const;
     [[nodiscard]] int32_t GetHeight() const;
+    [[nodiscard]] const cprogress & GetProgress() const;
 
     [[nodiscard]] std::set<uint32_t> GetUniquePixelValues() const;
 
@@ -33,20 +40,17 @@ class VaryBitsOp
     int32_t outHeight = 0;
     std::set<uint32_t> uniquePixelValues;
     std::vector<uint8_t> result;
+    cprogress progress;
     bool useColor = false;
     std::array<bool, 8> showBitPlanes = {true};
 
-    void BitLevelAlgorithm(const std::vector<uint8_t> & source_image
-                          ,uint32_t width
-                          ,uint32_t height
-                          ,uint8_t bpp
+    void InsertUniquePixelValues(const std::bitset<256> & unique_pixel_values);
+
+    void BitLevelAlgorithm(const cimageview & source_image
                           ,uint32_t bit_level
                           ,bool bit_contrast);
 
-    void BitLevelRemovalAlgorithm(const std::vector<uint8_t> & source_image
-                                 ,uint32_t width
-                                 ,uint32_t height
-                                 ,uint8_t bpp
+    void BitLevelRemovalAlgorithm(const cimageview & source_image
                                  ,uint32_t bit_level
                                  ,bool bit_contrast);
 